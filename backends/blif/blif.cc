@@ -201,13 +201,13 @@ struct BlifDumper
 				log_assert(output.size() == 1);
 				f << stringf(" %s", cstr(output));
 				f << stringf("\n");
-				auto mask = cell->parameters.at("\\LUT").as_string();
+				auto &mask = cell->parameters.at("\\LUT").bits;
 				for (int i = 0; i < (1 << width); i++) {
-					if (mask[i] == '0') continue;
-					for (int j = width-1; j >= 0; j--) {
+					if (mask.at(i) != RTLIL::State::S1) continue;
+					for (int j = 0; j < width; j++) {
 						f << ((i>>j)&1 ? '1' : '0');
 					}
-					f << stringf(" %c\n", mask[i]);
+					f << stringf(" 1\n");
 				}
 				continue;
 			}
@@ -1320,9 +1320,9 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 			for (auto it = children.begin(); it != children.end(); it++) {
 				AstNode *child = *it;
 				if (child->type == AST_CELLTYPE) {
-					cell->type = child->str;
+					cell->setType(child->str);
 					if (flag_icells && cell->type.substr(0, 2) == "\\$")
-						cell->type = cell->type.substr(1);
+						cell->setType(cell->type.substr(1));
 					continue;
 				}
 				if (child->type == AST_PARASET) {
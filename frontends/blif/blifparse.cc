@@ -0,0 +1,470 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// [[CITE]] Berkeley Logic Interchange Format (BLIF)
+// University of California. Berkeley. July 28, 1992
+// http://www.ece.cmu.edu/~ee760/760docs/blif.pdf
+
+#include "blifparse.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <sys/mman.h>
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+struct blif_token_t
+{
+	const char *str;
+	int len;
+
+	blif_token_t() : str(NULL), len(0) { }
+	blif_token_t(const char *str, int len) : str(str), len(len) { }
+
+	bool empty() const { return len == 0; }
+	bool operator==(const char *other) const { return !strncmp(str, other, len) && other[len] == 0; }
+	bool operator!=(const char *other) const { return !(*this == other); }
+	std::string as_string() const { return std::string(str, len); }
+};
+
+struct BlifTokenizer
+{
+	const char *ptr, *end;
+	int line_count;
+
+	BlifTokenizer(const char *data, size_t size) : ptr(data), end(data + size), line_count(1) { }
+
+	// skip blanks and line continuations, stop at the end of the current line
+	void skip_blanks()
+	{
+		while (ptr != end) {
+			if (*ptr == ' ' || *ptr == '\t' || *ptr == '\r') {
+				ptr++;
+				continue;
+			}
+			if (*ptr == '\\') {
+				const char *p = ptr + 1;
+				while (p != end && *p == '\r')
+					p++;
+				if (p != end && *p == '\n') {
+					ptr = p + 1, line_count++;
+					continue;
+				}
+			}
+			if (*ptr == '#') {
+				while (ptr != end && *ptr != '\n')
+					ptr++;
+			}
+			break;
+		}
+	}
+
+	// return the next token of the current line, or an empty token at the end of the line
+	blif_token_t next_token()
+	{
+		skip_blanks();
+		const char *begin = ptr;
+		while (ptr != end && *ptr != ' ' && *ptr != '\t' && *ptr != '\r' && *ptr != '\n')
+			ptr++;
+		return blif_token_t(begin, ptr - begin);
+	}
+
+	// move to the first token of the next non-empty line, returns false at end of file
+	bool next_line()
+	{
+		while (1) {
+			skip_blanks();
+			if (ptr == end)
+				return false;
+			if (*ptr != '\n')
+				return true;
+			ptr++, line_count++;
+		}
+	}
+
+	// discard the rest of the current line
+	void finish_line()
+	{
+		while (next_token().len > 0) { }
+	}
+
+	bool at_command() {
+		return ptr != end && *ptr == '.';
+	}
+};
+
+// maps the net names of one model to wires, the keys point directly into the input buffer
+struct BlifNetIndex
+{
+	struct entry_t {
+		const char *str;
+		int len;
+		unsigned int hash;
+		RTLIL::Wire *wire;
+	};
+
+	RTLIL::Module *module;
+	std::vector<entry_t> entries;
+	std::vector<int> hashtable;
+
+	static unsigned int hash(const char *str, int len)
+	{
+		// FNV-1a
+		unsigned int h = 2166136261u;
+		for (int i = 0; i < len; i++)
+			h = (h ^ (unsigned char)str[i]) * 16777619u;
+		return h;
+	}
+
+	BlifNetIndex(RTLIL::Module *module) : module(module)
+	{
+		hashtable.resize(1024, -1);
+	}
+
+	void rehash()
+	{
+		int new_size = 4 * GetSize(hashtable);
+		hashtable.clear();
+		hashtable.resize(new_size, -1);
+		int mask = GetSize(hashtable) - 1;
+		for (int i = 0; i < GetSize(entries); i++) {
+			int idx = entries[i].hash & mask;
+			while (hashtable[idx] >= 0)
+				idx = (idx + 1) & mask;
+			hashtable[idx] = i;
+		}
+	}
+
+	RTLIL::Wire *operator()(const blif_token_t &tok)
+	{
+		unsigned int h = hash(tok.str, tok.len);
+		int mask = GetSize(hashtable) - 1;
+		int idx = h & mask;
+
+		for (; hashtable[idx] >= 0; idx = (idx + 1) & mask) {
+			entry_t &e = entries[hashtable[idx]];
+			if (e.hash == h && e.len == tok.len && !memcmp(e.str, tok.str, tok.len))
+				return e.wire;
+		}
+
+		std::string name = RTLIL::escape_id(tok.as_string());
+		RTLIL::Wire *wire = module->wires_.count(name) ? module->wires_.at(name) : module->addWire(name);
+
+		entry_t e = { tok.str, tok.len, h, wire };
+		hashtable[idx] = GetSize(entries);
+		entries.push_back(e);
+
+		if (2 * GetSize(entries) > GetSize(hashtable))
+			rehash();
+		return wire;
+	}
+};
+
+void finish_lut(RTLIL::Const *lutptr, RTLIL::State lut_default_state)
+{
+	for (auto &bit : lutptr->bits)
+		if (bit == RTLIL::State::Sx)
+			bit = lut_default_state;
+}
+
+} /* namespace */
+
+void parse_blif(RTLIL::Design *design, const char *data, size_t size, std::string dff_name)
+{
+	BlifTokenizer tok(data, size);
+	RTLIL::Module *module = NULL;
+	BlifNetIndex *net_index = NULL;
+
+	RTLIL::Const *lutptr = NULL;
+	RTLIL::State lut_default_state = RTLIL::State::Sx;
+	int lut_width = 0;
+
+	std::vector<RTLIL::SigBit> sig_bits;
+	std::vector<std::pair<blif_token_t, blif_token_t>> gate_conns;
+
+	while (tok.next_line())
+	{
+		if (tok.at_command())
+		{
+			if (lutptr) {
+				finish_lut(lutptr, lut_default_state);
+				lutptr = NULL;
+			}
+
+			blif_token_t cmd = tok.next_token();
+
+			if (cmd == ".end" && module == NULL)
+				goto error;
+
+			if (cmd == ".model" || module == NULL)
+			{
+				// the .model line is optional, a file without one holds a single model called "netlist"
+				blif_token_t name;
+				if (cmd == ".model") {
+					if (module != NULL)
+						goto error;
+					name = tok.next_token();
+				}
+				module = new RTLIL::Module;
+				module->name = name.empty() ? RTLIL::IdString("\\netlist") : RTLIL::escape_id(name.as_string());
+				if (design->module(module->name))
+					log_error("Duplicate definition of module %s in line %d!\n", log_id(module->name), tok.line_count);
+				design->add(module);
+				net_index = new BlifNetIndex(module);
+				if (cmd == ".model") {
+					tok.finish_line();
+					continue;
+				}
+			}
+
+			if (cmd == ".end") {
+				module->fixup_ports();
+				module = NULL;
+				delete net_index;
+				net_index = NULL;
+				tok.finish_line();
+				continue;
+			}
+
+			if (cmd == ".inputs" || cmd == ".outputs") {
+				bool is_input = cmd == ".inputs";
+				for (blif_token_t p = tok.next_token(); !p.empty(); p = tok.next_token()) {
+					RTLIL::Wire *wire = (*net_index)(p);
+					if (is_input)
+						wire->port_input = true;
+					else
+						wire->port_output = true;
+				}
+				continue;
+			}
+
+			if (cmd == ".latch")
+			{
+				blif_token_t d = tok.next_token();
+				blif_token_t q = tok.next_token();
+				blif_token_t type = tok.next_token();
+				blif_token_t clock = type.empty() ? blif_token_t() : tok.next_token();
+
+				if (d.empty() || q.empty())
+					goto error;
+
+				RTLIL::Cell *cell;
+				if (!clock.empty() && clock != "NIL" && (type == "re" || type == "fe")) {
+					cell = module->addCell(NEW_ID, type == "re" ? "$_DFF_P_" : "$_DFF_N_");
+					cell->setPort("\\C", (*net_index)(clock));
+				} else
+					cell = module->addCell(NEW_ID, dff_name);
+
+				cell->setPort("\\D", (*net_index)(d));
+				cell->setPort("\\Q", (*net_index)(q));
+				tok.finish_line();
+				continue;
+			}
+
+			if (cmd == ".gate" || cmd == ".subckt")
+			{
+				blif_token_t type = tok.next_token();
+				if (type.empty())
+					goto error;
+
+				gate_conns.clear();
+				for (blif_token_t p = tok.next_token(); !p.empty(); p = tok.next_token()) {
+					const char *q = (const char*)memchr(p.str, '=', p.len);
+					if (q == NULL || q == p.str || q+1 == p.str+p.len)
+						goto error;
+					gate_conns.push_back(std::pair<blif_token_t, blif_token_t>(blif_token_t(p.str, q - p.str),
+							blif_token_t(q+1, p.str + p.len - (q+1))));
+				}
+
+				RTLIL::Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(type.as_string()));
+				for (auto &conn : gate_conns)
+					cell->setPort(RTLIL::escape_id(conn.first.as_string()), (*net_index)(conn.second));
+				continue;
+			}
+
+			if (cmd == ".names")
+			{
+				sig_bits.clear();
+				for (blif_token_t p = tok.next_token(); !p.empty(); p = tok.next_token())
+					sig_bits.push_back((*net_index)(p));
+
+				if (sig_bits.empty())
+					goto error;
+
+				RTLIL::SigBit output_bit = sig_bits.back();
+				sig_bits.pop_back();
+
+				if (sig_bits.empty())
+				{
+					// constant driver: an empty cover means constant zero
+					RTLIL::State state = RTLIL::State::S0;
+					while (tok.next_line() && !tok.at_command()) {
+						blif_token_t value = tok.next_token();
+						if (value == "1")
+							state = RTLIL::State::S1;
+						else if (value != "0")
+							goto error;
+						tok.finish_line();
+					}
+					module->connect(RTLIL::SigSig(output_bit, state));
+					continue;
+				}
+
+				lut_width = GetSize(sig_bits);
+				if (lut_width > 12)
+					log_error("LUT with %d inputs in line %d not supported (max. 12)!\n", lut_width, tok.line_count);
+
+				RTLIL::Cell *cell = module->addCell(NEW_ID, "$lut");
+				cell->parameters["\\WIDTH"] = RTLIL::Const(lut_width);
+				cell->parameters["\\LUT"] = RTLIL::Const(RTLIL::State::Sx, 1 << lut_width);
+				cell->setPort("\\A", RTLIL::SigSpec(sig_bits));
+				cell->setPort("\\Y", output_bit);
+				lutptr = &cell->parameters.at("\\LUT");
+				// an empty cover means constant zero, any cover line overrides this
+				lut_default_state = RTLIL::State::S0;
+				continue;
+			}
+
+			goto error;
+		}
+
+		if (lutptr == NULL)
+			goto error;
+
+		blif_token_t input = tok.next_token();
+		blif_token_t output = tok.next_token();
+
+		if (input.len != lut_width || (output != "0" && output != "1"))
+			goto error;
+
+		// all input patterns i with (i & care_mask) == value_mask are covered by this line
+		int care_mask = 0, value_mask = 0;
+		for (int j = 0; j < input.len; j++) {
+			if (input.str[j] == '-')
+				continue;
+			if (input.str[j] != '0' && input.str[j] != '1')
+				goto error;
+			care_mask |= 1 << j;
+			if (input.str[j] == '1')
+				value_mask |= 1 << j;
+		}
+
+		RTLIL::State state = output == "0" ? RTLIL::State::S0 : RTLIL::State::S1;
+		for (int i = 0; i < (1 << lut_width); i++)
+			if ((i & care_mask) == value_mask)
+				lutptr->bits[i] = state;
+
+		lut_default_state = output == "0" ? RTLIL::State::S1 : RTLIL::State::S0;
+		tok.finish_line();
+	}
+
+	if (lutptr)
+		finish_lut(lutptr, lut_default_state);
+
+	if (module != NULL) {
+		module->fixup_ports();
+		delete net_index;
+	}
+	return;
+
+error:
+	log_error("Syntax error in line %d!\n", tok.line_count);
+}
+
+void parse_blif(RTLIL::Design *design, std::string filename, std::string dff_name)
+{
+#ifndef _WIN32
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		log_error("Can't open BLIF file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if (data == MAP_FAILED)
+			log_error("Can't mmap BLIF file `%s': %s\n", filename.c_str(), strerror(errno));
+
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		parse_blif(design, (const char*)data, st.st_size, dff_name);
+		munmap(data, st.st_size);
+		return;
+	}
+
+	close(fd);
+#endif
+
+	std::ifstream f(filename.c_str(), std::ios::binary);
+	if (f.fail())
+		log_error("Can't open BLIF file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+	parse_blif(design, f, dff_name);
+}
+
+void parse_blif(RTLIL::Design *design, std::istream &f, std::string dff_name)
+{
+	std::string buffer;
+	char block[65536];
+
+	while (f.read(block, sizeof(block)) || f.gcount() > 0)
+		buffer.append(block, f.gcount());
+
+	parse_blif(design, buffer.data(), buffer.size(), dff_name);
+}
+
+struct BlifFrontend : public Frontend {
+	BlifFrontend() : Frontend("blif", "read BLIF file") { }
+	virtual void help()
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    read_blif [filename]\n");
+		log("\n");
+		log("Load modules from a BLIF file into the current design. Each .model section is\n");
+		log("imported as one module, a file without .model line is imported as a single\n");
+		log("module called 'netlist'. .names are imported as $lut cells, .gate and .subckt\n");
+		log("lines as cells of the given type and .latch lines with a re/fe clock as\n");
+		log("$_DFF_P_/$_DFF_N_ cells. All other .latch lines are imported as cells of\n");
+		log("type DFF with the ports D and Q.\n");
+		log("\n");
+	}
+	virtual void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design)
+	{
+		log_header("Executing BLIF frontend.\n");
+		extra_args(f, filename, args, 1);
+		log("Input filename: %s\n", filename.c_str());
+
+		// files on disk are mapped into memory directly, everything else
+		// (stdin, here documents) is read from the stream
+		struct stat st;
+		if (filename.substr(0, 2) != "<<" && filename != "<stdin>" && !stat(filename.c_str(), &st) && S_ISREG(st.st_mode))
+			parse_blif(design, filename, "\\DFF");
+		else
+			parse_blif(design, *f, "\\DFF");
+	}
+} BlifFrontend;
+
+YOSYS_NAMESPACE_END
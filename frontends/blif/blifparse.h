@@ -17,14 +17,16 @@
  *
  */
 
-#ifndef ABC_BLIFPARSE
-#define ABC_BLIFPARSE
+#ifndef BLIFPARSE_H
+#define BLIFPARSE_H
 
 #include "kernel/yosys.h"
 
 YOSYS_NAMESPACE_BEGIN
 
-extern RTLIL::Design *abc_parse_blif(FILE *f, std::string dff_name);
+extern void parse_blif(RTLIL::Design *design, const char *data, size_t size, std::string dff_name);
+extern void parse_blif(RTLIL::Design *design, std::istream &f, std::string dff_name);
+extern void parse_blif(RTLIL::Design *design, std::string filename, std::string dff_name);
 
 YOSYS_NAMESPACE_END
 
@@ -0,0 +1,419 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *  
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef BITSIM_H
+#define BITSIM_H
+
+#include "kernel/rtlil.h"
+#include "kernel/sigtools.h"
+#include "kernel/celltypes.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+/* compiled bit-parallel simulation of a combinational module. every signal bit is
+ * stored as a (value, undef) pair of words, so one pass evaluates num_lanes input
+ * vectors. cells are evaluated in topological order, simple logic cells, muxes and
+ * $alu cells bit-parallel and all other evaluable cells one vector at a time using
+ * CellTypes::eval(). */
+struct BitParallelSim
+{
+	typedef uint64_t word_t;
+	static const int num_words = 4;
+	static const int num_lanes = 64*num_words;
+
+	enum cell_kind_t {
+		KIND_BUF, KIND_NOT, KIND_AND, KIND_NAND, KIND_OR, KIND_NOR, KIND_XOR, KIND_XNOR, KIND_MUX, KIND_ALU, KIND_GENERIC
+	};
+
+	struct sim_cell_t {
+		RTLIL::Cell *cell;
+		cell_kind_t kind;
+		std::vector<int> a, b, c, d, s, y, x, co;
+	};
+
+	SigMap sigmap;
+	std::map<RTLIL::SigBit, int> bit_index;
+	std::vector<word_t> value, undef;
+	std::vector<sim_cell_t> sim_cells;
+	std::vector<int> input_bits, output_bits;
+	std::string fail_reason;
+	bool found_z;
+
+	int bit(RTLIL::SigBit b)
+	{
+		b = sigmap(b);
+		if (b.wire == NULL) {
+			if (b.data == RTLIL::State::Sz)
+				found_z = true;
+			return b.data == RTLIL::State::S0 ? 0 : b.data == RTLIL::State::S1 ? 1 : 2;
+		}
+		auto it = bit_index.find(b);
+		if (it != bit_index.end())
+			return it->second;
+		int idx = GetSize(value) / num_words;
+		value.resize(value.size() + num_words, 0);
+		undef.resize(undef.size() + num_words, 0);
+		bit_index[b] = idx;
+		return idx;
+	}
+
+	std::vector<int> bits(const RTLIL::SigSpec &sig, int width = -1, bool is_signed = false)
+	{
+		std::vector<int> result;
+		for (auto &b : sig)
+			result.push_back(bit(b));
+		if (width >= 0) {
+			int padding = is_signed && !result.empty() ? result.back() : 0;
+			result.resize(width, padding);
+		}
+		return result;
+	}
+
+	BitParallelSim(RTLIL::Module *module, const RTLIL::SigSpec &inputs, const RTLIL::SigSpec &outputs) : sigmap(module), found_z(false)
+	{
+		// indices 0, 1, 2 are the constants 0, 1 and x
+		value.resize(3*num_words, 0);
+		undef.resize(3*num_words, 0);
+		for (int k = 0; k < num_words; k++)
+			value[1*num_words + k] = ~word_t(0), undef[2*num_words + k] = ~word_t(0);
+
+		input_bits = bits(inputs);
+		output_bits = bits(outputs);
+
+		CellTypes ct;
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		std::map<RTLIL::SigBit, RTLIL::Cell*> bit_drivers;
+		for (auto &it : module->cells_) {
+			RTLIL::Cell *cell = it.second;
+			for (auto &conn : cell->connections())
+				if (ct.cell_output(cell->type, conn.first) || !ct.cell_known(cell->type))
+					for (auto b : sigmap(conn.second))
+						if (b.wire != NULL)
+							bit_drivers[b] = cell;
+		}
+
+		std::set<int> leaf_bits(input_bits.begin(), input_bits.end());
+		std::map<RTLIL::Cell*, int> cell_state;
+		std::vector<std::pair<RTLIL::Cell*, bool>> stack;
+
+		for (auto &b : sigmap(outputs))
+		{
+			if (b.wire == NULL || leaf_bits.count(bit(b)) || bit_drivers.count(b) == 0) {
+				if (b.wire != NULL && !leaf_bits.count(bit(b)))
+					fail_reason = stringf("undriven signal %s", log_signal(b));
+				continue;
+			}
+
+			stack.push_back(std::make_pair(bit_drivers.at(b), false));
+			while (!stack.empty() && fail_reason.empty())
+			{
+				RTLIL::Cell *cell = stack.back().first;
+				bool post_order = stack.back().second;
+				stack.pop_back();
+
+				if (post_order) {
+					cell_state[cell] = 2;
+					add_cell(cell);
+					continue;
+				}
+
+				if (cell_state[cell] == 2)
+					continue;
+				if (cell_state[cell] == 1) {
+					fail_reason = stringf("logic loop through cell %s", log_id(cell));
+					break;
+				}
+
+				if (!ct.cell_evaluable(cell->type) || cell->type.in("$lcu", "$fa", "$macc") || !cell->hasPort("\\Y")) {
+					fail_reason = stringf("cell %s of type %s", log_id(cell), log_id(cell->type));
+					break;
+				}
+
+				cell_state[cell] = 1;
+				stack.push_back(std::make_pair(cell, true));
+
+				for (auto &conn : cell->connections()) {
+					if (!ct.cell_input(cell->type, conn.first))
+						continue;
+					for (auto b : sigmap(conn.second)) {
+						if (b.wire == NULL || leaf_bits.count(bit(b)))
+							continue;
+						if (bit_drivers.count(b) == 0) {
+							fail_reason = stringf("undriven signal %s", log_signal(b));
+							break;
+						}
+						RTLIL::Cell *driver = bit_drivers.at(b);
+						if (cell_state[driver] == 1) {
+							fail_reason = stringf("logic loop through cell %s", log_id(driver));
+							break;
+						}
+						if (cell_state[driver] == 0)
+							stack.push_back(std::make_pair(driver, false));
+					}
+				}
+			}
+
+			if (!fail_reason.empty())
+				break;
+		}
+
+		// ConstEval passes z bits through some cells, here they would become x
+		if (fail_reason.empty() && found_z)
+			fail_reason = "constant z bits";
+	}
+
+	void add_cell(RTLIL::Cell *cell)
+	{
+		sim_cell_t sc;
+		sc.cell = cell;
+		sc.kind = KIND_GENERIC;
+
+		bool signed_a = cell->parameters.count("\\A_SIGNED") > 0 && cell->parameters["\\A_SIGNED"].as_bool();
+		bool signed_b = cell->parameters.count("\\B_SIGNED") > 0 && cell->parameters["\\B_SIGNED"].as_bool();
+		int width = GetSize(cell->getPort("\\Y"));
+
+		if (cell->type.in("$_BUF_", "$pos")) sc.kind = KIND_BUF;
+		if (cell->type.in("$_NOT_", "$not")) sc.kind = KIND_NOT;
+		if (cell->type.in("$_AND_", "$and")) sc.kind = KIND_AND;
+		if (cell->type.in("$_NAND_")) sc.kind = KIND_NAND;
+		if (cell->type.in("$_OR_", "$or")) sc.kind = KIND_OR;
+		if (cell->type.in("$_NOR_")) sc.kind = KIND_NOR;
+		if (cell->type.in("$_XOR_", "$xor")) sc.kind = KIND_XOR;
+		if (cell->type.in("$_XNOR_", "$xnor")) sc.kind = KIND_XNOR;
+		if (cell->type.in("$_MUX_", "$mux", "$pmux")) sc.kind = KIND_MUX;
+		if (cell->type == "$alu") sc.kind = KIND_ALU;
+
+		if (sc.kind == KIND_ALU) {
+			// inputs wider than Y are kept, undef bits there still make Y undef
+			sc.a = bits(cell->getPort("\\A"), std::max(width, GetSize(cell->getPort("\\A"))), signed_a);
+			sc.b = bits(cell->getPort("\\B"), std::max(width, GetSize(cell->getPort("\\B"))), signed_b);
+			sc.c = bits(cell->getPort("\\CI"));
+			sc.d = bits(cell->getPort("\\BI"));
+			sc.x = bits(cell->getPort("\\X"));
+			sc.co = bits(cell->getPort("\\CO"));
+		} else if (sc.kind == KIND_GENERIC || sc.kind == KIND_MUX) {
+			if (cell->hasPort("\\A"))
+				sc.a = bits(cell->getPort("\\A"));
+			if (cell->hasPort("\\B"))
+				sc.b = bits(cell->getPort("\\B"));
+			if (cell->type.in("$_AOI3_", "$_OAI3_", "$_AOI4_", "$_OAI4_")) {
+				if (cell->hasPort("\\C"))
+					sc.c = bits(cell->getPort("\\C"));
+				if (cell->hasPort("\\D"))
+					sc.d = bits(cell->getPort("\\D"));
+			}
+			if (cell->hasPort("\\S"))
+				sc.s = bits(cell->getPort("\\S"));
+		} else {
+			sc.a = bits(cell->getPort("\\A"), width, signed_a);
+			if (cell->hasPort("\\B"))
+				sc.b = bits(cell->getPort("\\B"), width, signed_b);
+		}
+
+		sc.y = bits(cell->getPort("\\Y"));
+		sim_cells.push_back(sc);
+	}
+
+	void set_inputs(uint64_t base)
+	{
+		static const word_t lane_patterns[6] = {
+			0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+			0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL
+		};
+
+		for (int i = 0; i < GetSize(input_bits); i++)
+		for (int k = 0; k < num_words; k++) {
+			uint64_t first_vector = base + 64*k;
+			word_t w = i < 6 ? lane_patterns[i] : ((first_vector >> i) & 1) ? ~word_t(0) : 0;
+			value[input_bits[i]*num_words + k] = w;
+			undef[input_bits[i]*num_words + k] = 0;
+		}
+	}
+
+	RTLIL::State get_lane(int idx, int lane) const
+	{
+		word_t mask = word_t(1) << (lane % 64);
+		if (undef[idx*num_words + lane/64] & mask)
+			return RTLIL::State::Sx;
+		return (value[idx*num_words + lane/64] & mask) ? RTLIL::State::S1 : RTLIL::State::S0;
+	}
+
+	RTLIL::Const get_lane(const std::vector<int> &sig, int lane) const
+	{
+		RTLIL::Const result;
+		for (int idx : sig)
+			result.bits.push_back(get_lane(idx, lane));
+		return result;
+	}
+
+	void set_lane(int idx, int lane, RTLIL::State state)
+	{
+		word_t mask = word_t(1) << (lane % 64);
+		word_t &v = value[idx*num_words + lane/64], &x = undef[idx*num_words + lane/64];
+		v &= ~mask, x &= ~mask;
+		if (state == RTLIL::State::S1)
+			v |= mask;
+		else if (state != RTLIL::State::S0)
+			x |= mask;
+	}
+
+	void eval_mux(const sim_cell_t &sc)
+	{
+		int width = GetSize(sc.y);
+
+		for (int k = 0; k < num_words; k++)
+		{
+			// the A input is a candidate only if no select bit is definitely set
+			word_t any_s1 = 0;
+			for (int idx : sc.s)
+				any_s1 |= value[idx*num_words + k];
+
+			for (int j = 0; j < width; j++)
+			{
+				word_t have = 0, rv = 0, rx = 0;
+				auto merge = [&](int idx, word_t m) {
+					word_t cv = value[idx*num_words + k], cx = undef[idx*num_words + k];
+					word_t first = m & ~have, both = m & have;
+					rx = (rx & ~m) | (cx & first) | ((rx | cx | (rv ^ cv)) & both);
+					rv = (rv & ~first) | (cv & first);
+					have |= m;
+				};
+
+				for (int i = 0; i < GetSize(sc.s); i++)
+					merge(sc.b[i*width + j], value[sc.s[i]*num_words + k] | undef[sc.s[i]*num_words + k]);
+				merge(sc.a[j], ~any_s1);
+
+				value[sc.y[j]*num_words + k] = rv & ~rx;
+				undef[sc.y[j]*num_words + k] = rx;
+			}
+		}
+	}
+
+	// same undef semantics as ConstEval: X is undef per bit, Y and CO are
+	// undef as a whole as soon as any input bit is undef
+	void eval_alu(const sim_cell_t &sc)
+	{
+		for (int k = 0; k < num_words; k++)
+		{
+			word_t any_x = undef[sc.c[0]*num_words + k] | undef[sc.d[0]*num_words + k];
+			for (int idx : sc.a)
+				any_x |= undef[idx*num_words + k];
+			for (int idx : sc.b)
+				any_x |= undef[idx*num_words + k];
+
+			word_t bi = value[sc.d[0]*num_words + k], carry = value[sc.c[0]*num_words + k];
+			for (int i = 0; i < GetSize(sc.y); i++)
+			{
+				word_t av = value[sc.a[i]*num_words + k], bv = value[sc.b[i]*num_words + k] ^ bi;
+				word_t xx = undef[sc.a[i]*num_words + k] | undef[sc.b[i]*num_words + k] | undef[sc.d[0]*num_words + k];
+
+				value[sc.x[i]*num_words + k] = (av ^ bv) & ~xx;
+				undef[sc.x[i]*num_words + k] = xx;
+
+				value[sc.y[i]*num_words + k] = (av ^ bv ^ carry) & ~any_x;
+				undef[sc.y[i]*num_words + k] = any_x;
+
+				carry = (av & bv) | (av & carry) | (bv & carry);
+				value[sc.co[i]*num_words + k] = carry & ~any_x;
+				undef[sc.co[i]*num_words + k] = any_x;
+			}
+		}
+	}
+
+	void eval_generic(const sim_cell_t &sc, int num_valid_lanes)
+	{
+		for (int lane = 0; lane < num_valid_lanes; lane++) {
+			RTLIL::Const result = CellTypes::eval(sc.cell, get_lane(sc.a, lane), get_lane(sc.b, lane),
+					get_lane(sc.c, lane), get_lane(sc.d, lane));
+			for (int i = 0; i < GetSize(sc.y); i++)
+				set_lane(sc.y[i], lane, i < GetSize(result) ? result.bits[i] : RTLIL::State::Sx);
+		}
+	}
+
+	void eval(int num_valid_lanes)
+	{
+		for (auto &sc : sim_cells)
+		{
+			if (sc.kind == KIND_MUX) {
+				eval_mux(sc);
+				continue;
+			}
+
+			if (sc.kind == KIND_ALU) {
+				eval_alu(sc);
+				continue;
+			}
+
+			if (sc.kind == KIND_GENERIC) {
+				eval_generic(sc, num_valid_lanes);
+				continue;
+			}
+
+			for (int i = 0; i < GetSize(sc.y); i++)
+			for (int k = 0; k < num_words; k++)
+			{
+				word_t av = value[sc.a[i]*num_words + k], ax = undef[sc.a[i]*num_words + k];
+				word_t bv = 0, bx = 0, yv = 0, yx = 0;
+
+				if (!sc.b.empty())
+					bv = value[sc.b[i]*num_words + k], bx = undef[sc.b[i]*num_words + k];
+
+				switch (sc.kind)
+				{
+				case KIND_BUF:
+					yv = av, yx = ax;
+					break;
+				case KIND_NOT:
+					yv = ~av & ~ax, yx = ax;
+					break;
+				case KIND_AND:
+				case KIND_NAND:
+					yx = (ax | bx) & (av | ax) & (bv | bx);
+					yv = av & bv;
+					if (sc.kind == KIND_NAND)
+						yv = ~yv & ~yx;
+					break;
+				case KIND_OR:
+				case KIND_NOR:
+					yx = (ax | bx) & ~av & ~bv;
+					yv = av | bv;
+					if (sc.kind == KIND_NOR)
+						yv = ~yv & ~yx;
+					break;
+				case KIND_XOR:
+				case KIND_XNOR:
+					yx = ax | bx;
+					yv = (sc.kind == KIND_XOR ? av ^ bv : ~(av ^ bv)) & ~yx;
+					break;
+				default:
+					log_abort();
+				}
+
+				value[sc.y[i]*num_words + k] = yv;
+				undef[sc.y[i]*num_words + k] = yx;
+			}
+		}
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
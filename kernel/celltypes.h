@@ -273,7 +273,7 @@ struct CellTypes
 		if (type == "$_OR_")
 			return const_or(arg1, arg2, false, false, 1);
 		if (type == "$_NOR_")
-			return eval_not(const_and(arg1, arg2, false, false, 1));
+			return eval_not(const_or(arg1, arg2, false, false, 1));
 		if (type == "$_XOR_")
 			return const_xor(arg1, arg2, false, false, 1);
 		if (type == "$_XNOR_")
@@ -361,6 +361,86 @@ struct CellTypes
 		log_assert(arg4.bits.size() == 0);
 		return eval(cell, arg1, arg2, arg3);
 	}
+
+	static bool is_fully_def(const RTLIL::Const &v)
+	{
+		for (auto bit : v.bits)
+			if (bit != RTLIL::S0 && bit != RTLIL::S1)
+				return false;
+		return true;
+	}
+
+	// $lcu, $fa and $alu have more than one output port. $lcu and the Y and CO
+	// outputs of $alu are undef as a whole as soon as any input bit is undef.
+
+	static RTLIL::Const eval_lcu(const RTLIL::Const &p, const RTLIL::Const &g, const RTLIL::Const &ci)
+	{
+		RTLIL::Const co(RTLIL::Sx, GetSize(p));
+
+		if (is_fully_def(p) && is_fully_def(g) && is_fully_def(ci)) {
+			bool carry = ci.as_bool();
+			for (int i = 0; i < GetSize(co); i++) {
+				carry = (g.bits[i] == RTLIL::S1) || (p.bits[i] == RTLIL::S1 && carry);
+				co.bits[i] = carry ? RTLIL::S1 : RTLIL::S0;
+			}
+		}
+
+		return co;
+	}
+
+	static void eval_fa(const RTLIL::Const &a, const RTLIL::Const &b, const RTLIL::Const &c, RTLIL::Const &x, RTLIL::Const &y)
+	{
+		int width = GetSize(c);
+
+		RTLIL::Const t1 = const_xor(a, b, false, false, width);
+		y = const_xor(t1, c, false, false, width);
+
+		RTLIL::Const t2 = const_and(a, b, false, false, width);
+		RTLIL::Const t3 = const_and(c, t1, false, false, width);
+		x = const_or(t2, t3, false, false, width);
+
+		for (int i = 0; i < GetSize(y); i++)
+			if (y.bits[i] == RTLIL::Sx)
+				x.bits[i] = RTLIL::Sx;
+	}
+
+	static void eval_alu(RTLIL::Cell *cell, const RTLIL::Const &arg_a, const RTLIL::Const &arg_b, const RTLIL::Const &ci, const RTLIL::Const &bi,
+			RTLIL::Const &x, RTLIL::Const &y, RTLIL::Const &co)
+	{
+		bool signed_a = cell->parameters.count("\\A_SIGNED") > 0 && cell->parameters["\\A_SIGNED"].as_bool();
+		bool signed_b = cell->parameters.count("\\B_SIGNED") > 0 && cell->parameters["\\B_SIGNED"].as_bool();
+		int width = GetSize(cell->getPort("\\Y"));
+
+		bool any_input_undef = !(is_fully_def(arg_a) && is_fully_def(arg_b) && is_fully_def(ci) && is_fully_def(bi));
+		RTLIL::Const a = const_pos(arg_a, RTLIL::Const(), signed_a, false, width);
+		RTLIL::Const b = const_pos(arg_b, RTLIL::Const(), signed_b, false, width);
+
+		bool bi_def = bi.bits.at(0) == RTLIL::S0 || bi.bits.at(0) == RTLIL::S1;
+		bool carry = ci.bits.at(0) == RTLIL::S1;
+		bool b_inv = bi.bits.at(0) == RTLIL::S1;
+
+		x = RTLIL::Const(RTLIL::Sx, width);
+		y = RTLIL::Const(RTLIL::Sx, width);
+		co = RTLIL::Const(RTLIL::Sx, width);
+
+		for (int i = 0; i < width; i++)
+		{
+			bool a_def = a.bits[i] == RTLIL::S0 || a.bits[i] == RTLIL::S1;
+			bool b_def = b.bits[i] == RTLIL::S0 || b.bits[i] == RTLIL::S1;
+			bool bit_a = a.bits[i] == RTLIL::S1;
+			bool bit_b = (b.bits[i] == RTLIL::S1) != b_inv;
+
+			if (a_def && b_def && bi_def)
+				x.bits[i] = bit_a != bit_b ? RTLIL::S1 : RTLIL::S0;
+
+			if (!any_input_undef) {
+				bool bit_y = (bit_a != bit_b) != carry;
+				carry = (bit_a && bit_b) || (bit_a && carry) || (bit_b && carry);
+				y.bits[i] = bit_y ? RTLIL::S1 : RTLIL::S0;
+				co.bits[i] = carry ? RTLIL::S1 : RTLIL::S0;
+			}
+		}
+	}
 };
 
 YOSYS_NAMESPACE_END
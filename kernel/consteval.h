@@ -31,110 +31,253 @@ struct ConstEval
 {
 	RTLIL::Module *module;
 	SigMap assign_map;
-	SigMap values_map;
-	SigPool stop_signals;
-	SigSet<RTLIL::Cell*> sig2driver;
-	std::set<RTLIL::Cell*> busy;
-	std::vector<SigMap> stack;
-
-	ConstEval(RTLIL::Module *module) : module(module), assign_map(module)
+	CellTypes ct;
+
+	// computed once per module: an index for each signal bit, the driver
+	// cell of each bit and the cells in topological order. cells that are
+	// part of (or driven by) a logic loop are marked in cell_in_loop and
+	// only those need the busy check during evaluation.
+	std::map<RTLIL::SigBit, int> bit_index;
+	std::map<RTLIL::Cell*, int> cell_index;
+	std::vector<RTLIL::Cell*> cells;
+	std::vector<int> bit_driver;
+	std::vector<char> cell_in_loop, cell_busy;
+
+	// current values. push() and pop() use an undo log of the bits that
+	// got a value since the last push() instead of copying all values.
+	std::vector<RTLIL::State> bit_value;
+	std::vector<char> bit_has_value, bit_stop;
+	std::vector<int> undo_log, stack;
+	int num_stop_bits;
+
+	ConstEval(RTLIL::Module *module) : module(module), assign_map(module), num_stop_bits(0)
 	{
-		CellTypes ct;
 		ct.setup_internals();
 		ct.setup_stdcells();
 
 		for (auto &it : module->cells_) {
 			if (!ct.cell_known(it.second->type))
 				continue;
-			for (auto &it2 : it.second->connections())
-				if (ct.cell_output(it.second->type, it2.first))
-					sig2driver.insert(assign_map(it2.second), it.second);
+			cell_index[it.second] = GetSize(cells);
+			cells.push_back(it.second);
+		}
+
+		for (int i = 0; i < GetSize(cells); i++)
+			for (auto &conn : cells[i]->connections())
+				if (ct.cell_output(cells[i]->type, conn.first))
+					for (auto &b : conn.second) {
+						int idx = bit(b);
+						if (idx >= 0)
+							bit_driver[idx] = i;
+					}
+
+		std::vector<std::set<int>> cell_users(GetSize(cells));
+		std::vector<int> num_deps(GetSize(cells));
+		for (int i = 0; i < GetSize(cells); i++) {
+			std::set<int> deps;
+			for (auto &conn : cells[i]->connections())
+				if (!ct.cell_output(cells[i]->type, conn.first))
+					for (auto &b : conn.second) {
+						int idx = bit(b);
+						if (idx >= 0 && bit_driver[idx] >= 0)
+							deps.insert(bit_driver[idx]);
+					}
+			for (int d : deps)
+				cell_users[d].insert(i);
+			num_deps[i] = GetSize(deps);
 		}
+
+		std::vector<int> queue;
+		for (int i = 0; i < GetSize(cells); i++)
+			if (num_deps[i] == 0)
+				queue.push_back(i);
+		for (int i = 0; i < GetSize(queue); i++)
+			for (int user : cell_users[queue[i]])
+				if (--num_deps[user] == 0)
+					queue.push_back(user);
+
+		cell_in_loop.resize(GetSize(cells), 1);
+		cell_busy.resize(GetSize(cells), 0);
+		for (int i : queue)
+			cell_in_loop[i] = 0;
+
+		// renumber the cells in topological order, loop cells last
+		std::vector<int> new_index(GetSize(cells), -1);
+		std::vector<RTLIL::Cell*> sorted_cells;
+		for (int i : queue)
+			new_index[i] = GetSize(sorted_cells), sorted_cells.push_back(cells[i]);
+		for (int i = 0; i < GetSize(cells); i++)
+			if (new_index[i] < 0)
+				new_index[i] = GetSize(sorted_cells), sorted_cells.push_back(cells[i]);
+		for (auto &d : bit_driver)
+			if (d >= 0)
+				d = new_index[d];
+		std::vector<char> sorted_in_loop(GetSize(cells));
+		for (int i = 0; i < GetSize(cells); i++)
+			sorted_in_loop[new_index[i]] = cell_in_loop[i];
+		cells.swap(sorted_cells);
+		cell_in_loop.swap(sorted_in_loop);
+		for (int i = 0; i < GetSize(cells); i++)
+			cell_index[cells[i]] = i;
+	}
+
+	// returns the index of a (not yet mapped) signal bit, or -1 for constants
+	int bit(const RTLIL::SigBit &b)
+	{
+		RTLIL::SigBit mapped = assign_map(b);
+		if (mapped.wire == NULL)
+			return -1;
+		auto it = bit_index.find(mapped);
+		if (it != bit_index.end())
+			return it->second;
+		int idx = GetSize(bit_value);
+		bit_index[mapped] = idx;
+		bit_driver.push_back(-1);
+		bit_value.push_back(RTLIL::State::Sx);
+		bit_has_value.push_back(0);
+		bit_stop.push_back(0);
+		return idx;
 	}
 
 	void clear()
 	{
-		values_map.clear();
-		stop_signals.clear();
+		for (auto &v : bit_has_value)
+			v = 0;
+		for (auto &v : bit_stop)
+			v = 0;
+		num_stop_bits = 0;
+		undo_log.clear();
+		stack.clear();
 	}
 
 	void push()
 	{
-		stack.push_back(values_map);
+		stack.push_back(GetSize(undo_log));
 	}
 
 	void pop()
 	{
-		values_map.swap(stack.back());
+		while (GetSize(undo_log) > stack.back()) {
+			bit_has_value[undo_log.back()] = 0;
+			undo_log.pop_back();
+		}
 		stack.pop_back();
 	}
 
 	void set(RTLIL::SigSpec sig, RTLIL::Const value)
 	{
 		assign_map.apply(sig);
-#ifndef NDEBUG
-		RTLIL::SigSpec current_val = values_map(sig);
-		for (int i = 0; i < GetSize(current_val); i++)
-			log_assert(current_val[i].wire != NULL || current_val[i] == value.bits[i]);
-#endif
-		values_map.add(sig, RTLIL::SigSpec(value));
+		for (int i = 0; i < GetSize(sig); i++) {
+			if (sig[i].wire == NULL) {
+				log_assert(sig[i] == value.bits[i]);
+				continue;
+			}
+			int idx = bit(sig[i]);
+			if (bit_has_value[idx]) {
+				log_assert(bit_value[idx] == value.bits[i]);
+			} else {
+				bit_has_value[idx] = 1;
+				if (!stack.empty())
+					undo_log.push_back(idx);
+			}
+			bit_value[idx] = value.bits[i];
+		}
 	}
 
 	void stop(RTLIL::SigSpec sig)
+	{
+		for (auto &b : sig) {
+			int idx = bit(b);
+			if (idx >= 0 && !bit_stop[idx])
+				bit_stop[idx] = 1, num_stop_bits++;
+		}
+	}
+
+	// replace the bits of a mapped signal that have a value by that value
+	void apply_values(RTLIL::SigSpec &sig)
+	{
+		for (auto &b : sig)
+			if (b.wire != NULL) {
+				int idx = bit(b);
+				if (bit_has_value[idx])
+					b = bit_value[idx];
+			}
+	}
+
+	RTLIL::SigSpec values(RTLIL::SigSpec sig)
 	{
 		assign_map.apply(sig);
-		stop_signals.add(sig);
+		apply_values(sig);
+		return sig;
+	}
+
+	// true if all non-constant bits of the signal are stop signals
+	bool is_stopped(RTLIL::SigSpec sig)
+	{
+		for (auto &b : sig)
+			if (b.wire != NULL && !bit_stop[bit(b)])
+				return false;
+		return true;
 	}
 
 	bool eval(RTLIL::Cell *cell, RTLIL::SigSpec &undef)
 	{
+		if (cell_index.count(cell) == 0) {
+			// cells added after construction are not levelized, so they always
+			// get the loop check. their outputs are registered as driven by them.
+			int idx = GetSize(cells);
+			cell_index[cell] = idx;
+			cells.push_back(cell);
+			cell_in_loop.push_back(1);
+			cell_busy.push_back(0);
+			for (auto &conn : cell->connections())
+				if (ct.cell_output(cell->type, conn.first))
+					for (auto &b : conn.second) {
+						int bit_idx = bit(b);
+						if (bit_idx >= 0)
+							bit_driver[bit_idx] = idx;
+					}
+		}
+		return eval(cell_index.at(cell), undef);
+	}
+
+	bool eval(int cell_idx, RTLIL::SigSpec &undef)
+	{
+		RTLIL::Cell *cell = cells[cell_idx];
+
 		if (cell->type == "$lcu")
 		{
 			RTLIL::SigSpec sig_p = cell->getPort("\\P");
 			RTLIL::SigSpec sig_g = cell->getPort("\\G");
 			RTLIL::SigSpec sig_ci = cell->getPort("\\CI");
-			RTLIL::SigSpec sig_co = values_map(assign_map(cell->getPort("\\CO")));
+			RTLIL::SigSpec sig_co = values(cell->getPort("\\CO"));
 
 			if (sig_co.is_fully_const())
 				return true;
 
-			if (!eval(sig_p, undef, cell))
+			if (!eval(sig_p, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_g, undef, cell))
+			if (!eval(sig_g, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_ci, undef, cell))
+			if (!eval(sig_ci, undef, cell_idx))
 				return false;
 
-			if (sig_p.is_fully_def() && sig_g.is_fully_def() && sig_ci.is_fully_def())
-			{
-				RTLIL::Const coval(RTLIL::Sx, GetSize(sig_co));
-				bool carry = sig_ci.as_bool();
-
-				for (int i = 0; i < GetSize(coval); i++) {
-					carry = (sig_g[i] == RTLIL::S1) || (sig_p[i] == RTLIL::S1 && carry);
-					coval.bits[i] = carry ? RTLIL::S1 : RTLIL::S0;
-				}
-
-				set(sig_co, coval);
-			}
-			else
-				set(sig_co, RTLIL::Const(RTLIL::Sx, GetSize(sig_co)));
-
+			set(sig_co, CellTypes::eval_lcu(sig_p.as_const(), sig_g.as_const(), sig_ci.as_const()));
 			return true;
 		}
 
 		RTLIL::SigSpec sig_a, sig_b, sig_s, sig_y;
 
 		log_assert(cell->hasPort("\\Y"));
-		sig_y = values_map(assign_map(cell->getPort("\\Y")));
+		sig_y = values(cell->getPort("\\Y"));
 		if (sig_y.is_fully_const())
 			return true;
 
 		if (cell->hasPort("\\S")) {
 			sig_s = cell->getPort("\\S");
-			if (!eval(sig_s, undef, cell))
+			if (!eval(sig_s, undef, cell_idx))
 				return false;
 		}
 
@@ -172,7 +315,7 @@ struct ConstEval
 
 			log_assert(y_candidates.size() > 0);
 			for (auto &yc : y_candidates) {
-				if (!eval(yc, undef, cell))
+				if (!eval(yc, undef, cell_idx))
 					return false;
 				y_values.push_back(yc.as_const());
 			}
@@ -197,100 +340,58 @@ struct ConstEval
 		else if (cell->type == "$fa")
 		{
 			RTLIL::SigSpec sig_c = cell->getPort("\\C");
-			RTLIL::SigSpec sig_x = cell->getPort("\\X");
-			int width = GetSize(sig_c);
 
-			if (!eval(sig_a, undef, cell))
+			if (!eval(sig_a, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_b, undef, cell))
+			if (!eval(sig_b, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_c, undef, cell))
+			if (!eval(sig_c, undef, cell_idx))
 				return false;
 
-			RTLIL::Const t1 = const_xor(sig_a.as_const(), sig_b.as_const(), false, false, width);
-			RTLIL::Const val_y = const_xor(t1, sig_c.as_const(), false, false, width);
-
-			RTLIL::Const t2 = const_and(sig_a.as_const(), sig_b.as_const(), false, false, width);
-			RTLIL::Const t3 = const_and(sig_c.as_const(), t1, false, false, width);
-			RTLIL::Const val_x = const_or(t2, t3, false, false, width);
-
-			for (int i = 0; i < GetSize(val_y); i++)
-				if (val_y.bits[i] == RTLIL::Sx)
-					val_x.bits[i] = RTLIL::Sx;
+			RTLIL::Const val_x, val_y;
+			CellTypes::eval_fa(sig_a.as_const(), sig_b.as_const(), sig_c.as_const(), val_x, val_y);
 
 			set(sig_y, val_y);
-			set(sig_x, val_x);
+			set(cell->getPort("\\X"), val_x);
 		}
 		else if (cell->type == "$alu")
 		{
-			bool signed_a = cell->parameters.count("\\A_SIGNED") > 0 && cell->parameters["\\A_SIGNED"].as_bool();
-			bool signed_b = cell->parameters.count("\\B_SIGNED") > 0 && cell->parameters["\\B_SIGNED"].as_bool();
-
 			RTLIL::SigSpec sig_ci = cell->getPort("\\CI");
 			RTLIL::SigSpec sig_bi = cell->getPort("\\BI");
 
-			if (!eval(sig_a, undef, cell))
+			if (!eval(sig_a, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_b, undef, cell))
+			if (!eval(sig_b, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_ci, undef, cell))
+			if (!eval(sig_ci, undef, cell_idx))
 				return false;
 
-			if (!eval(sig_bi, undef, cell))
+			if (!eval(sig_bi, undef, cell_idx))
 				return false;
 
-			RTLIL::SigSpec sig_x = cell->getPort("\\X");
-			RTLIL::SigSpec sig_co = cell->getPort("\\CO");
-
-			bool any_input_undef = !(sig_a.is_fully_def() && sig_b.is_fully_def() && sig_ci.is_fully_def() && sig_bi.is_fully_def());
-			sig_a.extend_u0(GetSize(sig_y), signed_a);
-			sig_b.extend_u0(GetSize(sig_y), signed_b);
+			RTLIL::Const val_x, val_y, val_co;
+			CellTypes::eval_alu(cell, sig_a.as_const(), sig_b.as_const(), sig_ci.as_const(), sig_bi.as_const(), val_x, val_y, val_co);
 
-			bool carry = sig_ci[0] == RTLIL::S1;
-			bool b_inv = sig_bi[0] == RTLIL::S1;
-
-			for (int i = 0; i < GetSize(sig_y); i++)
-			{
-				RTLIL::SigSpec x_inputs = { sig_a[i], sig_b[i], sig_bi[0] };
-
-				if (!x_inputs.is_fully_def()) {
-					set(sig_x[i], RTLIL::Sx);
-				} else {
-					bool bit_a = sig_a[i] == RTLIL::S1;
-					bool bit_b = (sig_b[i] == RTLIL::S1) != b_inv;
-					bool bit_x = bit_a != bit_b;
-					set(sig_x[i], bit_x ? RTLIL::S1 : RTLIL::S0);
-				}
-
-				if (any_input_undef) {
-					set(sig_y[i], RTLIL::Sx);
-					set(sig_co[i], RTLIL::Sx);
-				} else {
-					bool bit_a = sig_a[i] == RTLIL::S1;
-					bool bit_b = (sig_b[i] == RTLIL::S1) != b_inv;
-					bool bit_y = (bit_a != bit_b) != carry;
-					carry = (bit_a && bit_b) || (bit_a && carry) || (bit_b && carry);
-					set(sig_y[i], bit_y ? RTLIL::S1 : RTLIL::S0);
-					set(sig_co[i], carry ? RTLIL::S1 : RTLIL::S0);
-				}
-			}
+			set(cell->getPort("\\X"), val_x);
+			set(sig_y, val_y);
+			set(cell->getPort("\\CO"), val_co);
 		}
 		else if (cell->type == "$macc")
 		{
 			Macc macc;
 			macc.from_cell(cell);
 
-			if (!eval(macc.bit_ports, undef, cell))
+			if (!eval(macc.bit_ports, undef, cell_idx))
 				return false;
 
 			for (auto &port : macc.ports) {
-				if (!eval(port.in_a, undef, cell))
+				if (!eval(port.in_a, undef, cell_idx))
 					return false;
-				if (!eval(port.in_b, undef, cell))
+				if (!eval(port.in_b, undef, cell_idx))
 					return false;
 			}
 
@@ -311,13 +412,13 @@ struct ConstEval
 					sig_d = cell->getPort("\\D");
 			}
 
-			if (sig_a.size() > 0 && !eval(sig_a, undef, cell))
+			if (sig_a.size() > 0 && !eval(sig_a, undef, cell_idx))
 				return false;
-			if (sig_b.size() > 0 && !eval(sig_b, undef, cell))
+			if (sig_b.size() > 0 && !eval(sig_b, undef, cell_idx))
 				return false;
-			if (sig_c.size() > 0 && !eval(sig_c, undef, cell))
+			if (sig_c.size() > 0 && !eval(sig_c, undef, cell_idx))
 				return false;
-			if (sig_d.size() > 0 && !eval(sig_d, undef, cell))
+			if (sig_d.size() > 0 && !eval(sig_d, undef, cell_idx))
 				return false;
 
 			set(sig_y, CellTypes::eval(cell, sig_a.as_const(), sig_b.as_const(),
@@ -327,41 +428,53 @@ struct ConstEval
 		return true;
 	}
 
-	bool eval(RTLIL::SigSpec &sig, RTLIL::SigSpec &undef, RTLIL::Cell *busy_cell = NULL)
+	bool eval(RTLIL::SigSpec &sig, RTLIL::SigSpec &undef, int busy_cell = -1)
 	{
 		assign_map.apply(sig);
-		values_map.apply(sig);
+		apply_values(sig);
 
 		if (sig.is_fully_const())
 			return true;
 
-		if (stop_signals.check_any(sig)) {
-			undef = stop_signals.extract(sig);
-			return false;
+		if (num_stop_bits > 0) {
+			RTLIL::SigSpec stopped;
+			for (auto &b : sig)
+				if (b.wire != NULL && bit_stop[bit(b)])
+					stopped.append(b);
+			if (GetSize(stopped) > 0) {
+				undef = stopped;
+				return false;
+			}
 		}
 
-		if (busy_cell) {
-			if (busy.count(busy_cell) > 0) {
+		if (busy_cell >= 0 && cell_in_loop[busy_cell]) {
+			if (cell_busy[busy_cell]) {
 				undef = sig;
 				return false;
 			}
-			busy.insert(busy_cell);
+			cell_busy[busy_cell] = 1;
 		}
 
-		std::set<RTLIL::Cell*> driver_cells;
-		sig2driver.find(sig, driver_cells);
-		for (auto cell : driver_cells) {
-			if (!eval(cell, undef)) {
-				if (busy_cell)
-					busy.erase(busy_cell);
+		std::vector<int> driver_cells;
+		for (auto &b : sig)
+			if (b.wire != NULL) {
+				int driver = bit_driver[bit(b)];
+				if (driver >= 0 && std::find(driver_cells.begin(), driver_cells.end(), driver) == driver_cells.end())
+					driver_cells.push_back(driver);
+			}
+
+		for (int driver : driver_cells) {
+			if (!eval(driver, undef)) {
+				if (busy_cell >= 0)
+					cell_busy[busy_cell] = 0;
 				return false;
 			}
 		}
 
-		if (busy_cell)
-			busy.erase(busy_cell);
+		if (busy_cell >= 0)
+			cell_busy[busy_cell] = 0;
 
-		values_map.apply(sig);
+		apply_values(sig);
 		if (sig.is_fully_const())
 			return true;
 
@@ -24,10 +24,9 @@
 
 YOSYS_NAMESPACE_BEGIN
 
-int get_cell_cost(RTLIL::Cell *cell, std::map<RTLIL::Module*, int> *mod_cost_cache = nullptr);
+inline int get_cell_cost(RTLIL::Cell *cell, std::map<RTLIL::Module*, int> *mod_cost_cache = nullptr);
 
-int get_cell_cost(RTLIL::IdString type, const std::map<RTLIL::IdString, RTLIL::Const> &parameters = std::map<RTLIL::IdString, RTLIL::Const>(),
-		RTLIL::Design *design = nullptr, std::map<RTLIL::Module*, int> *mod_cost_cache = nullptr)
+inline const std::map<RTLIL::IdString, int> &get_gate_costs()
 {
 	static std::map<RTLIL::IdString, int> gate_cost = {
 		{ "$_BUF_",   1 },
@@ -44,6 +43,13 @@ int get_cell_cost(RTLIL::IdString type, const std::map<RTLIL::IdString, RTLIL::C
 		{ "$_OAI4_",  8 },
 		{ "$_MUX_",   4 }
 	};
+	return gate_cost;
+}
+
+inline int get_cell_cost(RTLIL::IdString type, const std::map<RTLIL::IdString, RTLIL::Const> &parameters = std::map<RTLIL::IdString, RTLIL::Const>(),
+		RTLIL::Design *design = nullptr, std::map<RTLIL::Module*, int> *mod_cost_cache = nullptr)
+{
+	const std::map<RTLIL::IdString, int> &gate_cost = get_gate_costs();
 
 	if (gate_cost.count(type))
 		return gate_cost.at(type);
@@ -74,11 +80,144 @@ int get_cell_cost(RTLIL::IdString type, const std::map<RTLIL::IdString, RTLIL::C
 	return 1;
 }
 
-int get_cell_cost(RTLIL::Cell *cell, std::map<RTLIL::Module*, int> *mod_cost_cache)
+inline int get_cell_cost(RTLIL::Cell *cell, std::map<RTLIL::Module*, int> *mod_cost_cache)
 {
 	return get_cell_cost(cell->type, cell->parameters, cell->module->design, mod_cost_cache);
 }
 
+// Design-wide cache for the cost of user modules, shared by all passes and
+// deleted with the design. Use CostCache::get() to obtain it. The cached cost
+// of a module (and of every module instantiating it) is dropped when the monitor
+// interface reports a change of one of its cells: a cell being added, removed or
+// reconnected, or its type or parameters being changed with Cell::setType(),
+// Cell::setParam() or Cell::unsetParam(). Cached lookups are O(log n). Unknown
+// cell types are reported only once.
+
+struct CostCache : public RTLIL::Monitor
+{
+	RTLIL::Design *design;
+	std::map<RTLIL::Module*, int> module_cost;
+	std::map<RTLIL::Module*, std::set<RTLIL::Module*>> module_users;
+	std::set<RTLIL::IdString> unknown_types;
+
+	CostCache(RTLIL::Design *design) : design(design)
+	{
+		design->monitors.insert(this);
+	}
+
+	~CostCache()
+	{
+		design->monitors.erase(this);
+	}
+
+	static CostCache *find(RTLIL::Design *design)
+	{
+		for (auto mon : design->owned_monitors) {
+			CostCache *cache = dynamic_cast<CostCache*>(mon);
+			if (cache != nullptr)
+				return cache;
+		}
+		return nullptr;
+	}
+
+	static CostCache *get(RTLIL::Design *design)
+	{
+		CostCache *cache = find(design);
+		if (cache == nullptr) {
+			cache = new CostCache(design);
+			design->owned_monitors.insert(cache);
+		}
+		return cache;
+	}
+
+	void forget(RTLIL::Module *mod)
+	{
+		if (module_cost.erase(mod) == 0)
+			return;
+
+		std::set<RTLIL::Module*> users;
+		users.swap(module_users[mod]);
+		module_users.erase(mod);
+
+		for (auto user : users)
+			forget(user);
+	}
+
+	int get_cost(RTLIL::IdString type, const std::map<RTLIL::IdString, RTLIL::Const> &parameters, RTLIL::Module *user = nullptr)
+	{
+		const std::map<RTLIL::IdString, int> &gate_cost = get_gate_costs();
+
+		auto it = gate_cost.find(type);
+		if (it != gate_cost.end())
+			return it->second;
+
+		if (parameters.empty() && design->module(type)) {
+			RTLIL::Module *mod = design->module(type);
+			if (user != nullptr)
+				module_users[mod].insert(user);
+			return get_cost(mod);
+		}
+
+		if (unknown_types.count(type) == 0) {
+			log_warning("Can't determine cost of %s cell (%d parameters).\n", log_id(type), GetSize(parameters));
+			unknown_types.insert(type);
+		}
+		return 1;
+	}
+
+	int get_cost(RTLIL::Cell *cell)
+	{
+		return get_cost(cell->type, cell->parameters, cell->module);
+	}
+
+	int get_cost(RTLIL::Module *mod)
+	{
+		if (mod->attributes.count("\\cost"))
+			return mod->attributes.at("\\cost").as_int();
+
+		auto it = module_cost.find(mod);
+		if (it != module_cost.end())
+			return it->second;
+
+		int cost = 1;
+		for (auto c : mod->cells())
+			cost += get_cost(c);
+
+		module_cost[mod] = cost;
+		return cost;
+	}
+
+	virtual void notify_module_add(RTLIL::Module*) YS_OVERRIDE
+	{
+		// cells of this type were costed as unknown until now
+		module_cost.clear();
+		module_users.clear();
+	}
+
+	virtual void notify_module_del(RTLIL::Module *mod) YS_OVERRIDE
+	{
+		forget(mod);
+		module_users.erase(mod);
+		for (auto &it : module_users)
+			it.second.erase(mod);
+	}
+
+	virtual void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString&, const RTLIL::SigSpec&, RTLIL::SigSpec&) YS_OVERRIDE
+	{
+		forget(cell->module);
+	}
+
+	virtual void notify_blackout(RTLIL::Module *mod) YS_OVERRIDE
+	{
+		forget(mod);
+	}
+
+	virtual void notify_cell_change(RTLIL::Cell *cell) YS_OVERRIDE
+	{
+		forget(cell->module);
+	}
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
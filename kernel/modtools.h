@@ -111,10 +111,46 @@ struct ModIndex : public RTLIL::Monitor
 		port_add(cell, port, sig);
 	}
 
-	virtual void notify_connect(RTLIL::Module *mod, const RTLIL::SigSig&)
+	virtual void notify_connect(RTLIL::Module *mod, const RTLIL::SigSig &sigsig)
 	{
 		log_assert(module == mod);
-		auto_reload_module = true;
+
+		if (auto_reload_module)
+			return;
+
+		// merge the database entries of the joined bits instead of
+		// reloading the whole module on the next query
+
+		std::vector<RTLIL::SigBit> old_bits = sigmap(sigsig.first).to_sigbit_vector();
+		for (auto &bit : sigmap(sigsig.second))
+			old_bits.push_back(bit);
+
+		sigmap.add(sigsig.first, sigsig.second);
+
+		for (auto &old_bit : old_bits)
+		{
+			RTLIL::SigBit new_bit = sigmap(old_bit);
+			if (old_bit == new_bit)
+				continue;
+
+			auto it = database.find(old_bit);
+			if (it == database.end())
+				continue;
+
+			// the database has no entries for constant bits. rebuild it from
+			// the module instead of dropping the port info of this bit
+			if (new_bit.wire == NULL) {
+				auto_reload_module = true;
+				return;
+			}
+
+			SigBitInfo &info = database[new_bit];
+			info.is_input = info.is_input || it->second.is_input;
+			info.is_output = info.is_output || it->second.is_output;
+			info.ports.insert(it->second.ports.begin(), it->second.ports.end());
+
+			database.erase(it);
+		}
 	}
 
 	virtual void notify_connect(RTLIL::Module *mod, const std::vector<RTLIL::SigSig>&)
@@ -241,6 +241,8 @@ RTLIL::Design::Design()
 
 RTLIL::Design::~Design()
 {
+	for (auto mon : owned_monitors)
+		delete mon;
 	for (auto it = modules_.begin(); it != modules_.end(); it++)
 		delete it->second;
 }
@@ -1102,6 +1104,16 @@ void RTLIL::Module::add(RTLIL::Wire *wire)
 	wire->module = this;
 }
 
+static void notify_cell_change(RTLIL::Cell *cell)
+{
+	for (auto mon : cell->module->monitors)
+		mon->notify_cell_change(cell);
+
+	if (cell->module->design)
+		for (auto mon : cell->module->design->monitors)
+			mon->notify_cell_change(cell);
+}
+
 void RTLIL::Module::add(RTLIL::Cell *cell)
 {
 	log_assert(!cell->name.empty());
@@ -1109,6 +1121,7 @@ void RTLIL::Module::add(RTLIL::Cell *cell)
 	log_assert(refcount_cells_ == 0);
 	cells_[cell->name] = cell;
 	cell->module = this;
+	notify_cell_change(cell);
 }
 
 namespace {
@@ -1158,6 +1171,7 @@ void RTLIL::Module::remove(RTLIL::Cell *cell)
 {
 	while (!cell->connections_.empty())
 		cell->unsetPort(cell->connections_.begin()->first);
+	notify_cell_change(cell);
 
 	log_assert(cells_.count(cell->name) != 0);
 	log_assert(refcount_cells_ == 0);
@@ -1781,14 +1795,22 @@ bool RTLIL::Cell::hasParam(RTLIL::IdString paramname) const
 	return parameters.count(paramname) != 0;
 }
 
+void RTLIL::Cell::setType(RTLIL::IdString type)
+{
+	this->type = type;
+	notify_cell_change(this);
+}
+
 void RTLIL::Cell::unsetParam(RTLIL::IdString paramname)
 {
 	parameters.erase(paramname);
+	notify_cell_change(this);
 }
 
 void RTLIL::Cell::setParam(RTLIL::IdString paramname, RTLIL::Const value)
 {
 	parameters[paramname] = value;
+	notify_cell_change(this);
 }
 
 const RTLIL::Const &RTLIL::Cell::getParam(RTLIL::IdString paramname) const
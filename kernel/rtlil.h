@@ -483,11 +483,17 @@ struct RTLIL::Monitor
 	virtual void notify_connect(RTLIL::Module*, const RTLIL::SigSig&) { }
 	virtual void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) { }
 	virtual void notify_blackout(RTLIL::Module*) { }
+	// a cell was added, is about to be removed, or its type or parameters changed
+	virtual void notify_cell_change(RTLIL::Cell*) { }
 };
 
 struct RTLIL::Design
 {
 	std::set<RTLIL::Monitor*> monitors;
+
+	// monitors that are shared by passes (e.g. CostCache) and deleted with the design
+	std::set<RTLIL::Monitor*> owned_monitors;
+
 	std::map<std::string, std::string> scratchpad;
 
 	int refcount_modules_;
@@ -848,6 +854,10 @@ public:
 	const RTLIL::SigSpec &getPort(RTLIL::IdString portname) const;
 	const std::map<RTLIL::IdString, RTLIL::SigSpec> &connections() const;
 
+	// change the cell type in place (monitors are notified, unlike when
+	// assigning to type directly)
+	void setType(RTLIL::IdString type);
+
 	// access cell parameters
 	bool hasParam(RTLIL::IdString paramname) const;
 	void unsetParam(RTLIL::IdString paramname);
@@ -26,6 +26,7 @@
 #include "kernel/macc.h"
 
 #include "libs/ezsat/ezminisat.h"
+#include <unordered_map>
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -33,12 +34,35 @@ typedef ezMiniSAT ezDefaultSAT;
 
 struct SatGen
 {
+	// imported signal bits are identified by the import context (the prefix
+	// with timestep and undef marker) and the bit. The literals created for
+	// them are anonymous, so ezSAT does not know their names (e.g. the verbose
+	// printDIMACS() output does not label them).
+	struct ImportKey {
+		int context;
+		RTLIL::Wire *wire;
+		int offset;
+		bool operator==(const ImportKey &other) const {
+			return context == other.context && wire == other.wire && offset == other.offset;
+		}
+	};
+
+	struct ImportKeyHash {
+		size_t operator()(const ImportKey &key) const {
+			size_t hash = std::hash<RTLIL::Wire*>()(key.wire);
+			hash = hash * 33 + key.offset;
+			hash = hash * 33 + key.context;
+			return hash;
+		}
+	};
+
 	ezSAT *ez;
 	SigMap *sigmap;
 	std::string prefix;
 	SigPool initial_state;
 	std::map<std::string, RTLIL::SigSpec> asserts_a, asserts_en;
-	std::map<std::string, std::map<RTLIL::SigBit, int>> imported_signals;
+	std::map<std::string, int> import_contexts;
+	std::unordered_map<ImportKey, int, ImportKeyHash> imported_literals;
 	bool ignore_div_by_zero;
 	bool model_undef;
 
@@ -53,6 +77,15 @@ struct SatGen
 		this->prefix = prefix;
 	}
 
+	int importContext(const std::string &pf)
+	{
+		auto it = import_contexts.find(pf);
+		if (it != import_contexts.end())
+			return it->second;
+		int context = GetSize(import_contexts);
+		return import_contexts[pf] = context;
+	}
+
 	std::vector<int> importSigSpecWorker(RTLIL::SigSpec sig, std::string &pf, bool undef_mode, bool dup_undef)
 	{
 		log_assert(!undef_mode || model_undef);
@@ -61,6 +94,9 @@ struct SatGen
 		std::vector<int> vec;
 		vec.reserve(GetSize(sig));
 
+		ImportKey key;
+		key.context = importContext(pf);
+
 		for (auto &bit : sig)
 			if (bit.wire == NULL) {
 				if (model_undef && dup_undef && bit == RTLIL::State::Sx)
@@ -68,9 +104,12 @@ struct SatGen
 				else
 					vec.push_back(bit == (undef_mode ? RTLIL::State::Sx : RTLIL::State::S1) ? ez->CONST_TRUE : ez->CONST_FALSE);
 			} else {
-				std::string name = pf + (bit.wire->width == 1 ? stringf("%s", log_id(bit.wire)) : stringf("%s [%d]", log_id(bit.wire->name), bit.offset));
-				vec.push_back(ez->frozen_literal(name));
-				imported_signals[pf][bit] = vec.back();
+				key.wire = bit.wire;
+				key.offset = bit.offset;
+				auto it = imported_literals.find(key);
+				if (it == imported_literals.end())
+					it = imported_literals.insert(std::pair<ImportKey, int>(key, ez->frozen_literal())).first;
+				vec.push_back(it->second);
 			}
 		return vec;
 	}
@@ -107,7 +146,13 @@ struct SatGen
 	{
 		log_assert(timestep != 0);
 		std::string pf = prefix + (timestep == -1 ? "" : stringf("@%d:", timestep));
-		return imported_signals[pf].count(bit) != 0;
+		if (bit.wire == NULL || import_contexts.count(pf) == 0)
+			return false;
+		ImportKey key;
+		key.context = import_contexts.at(pf);
+		key.wire = bit.wire;
+		key.offset = bit.offset;
+		return imported_literals.count(key) != 0;
 	}
 
 	void getAsserts(RTLIL::SigSpec &sig_a, RTLIL::SigSpec &sig_en, int timestep = -1)
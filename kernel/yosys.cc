@@ -609,6 +609,8 @@ void run_frontend(std::string filename, std::string command, RTLIL::Design *desi
 			command = "verilog -sv";
 		else if (filename.size() > 3 && filename.substr(filename.size()-3) == ".il")
 			command = "ilang";
+		else if (filename.size() > 5 && filename.substr(filename.size()-5) == ".blif")
+			command = "blif";
 		else if (filename.size() > 3 && filename.substr(filename.size()-3) == ".ys")
 			command = "script";
 		else if (filename == "-")
@@ -25,20 +25,24 @@
 
 #include <limits.h>
 #include <stdint.h>
-#include <csignal>
 #include <cinttypes>
 
-#ifndef _WIN32
-#  include <unistd.h>
+#if EZMINISAT_THREADS
+#  include <chrono>
+#  include <thread>
+#  include <condition_variable>
 #endif
 
 #include "../minisat/Solver.h"
 #include "../minisat/SimpSolver.h"
 
-ezMiniSAT::ezMiniSAT() : minisatSolver(NULL)
+ezMiniSAT::ezMiniSAT()
 {
-	minisatSolver = NULL;
 	foundContradiction = false;
+	portfolioSize = 1;
+#if EZMINISAT_THREADS
+	interruptRequested = false;
+#endif
 
 	freeze(CONST_TRUE);
 	freeze(CONST_FALSE);
@@ -46,16 +50,12 @@ ezMiniSAT::ezMiniSAT() : minisatSolver(NULL)
 
 ezMiniSAT::~ezMiniSAT()
 {
-	if (minisatSolver != NULL)
-		delete minisatSolver;
+	deleteSolvers();
 }
 
 void ezMiniSAT::clear()
 {
-	if (minisatSolver != NULL) {
-		delete minisatSolver;
-		minisatSolver = NULL;
-	}
+	deleteSolvers();
 	foundContradiction = false;
 	minisatVars.clear();
 #if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
@@ -74,25 +74,93 @@ void ezMiniSAT::freeze(int id)
 bool ezMiniSAT::eliminated(int idx)
 {
 	idx = idx < 0 ? -idx : idx;
-	if (minisatSolver != NULL && idx > 0 && idx <= int(minisatVars.size()))
-		return minisatSolver->isEliminated(minisatVars.at(idx-1));
+	if (idx > 0 && idx <= int(minisatVars.size()))
+		for (auto solver : minisatSolvers)
+			if (solver->isEliminated(minisatVars.at(idx-1)))
+				return true;
 	return false;
 }
 #endif
 
-#ifndef _WIN32
-ezMiniSAT *ezMiniSAT::alarmHandlerThis = NULL;
-clock_t ezMiniSAT::alarmHandlerTimeout = 0;
+void ezMiniSAT::createSolvers()
+{
+#if EZMINISAT_THREADS
+	std::lock_guard<std::mutex> lock(solverMutex);
+#else
+	portfolioSize = 1;
+#endif
+
+	for (int i = 0; i < portfolioSize; i++)
+	{
+		Solver *solver = new Solver;
+		solver->verbosity = EZMINISAT_VERBOSITY;
+
+		// diversify all but the first solver: different random seeds and
+		// initial activities, and a different restart strategy, phase saving,
+		// variable decay or preprocessing (no variable elimination). without
+		// SimpSolver the latter is replaced by basic instead of deep conflict
+		// clause minimization.
+		if (i > 0) {
+			solver->random_seed = 91648253 + 1000003 * i;
+			solver->rnd_init_act = true;
+			solver->random_var_freq = 0.005;
+			switch (i % 4) {
+			case 0:
+				solver->phase_saving = 0;
+				break;
+			case 1:
+#if EZMINISAT_SIMPSOLVER
+				solver->use_elim = false;
+#else
+				solver->ccmin_mode = 1;
+#endif
+				break;
+			case 2:
+				solver->luby_restart = false;
+				solver->restart_inc = 1.5;
+				break;
+			case 3:
+				solver->var_decay = 0.90;
+				break;
+			}
+		}
+
+		minisatSolvers.push_back(solver);
+	}
+}
 
-void ezMiniSAT::alarmHandler(int)
+void ezMiniSAT::deleteSolvers()
 {
-	if (clock() > alarmHandlerTimeout) {
-		alarmHandlerThis->minisatSolver->interrupt();
-		alarmHandlerTimeout = 0;
-	} else
-		alarm(1);
+#if EZMINISAT_THREADS
+	std::lock_guard<std::mutex> lock(solverMutex);
+#endif
+	for (auto solver : minisatSolvers)
+		delete solver;
+	minisatSolvers.clear();
 }
+
+// must be called with solverMutex locked
+void ezMiniSAT::interruptSolvers(int except)
+{
+	for (int i = 0; i < int(minisatSolvers.size()); i++)
+		if (i != except)
+			minisatSolvers[i]->interrupt();
+}
+
+void ezMiniSAT::interrupt()
+{
+#if EZMINISAT_THREADS
+	std::lock_guard<std::mutex> lock(solverMutex);
+	interruptRequested = true;
+	interruptSolvers();
 #endif
+}
+
+void ezMiniSAT::setPortfolioSize(int newPortfolioSize)
+{
+	assert(minisatSolvers.empty());
+	portfolioSize = std::max(newPortfolioSize, 1);
+}
 
 bool ezMiniSAT::solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions)
 {
@@ -102,8 +170,7 @@ bool ezMiniSAT::solver(const std::vector<int> &modelExpressions, std::vector<boo
 
 	if (0) {
 contradiction:
-		delete minisatSolver;
-		minisatSolver = NULL;
+		deleteSolvers();
 		minisatVars.clear();
 		foundContradiction = true;
 		return false;
@@ -121,10 +188,8 @@ contradiction:
 	for (auto id : modelExpressions)
 		modelIdx.push_back(bind(id));
 
-	if (minisatSolver == NULL) {
-		minisatSolver = new Solver;
-		minisatSolver->verbosity = EZMINISAT_VERBOSITY;
-	}
+	if (minisatSolvers.empty())
+		createSolvers();
 
 #if EZMINISAT_INCREMENTAL
 	std::vector<std::vector<int>> cnf;
@@ -133,12 +198,16 @@ contradiction:
 	const std::vector<std::vector<int>> &cnf = this->cnf();
 #endif
 
-	while (int(minisatVars.size()) < numCnfVariables())
-		minisatVars.push_back(minisatSolver->newVar());
+	while (int(minisatVars.size()) < numCnfVariables()) {
+		minisatVars.push_back(minisatSolvers.front()->newVar());
+		for (int i = 1; i < int(minisatSolvers.size()); i++)
+			minisatSolvers[i]->newVar();
+	}
 
 #if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
 	for (auto idx : cnfFrozenVars)
-		minisatSolver->setFrozen(minisatVars.at(idx > 0 ? idx-1 : -idx-1), true);
+	for (auto solver : minisatSolvers)
+		solver->setFrozen(minisatVars.at(idx > 0 ? idx-1 : -idx-1), true);
 	cnfFrozenVars.clear();
 #endif
 
@@ -150,19 +219,23 @@ contradiction:
 			else
 				ps.push(Minisat::mkLit(minisatVars.at(-idx-1), true));
 #if EZMINISAT_SIMPSOLVER
-			if (minisatSolver->isEliminated(minisatVars.at(idx > 0 ? idx-1 : -idx-1))) {
-				fprintf(stderr, "Assert in %s:%d failed! Missing call to ezsat->freeze(): %s (lit=%d)\n",
-						__FILE__, __LINE__, cnfLiteralInfo(idx).c_str(), idx);
-				abort();
-			}
+			for (auto solver : minisatSolvers)
+				if (solver->isEliminated(minisatVars.at(idx > 0 ? idx-1 : -idx-1))) {
+					fprintf(stderr, "Assert in %s:%d failed! Missing call to ezsat->freeze(): %s (lit=%d)\n",
+							__FILE__, __LINE__, cnfLiteralInfo(idx).c_str(), idx);
+					abort();
+				}
 #endif
 		}
-		if (!minisatSolver->addClause(ps))
-			goto contradiction;
+		for (auto solver : minisatSolvers)
+			if (!solver->addClause(ps))
+				goto contradiction;
 	}
 
-	if (cnf.size() > 0 && !minisatSolver->simplify())
-		goto contradiction;
+	if (cnf.size() > 0)
+		for (auto solver : minisatSolvers)
+			if (!solver->simplify())
+				goto contradiction;
 
 	Minisat::vec<Minisat::Lit> assumps;
 
@@ -172,46 +245,104 @@ contradiction:
 		else
 			assumps.push(Minisat::mkLit(minisatVars.at(-idx-1), true));
 #if EZMINISAT_SIMPSOLVER
-		if (minisatSolver->isEliminated(minisatVars.at(idx > 0 ? idx-1 : -idx-1))) {
-			fprintf(stderr, "Assert in %s:%d failed! Missing call to ezsat->freeze(): %s\n", __FILE__, __LINE__, cnfLiteralInfo(idx).c_str());
-			abort();
-		}
+		for (auto solver : minisatSolvers)
+			if (solver->isEliminated(minisatVars.at(idx > 0 ? idx-1 : -idx-1))) {
+				fprintf(stderr, "Assert in %s:%d failed! Missing call to ezsat->freeze(): %s\n", __FILE__, __LINE__, cnfLiteralInfo(idx).c_str());
+				abort();
+			}
 #endif
 	}
 
-#ifndef _WIN32
-	struct sigaction sig_action;
-	struct sigaction old_sig_action;
-	int old_alarm_timeout = 0;
+	for (auto solver : minisatSolvers) {
+		solver->budgetOff();
+		if (solverConflictBudget > 0)
+			solver->setConfBudget(solverConflictBudget);
+		if (solverPropagationBudget > 0)
+			solver->setPropBudget(solverPropagationBudget);
+	}
+
+	using namespace Minisat;
+
+	Solver *winner = NULL;
+	lbool result = l_Undef;
+
+#if EZMINISAT_THREADS
+	// the timeout is implemented by a watchdog thread that interrupts
+	// the solvers when the deadline passes before the solvers return
+	std::thread watchdog;
+	std::mutex watchdogMutex;
+	std::condition_variable watchdogCond;
+	bool watchdogDone = false;
+
+	{
+		std::lock_guard<std::mutex> lock(solverMutex);
+		for (auto solver : minisatSolvers)
+			solver->clearInterrupt();
+		if (interruptRequested)
+			interruptSolvers();
+	}
 
 	if (solverTimeout > 0) {
-		sig_action.sa_handler = alarmHandler;
-		sigemptyset(&sig_action.sa_mask);
-		sig_action.sa_flags = SA_RESTART;
-		alarmHandlerThis = this;
-		alarmHandlerTimeout = clock() + solverTimeout*CLOCKS_PER_SEC;
-		old_alarm_timeout = alarm(0);
-		sigaction(SIGALRM, &sig_action, &old_sig_action);
-		alarm(1);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(solverTimeout);
+		watchdog = std::thread([&]() {
+			std::unique_lock<std::mutex> lock(watchdogMutex);
+			if (!watchdogCond.wait_until(lock, deadline, [&]() { return watchdogDone; })) {
+				std::lock_guard<std::mutex> solver_lock(solverMutex);
+				interruptSolvers();
+			}
+		});
 	}
-#endif
 
-	bool foundSolution = minisatSolver->solve(assumps);
+	if (minisatSolvers.size() > 1)
+	{
+		// the first solver with a definitive answer interrupts all others
+		std::vector<std::thread> threads;
+		std::vector<lbool> results(minisatSolvers.size(), l_Undef);
+		std::atomic<int> winnerIdx(-1);
+
+		for (int i = 0; i < int(minisatSolvers.size()); i++)
+			threads.push_back(std::thread([&, i]() {
+				results[i] = minisatSolvers[i]->solveLimited(assumps);
+				int expected = -1;
+				if (results[i] != l_Undef && winnerIdx.compare_exchange_strong(expected, i)) {
+					std::lock_guard<std::mutex> lock(solverMutex);
+					interruptSolvers(i);
+				}
+			}));
+
+		for (auto &thread : threads)
+			thread.join();
+
+		if (winnerIdx >= 0) {
+			winner = minisatSolvers[winnerIdx];
+			result = results[winnerIdx];
+		}
+	}
+	else
+#endif
+	{
+		winner = minisatSolvers.front();
+		result = winner->solveLimited(assumps);
+	}
 
-#ifndef _WIN32
-	if (solverTimeout > 0) {
-		if (alarmHandlerTimeout == 0)
-			solverTimoutStatus = true;
-		alarm(0);
-		sigaction(SIGALRM, &old_sig_action, NULL);
-		alarm(old_alarm_timeout);
+#if EZMINISAT_THREADS
+	if (watchdog.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(watchdogMutex);
+			watchdogDone = true;
+		}
+		watchdogCond.notify_one();
+		watchdog.join();
 	}
+	interruptRequested = false;
 #endif
 
-	if (!foundSolution) {
+	if (result == l_Undef)
+		solverTimoutStatus = true;
+
+	if (result != l_True) {
 #if !EZMINISAT_INCREMENTAL
-		delete minisatSolver;
-		minisatSolver = NULL;
+		deleteSolvers();
 		minisatVars.clear();
 #endif
 		return false;
@@ -228,16 +359,13 @@ contradiction:
 		if (idx < 0)
 			idx = -idx, refvalue = false;
 
-		using namespace Minisat;
-		lbool value = minisatSolver->modelValue(minisatVars.at(idx-1));
+		lbool value = winner->modelValue(minisatVars.at(idx-1));
 		modelValues[i] = (value == Minisat::lbool(refvalue));
 	}
 
 #if !EZMINISAT_INCREMENTAL
-	delete minisatSolver;
-	minisatSolver = NULL;
+	deleteSolvers();
 	minisatVars.clear();
 #endif
 	return true;
 }
-
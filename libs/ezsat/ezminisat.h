@@ -24,9 +24,20 @@
 #define EZMINISAT_VERBOSITY 0
 #define EZMINISAT_INCREMENTAL 1
 
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#  define EZMINISAT_THREADS 1
+#else
+#  define EZMINISAT_THREADS 0
+#endif
+
 #include "ezsat.h"
 #include <time.h>
 
+#if EZMINISAT_THREADS
+#  include <atomic>
+#  include <mutex>
+#endif
+
 // minisat is using limit macros and format macros in their headers that
 // can be the source of some troubles when used from c++11. thefore we
 // don't force ezSAT users to use minisat headers..
@@ -43,20 +54,28 @@ private:
 #else
 	typedef Minisat::Solver Solver;
 #endif
-	Solver *minisatSolver;
+	// one solver, or several differently configured solvers for the same
+	// CNF when portfolio solving is enabled (see setPortfolioSize())
+	std::vector<Solver*> minisatSolvers;
 	std::vector<int> minisatVars;
 	bool foundContradiction;
+	int portfolioSize;
 
 #if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
 	std::set<int> cnfFrozenVars;
 #endif
 
-#ifndef _WIN32
-	static ezMiniSAT *alarmHandlerThis;
-	static clock_t alarmHandlerTimeout;
-	static void alarmHandler(int);
+#if EZMINISAT_THREADS
+	// minisatSolvers is only modified with solverMutex locked, so
+	// that interrupt() can be called safely from other threads
+	std::mutex solverMutex;
+	std::atomic<bool> interruptRequested;
 #endif
 
+	void createSolvers();
+	void deleteSolvers();
+	void interruptSolvers(int except = -1);
+
 public:
 	ezMiniSAT();
 	virtual ~ezMiniSAT();
@@ -66,6 +85,17 @@ public:
 	virtual bool eliminated(int idx);
 #endif
 	virtual bool solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions);
+
+	// stop the running solver() call, or the next one if none is running. The
+	// interrupted call returns false with the timeout status set. This is the
+	// only method that may be called from another thread.
+	void interrupt();
+
+	// run N differently configured solvers on the same CNF in parallel threads
+	// and use the result of the first one that finishes. Must be called before
+	// the first call to solve(). The first solver uses the default configuration.
+	void setPortfolioSize(int newPortfolioSize);
+	int getPortfolioSize() const { return portfolioSize; }
 };
 
 #endif
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <cassert>
 #include <string>
+#include <sstream>
 
 #include <stdlib.h>
 
@@ -52,6 +53,8 @@ ezSAT::ezSAT()
 	cnfClausesCount = 0;
 
 	solverTimeout = 0;
+	solverConflictBudget = 0;
+	solverPropagationBudget = 0;
 	solverTimoutStatus = false;
 
 	literal("CONST_TRUE");
@@ -189,20 +192,63 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 		abort();
 	}
 
-	std::pair<OpId, std::vector<int>> myExpr(op, myArgs);
+	if (2 * (int(expressions.size()) + 1) > int(expressionsHashtable.size()))
+		expressionsRehash(std::max(1024, 2 * int(expressionsHashtable.size())));
+
+	unsigned int hash = expressionHash(op, myArgs);
+	int mask = int(expressionsHashtable.size()) - 1;
+	int slot = hash & mask;
 	int id = 0;
 
-	if (expressionsCache.count(myExpr) > 0) {
-		id = expressionsCache.at(myExpr);
-	} else {
-		id = -(int(expressions.size()) + 1);
-		expressionsCache[myExpr] = id;
-		expressions.push_back(myExpr);
+	while (expressionsHashtable[slot] != 0) {
+		const Expression &expr = expressions[expressionsHashtable[slot] - 1];
+		if (expr.hash == hash && expr.op == op && expr.numArgs == int(myArgs.size()) &&
+				std::equal(myArgs.begin(), myArgs.end(), expressionArgs.begin() + expr.argsBegin)) {
+			id = -expressionsHashtable[slot];
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	if (id == 0) {
+		Expression expr;
+		expr.op = op;
+		expr.hash = hash;
+		expr.argsBegin = expressionArgs.size();
+		expr.numArgs = myArgs.size();
+		expressionArgs.insert(expressionArgs.end(), myArgs.begin(), myArgs.end());
+		expressions.push_back(expr);
+		expressionsHashtable[slot] = expressions.size();
+		id = -int(expressions.size());
 	}
 
 	return xorRemovedOddTrues ? NOT(id) : id;
 }
 
+unsigned int ezSAT::expressionHash(OpId op, const std::vector<int> &args)
+{
+	// FNV-1a over the operator and the argument ids
+	unsigned int hash = 2166136261u;
+	hash = (hash ^ (unsigned int)op) * 16777619u;
+	for (auto arg : args)
+		hash = (hash ^ (unsigned int)arg) * 16777619u;
+	return hash ^ (hash >> 15);
+}
+
+void ezSAT::expressionsRehash(int newSize)
+{
+	expressionsHashtable.clear();
+	expressionsHashtable.resize(newSize);
+
+	int mask = newSize - 1;
+	for (int i = 0; i < int(expressions.size()); i++) {
+		int slot = expressions[i].hash & mask;
+		while (expressionsHashtable[slot] != 0)
+			slot = (slot + 1) & mask;
+		expressionsHashtable[slot] = i + 1;
+	}
+}
+
 void ezSAT::lookup_literal(int id, std::string &name) const
 {
 	assert(0 < id && id <= int(literals.size()));
@@ -218,15 +264,19 @@ const std::string &ezSAT::lookup_literal(int id) const
 void ezSAT::lookup_expression(int id, OpId &op, std::vector<int> &args) const
 {
 	assert(0 < -id && -id <= int(expressions.size()));
-	op = expressions[-id - 1].first;
-	args = expressions[-id - 1].second;
+	const Expression &expr = expressions[-id - 1];
+	op = expr.op;
+	args.assign(expressionArgs.begin() + expr.argsBegin, expressionArgs.begin() + expr.argsBegin + expr.numArgs);
 }
 
-const std::vector<int> &ezSAT::lookup_expression(int id, OpId &op) const
+// the returned pointer is invalidated when a new expression is created
+const int *ezSAT::lookup_expression(int id, OpId &op, int &numArgs) const
 {
 	assert(0 < -id && -id <= int(expressions.size()));
-	op = expressions[-id - 1].first;
-	return expressions[-id - 1].second;
+	const Expression &expr = expressions[-id - 1];
+	op = expr.op;
+	numArgs = expr.numArgs;
+	return expressionArgs.data() + expr.argsBegin;
 }
 
 int ezSAT::parse_string(const std::string &)
@@ -299,13 +349,14 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 	}
 
 	OpId op;
-	const std::vector<int> &args = lookup_expression(id, op);
+	int numArgs;
+	const int *args = lookup_expression(id, op, numArgs);
 	int a, b;
 
 	switch (op)
 	{
 	case OpNot:
-		assert(args.size() == 1);
+		assert(numArgs == 1);
 		a = eval(args[0], values);
 		if (a == CONST_TRUE)
 			return CONST_FALSE;
@@ -314,8 +365,8 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 		return 0;
 	case OpAnd:
 		a = CONST_TRUE;
-		for (auto arg : args) {
-			b = eval(arg, values);
+		for (int i = 0; i < numArgs; i++) {
+			b = eval(args[i], values);
 			if (b != CONST_TRUE && b != CONST_FALSE)
 				a = 0;
 			if (b == CONST_FALSE)
@@ -324,8 +375,8 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 		return a;
 	case OpOr:
 		a = CONST_FALSE;
-		for (auto arg : args) {
-			b = eval(arg, values);
+		for (int i = 0; i < numArgs; i++) {
+			b = eval(args[i], values);
 			if (b != CONST_TRUE && b != CONST_FALSE)
 				a = 0;
 			if (b == CONST_TRUE)
@@ -334,8 +385,8 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 		return a;
 	case OpXor:
 		a = CONST_FALSE;
-		for (auto arg : args) {
-			b = eval(arg, values);
+		for (int i = 0; i < numArgs; i++) {
+			b = eval(args[i], values);
 			if (b != CONST_TRUE && b != CONST_FALSE)
 				return 0;
 			if (b == CONST_TRUE)
@@ -343,10 +394,10 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 		}
 		return a;
 	case OpIFF:
-		assert(args.size() > 0);
+		assert(numArgs > 0);
 		a = eval(args[0], values);
-		for (auto arg : args) {
-			b = eval(arg, values);
+		for (int i = 0; i < numArgs; i++) {
+			b = eval(args[i], values);
 			if (b != CONST_TRUE && b != CONST_FALSE)
 				return 0;
 			if (b != a)
@@ -354,7 +405,7 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 		}
 		return CONST_TRUE;
 	case OpITE:
-		assert(args.size() == 3);
+		assert(numArgs == 3);
 		a = eval(args[0], values);
 		if (a == CONST_TRUE)
 			return eval(args[1], values);
@@ -1186,6 +1237,19 @@ ezSATvec ezSAT::vec(const std::vector<int> &vec)
 }
 
 void ezSAT::printDIMACS(FILE *f, bool verbose) const
+{
+	printDIMACSWorker(f, std::vector<int>(), verbose);
+}
+
+void ezSAT::printDIMACS(FILE *f, const std::vector<int> &assumptions, bool verbose)
+{
+	std::vector<int> unitClauses;
+	for (auto id : assumptions)
+		unitClauses.push_back(bind(id));
+	printDIMACSWorker(f, unitClauses, verbose);
+}
+
+void ezSAT::printDIMACSWorker(FILE *f, const std::vector<int> &unitClauses, bool verbose) const
 {
 	if (cnfConsumed) {
 		fprintf(stderr, "Usage error: printDIMACS() must not be called after cnfConsumed()!");
@@ -1223,7 +1287,10 @@ void ezSAT::printDIMACS(FILE *f, bool verbose) const
 	getFullCnf(all_clauses);
 	assert(cnfClausesCount == int(all_clauses.size()));
 
-	fprintf(f, "p cnf %d %d\n", cnfVariableCount, cnfClausesCount);
+	for (auto idx : unitClauses)
+		all_clauses.push_back(std::vector<int>(1, idx));
+
+	fprintf(f, "p cnf %d %d\n", cnfVariableCount, int(all_clauses.size()));
 	int maxClauseLen = 0;
 	for (auto &clause : all_clauses)
 		maxClauseLen = std::max(int(clause.size()), maxClauseLen);
@@ -1239,10 +1306,58 @@ void ezSAT::printDIMACS(FILE *f, bool verbose) const
 	}
 }
 
-static std::string expression2str(const std::pair<ezSAT::OpId, std::vector<int>> &data)
+bool ezSAT::readModel(std::istream &f, const std::vector<int> &modelExpressions, std::vector<bool> &modelValues)
+{
+	// values indexed by cnf variable: 0 = not in model, +1 = true, -1 = false
+	std::vector<int> values(cnfVariableCount+1, 0);
+	bool foundStatus = false, satisfiable = false;
+	std::string line;
+
+	while (std::getline(f, line))
+	{
+		if (line.size() < 2 || line[1] != ' ')
+			continue;
+
+		if (line[0] == 's') {
+			std::string status = line.substr(2);
+			while (!status.empty() && (status.back() == '\r' || status.back() == ' '))
+				status.pop_back();
+			if (status == "SATISFIABLE")
+				foundStatus = true, satisfiable = true;
+			else if (status == "UNSATISFIABLE")
+				foundStatus = true, satisfiable = false;
+			continue;
+		}
+
+		if (line[0] == 'v') {
+			std::istringstream ss(line.substr(2));
+			int lit;
+			while (ss >> lit && lit != 0)
+				if (abs(lit) <= cnfVariableCount)
+					values[abs(lit)] = lit > 0 ? +1 : -1;
+		}
+	}
+
+	solverTimoutStatus = !foundStatus;
+	modelValues.clear();
+
+	if (!satisfiable)
+		return false;
+
+	modelValues.resize(modelExpressions.size());
+	for (int i = 0; i < int(modelExpressions.size()); i++) {
+		int idx = bind(modelExpressions[i]);
+		int value = abs(idx) <= cnfVariableCount ? values[abs(idx)] : 0;
+		modelValues[i] = idx > 0 ? value > 0 : value < 0;
+	}
+
+	return true;
+}
+
+static std::string expression2str(ezSAT::OpId op, const std::vector<int> &args)
 {
 	std::string text;
-	switch (data.first) {
+	switch (op) {
 #define X(op) case ezSAT::op: text += #op; break;
 		X(OpNot)
 		X(OpAnd)
@@ -1255,7 +1370,7 @@ static std::string expression2str(const std::pair<ezSAT::OpId, std::vector<int>>
 #undef X
 	}
 	text += ":";
-	for (auto it : data.second)
+	for (auto it : args)
 		text += " " + my_int_to_string(it);
 	return text;
 }
@@ -1272,13 +1387,13 @@ void ezSAT::printInternalState(FILE *f) const
 	for (int i = 0; i < int(literals.size()); i++)
 		fprintf(f, "    %d: `%s'\n", i+1, literals[i].c_str());
 
-	fprintf(f, "expressionsCache:\n");
-	for (auto &it : expressionsCache)
-		fprintf(f, "    `%s' -> %d\n", expression2str(it.first).c_str(), it.second);
-
 	fprintf(f, "expressions:\n");
-	for (int i = 0; i < int(expressions.size()); i++)
-		fprintf(f, "    %d: `%s'\n", -i-1, expression2str(expressions[i]).c_str());
+	for (int i = 0; i < int(expressions.size()); i++) {
+		OpId op;
+		std::vector<int> args;
+		lookup_expression(-i-1, op, args);
+		fprintf(f, "    %d: `%s' (hash %08x)\n", -i-1, expression2str(op, args).c_str(), expressions[i].hash);
+	}
 
 	fprintf(f, "cnfVariables (count=%d):\n", cnfVariableCount);
 	for (int i = 0; i < int(cnfLiteralVariables.size()); i++)
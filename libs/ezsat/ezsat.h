@@ -24,6 +24,7 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <istream>
 #include <stdio.h>
 #include <stdint.h>
 
@@ -57,8 +58,22 @@ private:
 	std::map<std::string, int> literalsCache;
 	std::vector<std::string> literals;
 
-	std::map<std::pair<OpId, std::vector<int>>, int> expressionsCache;
-	std::vector<std::pair<OpId, std::vector<int>>> expressions;
+	// expressions are hash-consed: the arguments of all expressions are stored
+	// back-to-back in expressionArgs, and expressionsHashtable is an open
+	// addressing hash table with the indices (-id) of the expressions, or 0 for
+	// empty slots.
+	struct Expression {
+		OpId op;
+		unsigned int hash;
+		int argsBegin, numArgs;
+	};
+
+	std::vector<Expression> expressions;
+	std::vector<int> expressionArgs;
+	std::vector<int> expressionsHashtable;
+
+	static unsigned int expressionHash(OpId op, const std::vector<int> &args);
+	void expressionsRehash(int newSize);
 
 	bool cnfConsumed;
 	int cnfVariableCount, cnfClausesCount;
@@ -73,11 +88,14 @@ private:
 	int bind_cnf_and(const std::vector<int> &args);
 	int bind_cnf_or(const std::vector<int> &args);
 
+	void printDIMACSWorker(FILE *f, const std::vector<int> &unitClauses, bool verbose) const;
+
 protected:
 	void preSolverCallback();
 
 public:
 	int solverTimeout;
+	int64_t solverConflictBudget, solverPropagationBudget;
 	bool solverTimoutStatus;
 
 	ezSAT();
@@ -103,7 +121,7 @@ public:
 	const std::string &lookup_literal(int id) const;
 
 	void lookup_expression(int id, OpId &op, std::vector<int> &args) const;
-	const std::vector<int> &lookup_expression(int id, OpId &op) const;
+	const int *lookup_expression(int id, OpId &op, int &numArgs) const;
 
 	int parse_string(const std::string &text);
 	std::string to_string(int id) const;
@@ -150,6 +168,13 @@ public:
 		solverTimeout = newTimeoutSeconds;
 	}
 
+	// limit the number of conflicts and propagations of each solver call,
+	// 0 means unlimited. Running out of budget counts as a timeout.
+	void setSolverBudget(int64_t newConflictBudget, int64_t newPropagationBudget = 0) {
+		solverConflictBudget = newConflictBudget;
+		solverPropagationBudget = newPropagationBudget;
+	}
+
 	bool getSolverTimoutStatus() {
 		return solverTimoutStatus;
 	}
@@ -294,6 +319,13 @@ public:
 	void printDIMACS(FILE *f, bool verbose = false) const;
 	void printInternalState(FILE *f) const;
 
+	// round-trip through an external DIMACS solver: the assumptions are added as unit
+	// clauses, the model expressions must be bound before the CNF is printed, and
+	// readModel() parses the "s" and "v" lines of the solver output
+
+	void printDIMACS(FILE *f, const std::vector<int> &assumptions, bool verbose = false);
+	bool readModel(std::istream &f, const std::vector<int> &modelExpressions, std::vector<bool> &modelValues);
+
 	// more sophisticated constraints (designed to be used directly with assume(..))
 
 	int onehot(const std::vector<int> &vec, bool max_only = false);
@@ -19,6 +19,14 @@
 
 #include "ezminisat.h"
 #include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#if EZMINISAT_THREADS
+#  include <thread>
+#  include <chrono>
+#endif
 
 struct xorshift128 {
 	uint32_t x, y, z, w;
@@ -426,15 +434,164 @@ void test_ordered()
 
 // ------------------------------------------------------------------------------------------------------------
 
+// pigeonhole problem: put n+1 pigeons in n holes (unsat and hard for CDCL solvers)
+void pigeonhole(ezSAT &sat, int n)
+{
+	std::vector<std::vector<int>> p(n+1);
+	for (int i = 0; i <= n; i++) {
+		p[i] = sat.vec_var(n);
+		sat.assume(sat.expression(ezSAT::OpOr, p[i]));
+	}
+	for (int j = 0; j < n; j++)
+	for (int i = 0; i <= n; i++)
+	for (int k = i+1; k <= n; k++)
+		sat.assume(sat.NOT(sat.AND(p[i][j], p[k][j])));
+}
+
+void test_budget()
+{
+	printf("==== %s ====\n\n", __PRETTY_FUNCTION__);
+
+	ezMiniSAT sat1, sat2;
+	std::vector<int> modelExpressions;
+	std::vector<bool> modelValues;
+
+	pigeonhole(sat1, 12);
+	sat1.setSolverBudget(1000);
+	if (sat1.solve(modelExpressions, modelValues) || !sat1.getSolverTimoutStatus()) {
+		fprintf(stderr, "Solver did not stop after running out of budget!\n");
+		abort();
+	}
+	printf("conflict budget: ok\n");
+
+#if EZMINISAT_THREADS
+	pigeonhole(sat2, 12);
+	std::thread interrupter([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		sat2.interrupt();
+	});
+	bool result = sat2.solve(modelExpressions, modelValues);
+	interrupter.join();
+	if (result || !sat2.getSolverTimoutStatus()) {
+		fprintf(stderr, "Solver did not stop after interrupt!\n");
+		abort();
+	}
+	printf("interrupt from other thread: ok\n");
+
+	sat2.setSolverTimeout(1);
+	if (sat2.solve(modelExpressions, modelValues) || !sat2.getSolverTimoutStatus()) {
+		fprintf(stderr, "Solver did not stop after timeout!\n");
+		abort();
+	}
+	printf("timeout: ok\n");
+#endif
+
+	printf("\n");
+}
 
-int main()
+void test_portfolio()
 {
+	printf("==== %s ====\n\n", __PRETTY_FUNCTION__);
+
+	ezMiniSAT sat1;
+	sat1.setPortfolioSize(4);
+
+	std::vector<int> bits = sat1.vec_var("i", 32);
+	bits = sat1.vec_xor(bits, sat1.vec_shl(bits, 13));
+	bits = sat1.vec_xor(bits, sat1.vec_shr(bits, 17));
+	bits = sat1.vec_xor(bits, sat1.vec_shl(bits,  5));
+	sat1.vec_set(bits, sat1.vec_var("o", 32));
+
+	xorshift128 rng;
+	for (int i = 0; i < 4; i++)
+		test_xorshift32_try(sat1, rng());
+
+	ezMiniSAT sat2;
+	std::vector<int> modelExpressions;
+	std::vector<bool> modelValues;
+
+	sat2.setPortfolioSize(4);
+	pigeonhole(sat2, 7);
+	if (sat2.solve(modelExpressions, modelValues) || sat2.getSolverTimoutStatus()) {
+		fprintf(stderr, "Portfolio solver failed on unsatisfiable problem!\n");
+		abort();
+	}
+	printf("unsatisfiable problem: ok\n\n");
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+void benchmark_build(ezSAT &sat, std::vector<int> &a, std::vector<int> &b, int chain, int rounds)
+{
+	xorshift128 rng;
+
+	a = sat.vec_var("a" + std::to_string(chain), 32);
+	b = sat.vec_var("b" + std::to_string(chain), 32);
+
+	for (int i = 0; i < rounds; i++) {
+		std::vector<int> sum = sat.vec_add(a, sat.vec_srl(b, rng() % 31 + 1));
+		a = sat.vec_xor(sum, sat.vec_ite(b[rng() % 32], a, b));
+		b = sat.vec_ite(sat.vec_and(a, sum), b, sat.vec_shl(sum, rng() % 31 + 1));
+	}
+}
+
+void benchmark()
+{
+	printf("==== %s ====\n\n", __PRETTY_FUNCTION__);
+
+	// 20 independent chains of 100 rounds each: deeper expressions would
+	// overflow the stack in the recursive CNF generator
+	ezSAT sat;
+	std::vector<int> a[20], b[20];
+	int chains = 20, rounds = 100;
+
+	clock_t t0 = clock();
+	for (int i = 0; i < chains; i++)
+		benchmark_build(sat, a[i], b[i], i, rounds);
+
+	clock_t t1 = clock();
+	int numExpressions = sat.numExpressions();
+	for (int i = 0; i < chains; i++)
+		benchmark_build(sat, a[i], b[i], i, rounds);
+	assert(sat.numExpressions() == numExpressions);
+
+	clock_t t2 = clock();
+	for (int i = 0; i < chains; i++)
+		sat.assume(sat.vec_ne(a[i], b[i]));
+
+	clock_t t3 = clock();
+
+	double build_sec = double(t1 - t0) / CLOCKS_PER_SEC;
+	double lookup_sec = double(t2 - t1) / CLOCKS_PER_SEC;
+	double cnf_sec = double(t3 - t2) / CLOCKS_PER_SEC;
+
+	printf("created %d expressions in %.2f sec (%.0f expressions/sec).\n",
+			numExpressions, build_sec, numExpressions / std::max(build_sec, 1e-6));
+	printf("rebuilt the same expressions from cache in %.2f sec (%.0f expressions/sec).\n",
+			lookup_sec, numExpressions / std::max(lookup_sec, 1e-6));
+	printf("generated %d clauses over %d variables in %.2f sec (%.0f clauses/sec).\n",
+			sat.numCnfClauses(), sat.numCnfVariables(), cnf_sec, sat.numCnfClauses() / std::max(cnf_sec, 1e-6));
+	printf("\n");
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+
+int main(int argc, char **argv)
+{
+	if (argc == 2 && !strcmp(argv[1], "bench")) {
+		benchmark();
+		return 0;
+	}
+
 	test_simple();
 	test_xorshift32();
 	test_arith();
 	test_onehot();
 	test_manyhot();
 	test_ordered();
+	test_budget();
+	test_portfolio();
 	printf("Passed all tests.\n\n");
 	return 0;
 }
@@ -49,13 +49,14 @@
 #include <cerrno>
 #include <sstream>
 #include <climits>
+#include <chrono>
 
 #ifndef _WIN32
 #  include <unistd.h>
 #  include <dirent.h>
 #endif
 
-#include "blifparse.h"
+#include "frontends/blif/blifparse.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -288,123 +289,230 @@ std::string remap_name(RTLIL::IdString abc_name)
 	return sstr.str();
 }
 
-void dump_loop_graph(FILE *f, int &nr, std::map<int, std::set<int>> &edges, std::set<int> &workpool, std::vector<int> &in_counts)
+int gate_fanin(const gate_t &g, int *fanin)
 {
-	if (f == NULL)
-		return;
+	int count = 0;
+	if (g.type == G(NONE) || g.type == G(FF))
+		return 0;
+	if (g.in1 >= 0)
+		fanin[count++] = g.in1;
+	if (g.in2 >= 0 && g.in2 != g.in1)
+		fanin[count++] = g.in2;
+	if (g.in3 >= 0 && g.in3 != g.in2 && g.in3 != g.in1)
+		fanin[count++] = g.in3;
+	if (g.in4 >= 0 && g.in4 != g.in3 && g.in4 != g.in2 && g.in4 != g.in1)
+		fanin[count++] = g.in4;
+	return count;
+}
 
-	log("Dumping loop state graph to slide %d.\n", ++nr);
+// Combinational loops are found and broken in linear time: the strongly
+// connected components of the gate graph are computed first (Tarjan, R. E.
+// (1972), "Depth-first search and linear graph algorithms"). Then a depth-first
+// search runs over each SCC that contains a loop, and each back edge it finds is
+// cut by driving the gate input from a new signal instead. Without its back
+// edges the graph is acyclic.
+struct abc_loop_breaker
+{
+	// fanin of each signal as compact adjacency array: the drivers of
+	// node n are edge_list[edge_begin[n]] .. edge_list[edge_begin[n+1]-1]
+	std::vector<int> edge_begin, edge_list;
 
-	fprintf(f, "digraph \"slide%d\" {\n", nr);
-	fprintf(f, "  label=\"slide%d\";\n", nr);
-	fprintf(f, "  rankdir=\"TD\";\n");
+	std::vector<int> node_comp, node_index, node_lowlink;
+	std::vector<bool> node_on_stack;
+
+	FILE *dot_f;
+	int dot_nr;
+
+	abc_loop_breaker() : dot_f(NULL), dot_nr(0)
+	{
+		int num_nodes = GetSize(signal_list), fanin[4];
 
-	std::set<int> nodes;
-	for (auto &e : edges) {
-		nodes.insert(e.first);
-		for (auto n : e.second)
-			nodes.insert(n);
+		edge_begin.reserve(num_nodes+1);
+		for (auto &g : signal_list) {
+			edge_begin.push_back(GetSize(edge_list));
+			edge_list.insert(edge_list.end(), fanin, fanin + gate_fanin(g, fanin));
+		}
+		edge_begin.push_back(GetSize(edge_list));
+
+		node_comp.resize(num_nodes, -1);
+		node_index.resize(num_nodes, -1);
+		node_lowlink.resize(num_nodes);
+		node_on_stack.resize(num_nodes);
 	}
 
-	for (auto n : nodes)
-		fprintf(f, "  n%d [label=\"%s\\nid=%d, count=%d\"%s];\n", n, log_signal(signal_list[n].bit),
-				n, in_counts[n], workpool.count(n) ? ", shape=box" : "");
+	// appends all SCCs that contain a loop to 'sccs'
+	void find_sccs(std::vector<std::vector<int>> &sccs)
+	{
+		std::vector<std::pair<int, int>> dfs_stack;
+		std::vector<int> scc_stack;
+		int next_index = 0;
 
-	for (auto &e : edges)
-	for (auto n : e.second)
-		fprintf(f, "  n%d -> n%d;\n", e.first, n);
+		for (int root = 0; root < GetSize(node_index); root++)
+		{
+			if (node_index[root] >= 0)
+				continue;
 
-	fprintf(f, "}\n");
-}
+			dfs_stack.push_back(std::pair<int, int>(root, edge_begin[root]));
+			node_index[root] = node_lowlink[root] = next_index++;
+			scc_stack.push_back(root);
+			node_on_stack[root] = true;
 
-void handle_loops()
-{
-	// http://en.wikipedia.org/wiki/Topological_sorting
-	// (Kahn, Arthur B. (1962), "Topological sorting of large networks")
-
-	std::map<int, std::set<int>> edges;
-	std::vector<int> in_edges_count(signal_list.size());
-	std::set<int> workpool;
-
-	FILE *dot_f = NULL;
-	int dot_nr = 0;
-
-	// uncomment for troubleshooting the loop detection code
-	// dot_f = fopen("test.dot", "w");
-
-	for (auto &g : signal_list) {
-		if (g.type == G(NONE) || g.type == G(FF)) {
-			workpool.insert(g.id);
-		} else {
-			if (g.in1 >= 0) {
-				edges[g.in1].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-			if (g.in2 >= 0 && g.in2 != g.in1) {
-				edges[g.in2].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-			if (g.in3 >= 0 && g.in3 != g.in2 && g.in3 != g.in1) {
-				edges[g.in3].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-			if (g.in4 >= 0 && g.in4 != g.in3 && g.in4 != g.in2 && g.in4 != g.in1) {
-				edges[g.in4].insert(g.id);
-				in_edges_count[g.id]++;
+			while (!dfs_stack.empty())
+			{
+				int n = dfs_stack.back().first;
+				int &edge_idx = dfs_stack.back().second;
+
+				if (edge_idx < edge_begin[n+1])
+				{
+					int n2 = edge_list[edge_idx++];
+					if (node_index[n2] < 0) {
+						dfs_stack.push_back(std::pair<int, int>(n2, edge_begin[n2]));
+						node_index[n2] = node_lowlink[n2] = next_index++;
+						scc_stack.push_back(n2);
+						node_on_stack[n2] = true;
+					} else if (node_on_stack[n2])
+						node_lowlink[n] = std::min(node_lowlink[n], node_index[n2]);
+					continue;
+				}
+
+				dfs_stack.pop_back();
+				if (!dfs_stack.empty()) {
+					int parent = dfs_stack.back().first;
+					node_lowlink[parent] = std::min(node_lowlink[parent], node_lowlink[n]);
+				}
+
+				if (node_lowlink[n] != node_index[n])
+					continue;
+
+				bool has_loop = scc_stack.back() != n;
+				for (int i = edge_begin[n]; !has_loop && i < edge_begin[n+1]; i++)
+					if (edge_list[i] == n)
+						has_loop = true;
+
+				if (has_loop)
+					sccs.push_back(std::vector<int>());
+
+				while (1) {
+					int n2 = scc_stack.back();
+					scc_stack.pop_back();
+					node_on_stack[n2] = false;
+					if (has_loop) {
+						node_comp[n2] = GetSize(sccs)-1;
+						sccs.back().push_back(n2);
+					}
+					if (n2 == n)
+						break;
+				}
+
+				if (has_loop)
+					std::reverse(sccs.back().begin(), sccs.back().end());
 			}
 		}
 	}
 
-	dump_loop_graph(dot_f, dot_nr, edges, workpool, in_edges_count);
-
-	while (workpool.size() > 0)
+	void dump_loop_graph(const std::vector<int> &scc, int comp_id)
 	{
-		int id = *workpool.begin();
-		workpool.erase(id);
+		if (dot_f == NULL)
+			return;
+
+		log("Dumping loop state graph to slide %d.\n", ++dot_nr);
 
-		// log("Removing non-loop node %d from graph: %s\n", id, log_signal(signal_list[id].bit));
+		fprintf(dot_f, "digraph \"slide%d\" {\n", dot_nr);
+		fprintf(dot_f, "  label=\"slide%d\";\n", dot_nr);
+		fprintf(dot_f, "  rankdir=\"TD\";\n");
 
-		for (int id2 : edges[id]) {
-			log_assert(in_edges_count[id2] > 0);
-			if (--in_edges_count[id2] == 0)
-				workpool.insert(id2);
+		for (int n : scc)
+			fprintf(dot_f, "  n%d [label=\"%s\\nid=%d\"];\n", n, log_signal(signal_list[n].bit), n);
+
+		for (int n : scc)
+		for (int i = edge_begin[n]; i < edge_begin[n+1]; i++)
+			if (node_comp[edge_list[i]] == comp_id)
+				fprintf(dot_f, "  n%d -> n%d;\n", edge_list[i], n);
+
+		fprintf(dot_f, "}\n");
+	}
+
+	// signals with public names and large fanout are the preferred loop breakers:
+	// start the search there, so that it finds the back edges leaving that signal
+	int pick_root(const std::vector<int> &scc, int comp_id)
+	{
+		std::map<int, int> fanout;
+		for (int n : scc)
+		for (int i = edge_begin[n]; i < edge_begin[n+1]; i++)
+			if (node_comp[edge_list[i]] == comp_id)
+				fanout[edge_list[i]]++;
+
+		int id1 = scc.front();
+		for (int id2 : scc) {
+			RTLIL::Wire *w1 = signal_list[id1].bit.wire;
+			RTLIL::Wire *w2 = signal_list[id2].bit.wire;
+			if (w1 == NULL)
+				id1 = id2;
+			else if (w2 == NULL)
+				continue;
+			else if (w1->name[0] == '$' && w2->name[0] == '\\')
+				id1 = id2;
+			else if (w1->name[0] == '\\' && w2->name[0] == '$')
+				continue;
+			else if (fanout[id1] < fanout[id2])
+				id1 = id2;
+			else if (fanout[id1] > fanout[id2])
+				continue;
+			else if (w2->name.str() < w1->name.str())
+				id1 = id2;
 		}
-		edges.erase(id);
+		return id1;
+	}
+
+	void break_loops(const std::vector<int> &scc, int comp_id)
+	{
+		dump_loop_graph(scc, comp_id);
+
+		// driver signal -> gates that read it through a back edge
+		std::map<int, std::vector<int>> cut_edges;
+		std::vector<int> cut_order;
 
-		dump_loop_graph(dot_f, dot_nr, edges, workpool, in_edges_count);
+		std::vector<std::pair<int, int>> dfs_stack;
+		int root = pick_root(scc, comp_id);
 
-		while (workpool.size() == 0)
+		for (int i = -1; i < GetSize(scc); i++)
 		{
-			if (edges.size() == 0)
-				break;
-
-			int id1 = edges.begin()->first;
-
-			for (auto &edge_it : edges) {
-				int id2 = edge_it.first;
-				RTLIL::Wire *w1 = signal_list[id1].bit.wire;
-				RTLIL::Wire *w2 = signal_list[id2].bit.wire;
-				if (w1 == NULL)
-					id1 = id2;
-				else if (w2 == NULL)
-					continue;
-				else if (w1->name[0] == '$' && w2->name[0] == '\\')
-					id1 = id2;
-				else if (w1->name[0] == '\\' && w2->name[0] == '$')
+			int n = i < 0 ? root : scc[i];
+			if (node_index[n] < 0)
+				continue;
+
+			// node_index is reused here: -1 = visited, -2 = on the search stack
+			dfs_stack.push_back(std::pair<int, int>(n, edge_begin[n]));
+			node_index[n] = -2;
+
+			while (!dfs_stack.empty())
+			{
+				int n1 = dfs_stack.back().first;
+				int &edge_idx = dfs_stack.back().second;
+
+				if (edge_idx == edge_begin[n1+1]) {
+					node_index[n1] = -1;
+					dfs_stack.pop_back();
 					continue;
-				else if (edges[id1].size() < edges[id2].size())
-					id1 = id2;
-				else if (edges[id1].size() > edges[id2].size())
+				}
+
+				int n2 = edge_list[edge_idx++];
+				if (node_comp[n2] != comp_id)
 					continue;
-				else if (w2->name.str() < w1->name.str())
-					id1 = id2;
-			}
 
-			if (edges[id1].size() == 0) {
-				edges.erase(id1);
-				continue;
+				if (node_index[n2] == -2) {
+					if (cut_edges.count(n2) == 0)
+						cut_order.push_back(n2);
+					cut_edges[n2].push_back(n1);
+				} else if (node_index[n2] >= 0) {
+					dfs_stack.push_back(std::pair<int, int>(n2, edge_begin[n2]));
+					node_index[n2] = -2;
+				}
 			}
+		}
 
+		for (int id1 : cut_order)
+		{
 			log_assert(signal_list[id1].bit.wire != NULL);
 
 			std::stringstream sstr;
@@ -412,7 +520,7 @@ void handle_loops()
 			RTLIL::Wire *wire = module->addWire(sstr.str());
 
 			bool first_line = true;
-			for (int id2 : edges[id1]) {
+			for (int id2 : cut_edges.at(id1)) {
 				if (first_line)
 					log("Breaking loop using new signal %s: %s -> %s\n", log_signal(RTLIL::SigSpec(wire)),
 							log_signal(signal_list[id1].bit), log_signal(signal_list[id2].bit));
@@ -425,11 +533,8 @@ void handle_loops()
 			int id3 = map_signal(RTLIL::SigSpec(wire));
 			signal_list[id1].is_port = true;
 			signal_list[id3].is_port = true;
-			log_assert(id3 == int(in_edges_count.size()));
-			in_edges_count.push_back(0);
-			workpool.insert(id3);
 
-			for (int id2 : edges[id1]) {
+			for (int id2 : cut_edges.at(id1)) {
 				if (signal_list[id2].in1 == id1)
 					signal_list[id2].in1 = id3;
 				if (signal_list[id2].in2 == id1)
@@ -439,15 +544,118 @@ void handle_loops()
 				if (signal_list[id2].in4 == id1)
 					signal_list[id2].in4 = id3;
 			}
-			edges[id1].swap(edges[id3]);
 
 			module->connect(RTLIL::SigSig(signal_list[id3].bit, signal_list[id1].bit));
-			dump_loop_graph(dot_f, dot_nr, edges, workpool, in_edges_count);
 		}
 	}
 
-	if (dot_f != NULL)
-		fclose(dot_f);
+	void run()
+	{
+		// uncomment for troubleshooting the loop detection code
+		// dot_f = fopen("test.dot", "w");
+
+		std::vector<std::vector<int>> sccs;
+		find_sccs(sccs);
+
+		for (int comp_id = 0; comp_id < GetSize(sccs); comp_id++)
+			break_loops(sccs[comp_id], comp_id);
+
+		if (dot_f != NULL)
+			fclose(dot_f);
+	}
+};
+
+void handle_loops()
+{
+	abc_loop_breaker loop_breaker;
+	loop_breaker.run();
+}
+
+struct abc_partition_t
+{
+	std::string suffix;
+	std::vector<int> gates, inputs, outputs;
+};
+
+void partition_netlist(std::vector<abc_partition_t> &partitions, int partition_size)
+{
+	// Cone clustering: walk the fan-in cone of each output depth first and put
+	// the gates in partitions in the order they are reached. A new partition is
+	// started when the current one has partition_size gates, also in the middle
+	// of a cone. The walk does not continue through FF cells. The FF input is
+	// queued as a new root instead, so it is visited after the current cone.
+
+	std::vector<int> partition_of(signal_list.size(), -1);
+	std::vector<int> roots, stack;
+
+	for (auto &si : signal_list)
+		if (si.is_port && si.type != G(NONE))
+			roots.push_back(si.id);
+
+	int current_size = partition_size;
+
+	for (size_t root_idx = 0; root_idx < roots.size(); root_idx++)
+	{
+		stack.push_back(roots[root_idx]);
+
+		while (!stack.empty())
+		{
+			int id = stack.back();
+			stack.pop_back();
+
+			gate_t &g = signal_list[id];
+			if (g.type == G(NONE) || partition_of[id] >= 0)
+				continue;
+
+			if (current_size >= partition_size) {
+				partitions.push_back(abc_partition_t());
+				partitions.back().suffix = stringf("_%d", GetSize(partitions));
+				current_size = 0;
+			}
+
+			partition_of[id] = GetSize(partitions)-1;
+			partitions.back().gates.push_back(id);
+			current_size++;
+
+			if (g.type == G(FF)) {
+				roots.push_back(g.in1);
+				continue;
+			}
+
+			for (int in : {g.in1, g.in2, g.in3, g.in4})
+				if (in >= 0 && partition_of[in] < 0)
+					stack.push_back(in);
+		}
+	}
+
+	// signals that cross a partition boundary are routed through the original
+	// yosys wires, so they become ports of the abc netlists
+
+	for (auto &part : partitions)
+	{
+		int part_idx = partition_of[part.gates.front()];
+		std::set<int> inputs;
+
+		for (int id : part.gates) {
+			gate_t &g = signal_list[id];
+			for (int in : {g.in1, g.in2, g.in3, g.in4}) {
+				if (in < 0 || partition_of[in] == part_idx || signal_list[in].bit.wire == NULL)
+					continue;
+				if (partition_of[in] >= 0)
+					signal_list[in].is_port = true;
+				else if (!signal_list[in].is_port)
+					continue;
+				inputs.insert(in);
+			}
+		}
+
+		part.inputs.insert(part.inputs.end(), inputs.begin(), inputs.end());
+	}
+
+	for (auto &part : partitions)
+		for (int id : part.gates)
+			if (signal_list[id].is_port)
+				part.outputs.push_back(id);
 }
 
 std::string add_echos_to_abc_cmd(std::string str)
@@ -542,10 +750,266 @@ struct abc_output_filter
 	}
 };
 
+void write_input_blif(std::string filename, const abc_partition_t &part, int &count_gates)
+{
+	FILE *f = fopen(filename.c_str(), "wt");
+	if (f == NULL)
+		log_error("Opening %s for writing failed: %s\n", filename.c_str(), strerror(errno));
+
+	fprintf(f, ".model netlist\n");
+
+	fprintf(f, ".inputs");
+	for (int id : part.inputs)
+		fprintf(f, " n%d", id);
+	if (part.inputs.size() == 0)
+		fprintf(f, " dummy_input\n");
+	fprintf(f, "\n");
+
+	fprintf(f, ".outputs");
+	for (int id : part.outputs)
+		fprintf(f, " n%d", id);
+	fprintf(f, "\n");
+
+	for (int id : part.inputs)
+		fprintf(f, "# n%-5d %s\n", id, log_signal(signal_list[id].bit));
+	for (int id : part.gates)
+		fprintf(f, "# n%-5d %s\n", id, log_signal(signal_list[id].bit));
+
+	for (auto &si : signal_list) {
+		if (si.bit.wire == NULL) {
+			fprintf(f, ".names n%d\n", si.id);
+			if (si.bit == RTLIL::State::S1)
+				fprintf(f, "1\n");
+		}
+	}
+
+	for (int id : part.gates) {
+		gate_t &si = signal_list[id];
+		if (si.type == G(BUF)) {
+			fprintf(f, ".names n%d n%d\n", si.in1, si.id);
+			fprintf(f, "1 1\n");
+		} else if (si.type == G(NOT)) {
+			fprintf(f, ".names n%d n%d\n", si.in1, si.id);
+			fprintf(f, "0 1\n");
+		} else if (si.type == G(AND)) {
+			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
+			fprintf(f, "11 1\n");
+		} else if (si.type == G(NAND)) {
+			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
+			fprintf(f, "0- 1\n");
+			fprintf(f, "-0 1\n");
+		} else if (si.type == G(OR)) {
+			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
+			fprintf(f, "-1 1\n");
+			fprintf(f, "1- 1\n");
+		} else if (si.type == G(NOR)) {
+			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
+			fprintf(f, "00 1\n");
+		} else if (si.type == G(XOR)) {
+			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
+			fprintf(f, "01 1\n");
+			fprintf(f, "10 1\n");
+		} else if (si.type == G(XNOR)) {
+			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
+			fprintf(f, "00 1\n");
+			fprintf(f, "11 1\n");
+		} else if (si.type == G(MUX)) {
+			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
+			fprintf(f, "1-0 1\n");
+			fprintf(f, "-11 1\n");
+		} else if (si.type == G(AOI3)) {
+			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
+			fprintf(f, "-00 1\n");
+			fprintf(f, "0-0 1\n");
+		} else if (si.type == G(OAI3)) {
+			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
+			fprintf(f, "00- 1\n");
+			fprintf(f, "--0 1\n");
+		} else if (si.type == G(AOI4)) {
+			fprintf(f, ".names n%d n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
+			fprintf(f, "-0-0 1\n");
+			fprintf(f, "-00- 1\n");
+			fprintf(f, "0--0 1\n");
+			fprintf(f, "0-0- 1\n");
+		} else if (si.type == G(OAI4)) {
+			fprintf(f, ".names n%d n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
+			fprintf(f, "00-- 1\n");
+			fprintf(f, "--00 1\n");
+		} else if (si.type == G(FF)) {
+			fprintf(f, ".latch n%d n%d\n", si.in1, si.id);
+		} else if (si.type != G(NONE))
+			log_abort();
+		if (si.type != G(NONE))
+			count_gates++;
+	}
+
+	fprintf(f, ".end\n");
+	fclose(f);
+}
+
+void integrate_abc_results(RTLIL::Design *design, const abc_partition_t &part, std::string output_blif, bool builtin_lib,
+		std::map<std::string, int> &cell_stats, int &out_wires)
+{
+	if (!check_file_exists(output_blif))
+		log_error("Can't open ABC output file `%s'.\n", output_blif.c_str());
+
+	RTLIL::Design *mapped_design = new RTLIL::Design;
+	parse_blif(mapped_design, output_blif, builtin_lib ? "\\DFF" : "\\_dff_");
+
+	RTLIL::Module *mapped_mod = mapped_design->modules_["\\netlist"];
+	if (mapped_mod == NULL)
+		log_error("ABC output file does not contain a module `netlist'.\n");
+	for (auto &it : mapped_mod->wires_) {
+		RTLIL::Wire *w = it.second;
+		RTLIL::Wire *wire = module->addWire(remap_name(w->name));
+		design->select(module, wire);
+	}
+
+	if (builtin_lib)
+	{
+		for (auto &it : mapped_mod->cells_) {
+			RTLIL::Cell *c = it.second;
+			cell_stats[RTLIL::unescape_id(c->type)]++;
+			if (c->type == "\\ZERO" || c->type == "\\ONE") {
+				RTLIL::SigSig conn;
+				conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]);
+				conn.second = RTLIL::SigSpec(c->type == "\\ZERO" ? 0 : 1, 1);
+				module->connect(conn);
+				continue;
+			}
+			if (c->type == "\\BUF") {
+				RTLIL::SigSig conn;
+				conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]);
+				conn.second = RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]);
+				module->connect(conn);
+				continue;
+			}
+			if (c->type == "\\NOT") {
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_NOT_");
+				cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
+				cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
+				design->select(module, cell);
+				continue;
+			}
+			if (c->type == "\\AND" || c->type == "\\OR" || c->type == "\\XOR" || c->type == "\\NAND" || c->type == "\\NOR" || c->type == "\\XNOR") {
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_" + c->type.substr(1) + "_");
+				cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
+				cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
+				cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
+				design->select(module, cell);
+				continue;
+			}
+			if (c->type == "\\MUX") {
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_MUX_");
+				cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
+				cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
+				cell->setPort("\\S", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\S").as_wire()->name)]));
+				cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
+				design->select(module, cell);
+				continue;
+			}
+			if (c->type == "\\AOI3" || c->type == "\\OAI3") {
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_" + c->type.substr(1) + "_");
+				cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
+				cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
+				cell->setPort("\\C", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\C").as_wire()->name)]));
+				cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
+				design->select(module, cell);
+				continue;
+			}
+			if (c->type == "\\AOI4" || c->type == "\\OAI4") {
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_" + c->type.substr(1) + "_");
+				cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
+				cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
+				cell->setPort("\\C", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\C").as_wire()->name)]));
+				cell->setPort("\\D", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\D").as_wire()->name)]));
+				cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
+				design->select(module, cell);
+				continue;
+			}
+			if (c->type == "\\DFF") {
+				log_assert(clk_sig.size() == 1);
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), clk_polarity ? "$_DFF_P_" : "$_DFF_N_");
+				cell->setPort("\\D", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\D").as_wire()->name)]));
+				cell->setPort("\\Q", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Q").as_wire()->name)]));
+				cell->setPort("\\C", clk_sig);
+				design->select(module, cell);
+				continue;
+			}
+			log_abort();
+		}
+	}
+	else
+	{
+		for (auto &it : mapped_mod->cells_)
+		{
+			RTLIL::Cell *c = it.second;
+			cell_stats[RTLIL::unescape_id(c->type)]++;
+			if (c->type == "\\_const0_" || c->type == "\\_const1_") {
+				RTLIL::SigSig conn;
+				conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->connections().begin()->second.as_wire()->name)]);
+				conn.second = RTLIL::SigSpec(c->type == "\\_const0_" ? 0 : 1, 1);
+				module->connect(conn);
+				continue;
+			}
+			if (c->type == "\\_dff_") {
+				log_assert(clk_sig.size() == 1);
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), clk_polarity ? "$_DFF_P_" : "$_DFF_N_");
+				cell->setPort("\\D", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\D").as_wire()->name)]));
+				cell->setPort("\\Q", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Q").as_wire()->name)]));
+				cell->setPort("\\C", clk_sig);
+				design->select(module, cell);
+				continue;
+			}
+			RTLIL::Cell *cell = module->addCell(remap_name(c->name), c->type);
+			cell->parameters = c->parameters;
+			for (auto &conn : c->connections()) {
+				RTLIL::SigSpec newsig;
+				for (auto &c : conn.second.chunks()) {
+					if (c.width == 0)
+						continue;
+					log_assert(c.width == 1);
+					newsig.append(module->wires_[remap_name(c.wire->name)]);
+				}
+				cell->setPort(conn.first, newsig);
+			}
+			design->select(module, cell);
+		}
+	}
+
+	for (auto conn : mapped_mod->connections()) {
+		if (!conn.first.is_fully_const())
+			conn.first = RTLIL::SigSpec(module->wires_[remap_name(conn.first.as_wire()->name)]);
+		if (!conn.second.is_fully_const())
+			conn.second = RTLIL::SigSpec(module->wires_[remap_name(conn.second.as_wire()->name)]);
+		module->connect(conn);
+	}
+
+	for (int id : part.outputs) {
+		RTLIL::SigSig conn;
+		conn.first = signal_list[id].bit;
+		conn.second = RTLIL::SigSpec(module->wires_[remap_name(stringf("\\n%d", id))]);
+		module->connect(conn);
+		out_wires++;
+	}
+
+	for (int id : part.inputs) {
+		RTLIL::SigSig conn;
+		conn.first = RTLIL::SigSpec(module->wires_[remap_name(stringf("\\n%d", id))]);
+		conn.second = signal_list[id].bit;
+		module->connect(conn);
+	}
+
+	delete mapped_design;
+}
+
 void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::string script_file, std::string exe_file,
 		std::string liberty_file, std::string constr_file, bool cleanup, int lut_mode, bool dff_mode, std::string clk_str,
-		bool keepff, std::string delay_target, bool fast_mode)
+		bool keepff, std::string delay_target, bool fast_mode, int partition_size, int partition_jobs)
 {
+	PerformanceTimer extract_timer, loops_timer, export_timer, integrate_timer;
+	extract_timer.begin();
+
 	module = current_module;
 	map_autoidx = autoidx++;
 
@@ -562,7 +1026,7 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 	tempdir_name = make_temp_dir(tempdir_name);
 	log_header("Extracting gate netlist of module `%s' to `%s/input.blif'..\n", module->name.c_str(), tempdir_name.c_str());
 
-	std::string abc_script = stringf("read_blif %s/input.blif; ", tempdir_name.c_str());
+	std::string abc_script;
 
 	if (!liberty_file.empty()) {
 		abc_script += stringf("read_lib -w %s; ", liberty_file.c_str());
@@ -595,17 +1059,6 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 	for (size_t pos = abc_script.find("{D}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
 		abc_script = abc_script.substr(0, pos) + delay_target + abc_script.substr(pos+3);
 
-	abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
-	abc_script = add_echos_to_abc_cmd(abc_script);
-
-	for (size_t i = 0; i+1 < abc_script.size(); i++)
-		if (abc_script[i] == ';' && abc_script[i+1] == ' ')
-			abc_script[i+1] = '\n';
-
-	FILE *f = fopen(stringf("%s/abc.script", tempdir_name.c_str()).c_str(), "wt");
-	fprintf(f, "%s\n", abc_script.c_str());
-	fclose(f);
-
 	if (clk_str.empty()) {
 		if (clk_str[0] == '!') {
 			clk_polarity = false;
@@ -662,121 +1115,79 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 	for (auto &port_it : cell_it.second->connections())
 		mark_port(port_it.second);
 	
+	loops_timer.begin();
 	handle_loops();
+	loops_timer.end();
 
-	std::string buffer = stringf("%s/input.blif", tempdir_name.c_str());
-	f = fopen(buffer.c_str(), "wt");
-	if (f == NULL)
-		log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+	std::vector<abc_partition_t> partitions;
 
-	fprintf(f, ".model netlist\n");
+	if (partition_size > 0)
+		partition_netlist(partitions, partition_size);
 
-	int count_input = 0;
-	fprintf(f, ".inputs");
-	for (auto &si : signal_list) {
-		if (!si.is_port || si.type != G(NONE))
-			continue;
-		fprintf(f, " n%d", si.id);
-		count_input++;
+	if (GetSize(partitions) <= 1)
+	{
+		partitions.clear();
+		partitions.push_back(abc_partition_t());
+
+		for (auto &si : signal_list) {
+			if (si.type != G(NONE))
+				partitions.back().gates.push_back(si.id);
+			if (si.is_port && si.type == G(NONE))
+				partitions.back().inputs.push_back(si.id);
+			if (si.is_port && si.type != G(NONE))
+				partitions.back().outputs.push_back(si.id);
+		}
 	}
-	if (count_input == 0)
-		fprintf(f, " dummy_input\n");
-	fprintf(f, "\n");
 
-	int count_output = 0;
-	fprintf(f, ".outputs");
-	for (auto &si : signal_list) {
-		if (!si.is_port || si.type == G(NONE))
-			continue;
-		fprintf(f, " n%d", si.id);
-		count_output++;
-	}
-	fprintf(f, "\n");
+	int count_gates = 0, count_input = 0, count_output = 0;
+	std::vector<bool> input_seen(signal_list.size());
+	for (auto &part : partitions)
+	{
+		std::string buffer = stringf("%s/input%s.blif", tempdir_name.c_str(), part.suffix.c_str());
+		export_timer.begin();
+		write_input_blif(buffer, part, count_gates);
+		export_timer.end();
+		for (int id : part.inputs)
+			if (!input_seen[id]) {
+				input_seen[id] = true;
+				count_input++;
+			}
+		count_output += GetSize(part.outputs);
 
-	for (auto &si : signal_list)
-		fprintf(f, "# n%-5d %s\n", si.id, log_signal(si.bit));
+		std::string part_script = stringf("read_blif %s; ", buffer.c_str()) + abc_script;
+		part_script += stringf("; write_blif %s/output%s.blif", tempdir_name.c_str(), part.suffix.c_str());
+		part_script = add_echos_to_abc_cmd(part_script);
 
-	for (auto &si : signal_list) {
-		if (si.bit.wire == NULL) {
-			fprintf(f, ".names n%d\n", si.id);
-			if (si.bit == RTLIL::State::S1)
-				fprintf(f, "1\n");
-		}
-	}
+		for (size_t i = 0; i+1 < part_script.size(); i++)
+			if (part_script[i] == ';' && part_script[i+1] == ' ')
+				part_script[i+1] = '\n';
 
-	int count_gates = 0;
-	for (auto &si : signal_list) {
-		if (si.type == G(BUF)) {
-			fprintf(f, ".names n%d n%d\n", si.in1, si.id);
-			fprintf(f, "1 1\n");
-		} else if (si.type == G(NOT)) {
-			fprintf(f, ".names n%d n%d\n", si.in1, si.id);
-			fprintf(f, "0 1\n");
-		} else if (si.type == G(AND)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "11 1\n");
-		} else if (si.type == G(NAND)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "0- 1\n");
-			fprintf(f, "-0 1\n");
-		} else if (si.type == G(OR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "-1 1\n");
-			fprintf(f, "1- 1\n");
-		} else if (si.type == G(NOR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "00 1\n");
-		} else if (si.type == G(XOR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "01 1\n");
-			fprintf(f, "10 1\n");
-		} else if (si.type == G(XNOR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "00 1\n");
-			fprintf(f, "11 1\n");
-		} else if (si.type == G(MUX)) {
-			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "1-0 1\n");
-			fprintf(f, "-11 1\n");
-		} else if (si.type == G(AOI3)) {
-			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "-00 1\n");
-			fprintf(f, "0-0 1\n");
-		} else if (si.type == G(OAI3)) {
-			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "00- 1\n");
-			fprintf(f, "--0 1\n");
-		} else if (si.type == G(AOI4)) {
-			fprintf(f, ".names n%d n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
-			fprintf(f, "-0-0 1\n");
-			fprintf(f, "-00- 1\n");
-			fprintf(f, "0--0 1\n");
-			fprintf(f, "0-0- 1\n");
-		} else if (si.type == G(OAI4)) {
-			fprintf(f, ".names n%d n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
-			fprintf(f, "00-- 1\n");
-			fprintf(f, "--00 1\n");
-		} else if (si.type == G(FF)) {
-			fprintf(f, ".latch n%d n%d\n", si.in1, si.id);
-		} else if (si.type != G(NONE))
-			log_abort();
-		if (si.type != G(NONE))
-			count_gates++;
+		buffer = stringf("%s/abc%s.script", tempdir_name.c_str(), part.suffix.c_str());
+		FILE *f = fopen(buffer.c_str(), "wt");
+		if (f == NULL)
+			log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+		fprintf(f, "%s\n", part_script.c_str());
+		fclose(f);
 	}
 
-	fprintf(f, ".end\n");
-	fclose(f);
+	if (GetSize(partitions) > 1)
+		log("Extracted %d gates and %d wires to %d netlist partitions with %d inputs and %d outputs.\n",
+				count_gates, GetSize(signal_list), GetSize(partitions), count_input, count_output);
+	else
+		log("Extracted %d gates and %d wires to a netlist network with %d inputs and %d outputs.\n",
+				count_gates, GetSize(signal_list), count_input, count_output);
 
-	log("Extracted %d gates and %d wires to a netlist network with %d inputs and %d outputs.\n",
-			count_gates, GetSize(signal_list), count_input, count_output);
+	extract_timer.end();
+	log("Extraction took %.2f sec CPU time (%.2f sec breaking loops, %.2f sec writing BLIF).\n",
+			extract_timer.sec(), loops_timer.sec(), export_timer.sec());
 	log_push();
 	
 	if (count_output > 0)
 	{
 		log_header("Executing ABC.\n");
 
-		buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
-		f = fopen(buffer.c_str(), "wt");
+		std::string buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
+		FILE *f = fopen(buffer.c_str(), "wt");
 		if (f == NULL)
 			log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
 		fprintf(f, "GATE ZERO  1 Y=CONST0;\n");
@@ -806,179 +1217,100 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 			fclose(f);
 		}
 
-		buffer = stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
-		log("Running ABC command: %s\n", buffer.c_str());
-
-		abc_output_filter filt;
-		int ret = run_command(buffer, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
-		if (ret != 0)
-			log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
-
-		buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
-		f = fopen(buffer.c_str(), "rt");
-		if (f == NULL)
-			log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
-
-		bool builtin_lib = liberty_file.empty() && script_file.empty() && !lut_mode;
-		RTLIL::Design *mapped_design = abc_parse_blif(f, builtin_lib ? "\\DFF" : "\\_dff_");
-
-		fclose(f);
+#ifdef _WIN32
+		partition_jobs = 1;
+#endif
 
-		log_header("Re-integrating ABC results.\n");
-		RTLIL::Module *mapped_mod = mapped_design->modules_["\\netlist"];
-		if (mapped_mod == NULL)
-			log_error("ABC output file does not contain a module `netlist'.\n");
-		for (auto &it : mapped_mod->wires_) {
-			RTLIL::Wire *w = it.second;
-			RTLIL::Wire *wire = module->addWire(remap_name(w->name));
-			design->select(module, wire);
-		}
+		auto abc_start_time = std::chrono::steady_clock::now();
 
-		std::map<std::string, int> cell_stats;
-		if (builtin_lib)
+		if (GetSize(partitions) == 1 || partition_jobs <= 1)
 		{
-			for (auto &it : mapped_mod->cells_) {
-				RTLIL::Cell *c = it.second;
-				cell_stats[RTLIL::unescape_id(c->type)]++;
-				if (c->type == "\\ZERO" || c->type == "\\ONE") {
-					RTLIL::SigSig conn;
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]);
-					conn.second = RTLIL::SigSpec(c->type == "\\ZERO" ? 0 : 1, 1);
-					module->connect(conn);
-					continue;
-				}
-				if (c->type == "\\BUF") {
-					RTLIL::SigSig conn;
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]);
-					conn.second = RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]);
-					module->connect(conn);
-					continue;
-				}
-				if (c->type == "\\NOT") {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_NOT_");
-					cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
-					cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == "\\AND" || c->type == "\\OR" || c->type == "\\XOR" || c->type == "\\NAND" || c->type == "\\NOR" || c->type == "\\XNOR") {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_" + c->type.substr(1) + "_");
-					cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
-					cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
-					cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == "\\MUX") {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_MUX_");
-					cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
-					cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
-					cell->setPort("\\S", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\S").as_wire()->name)]));
-					cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == "\\AOI3" || c->type == "\\OAI3") {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_" + c->type.substr(1) + "_");
-					cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
-					cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
-					cell->setPort("\\C", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\C").as_wire()->name)]));
-					cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == "\\AOI4" || c->type == "\\OAI4") {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), "$_" + c->type.substr(1) + "_");
-					cell->setPort("\\A", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\A").as_wire()->name)]));
-					cell->setPort("\\B", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\B").as_wire()->name)]));
-					cell->setPort("\\C", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\C").as_wire()->name)]));
-					cell->setPort("\\D", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\D").as_wire()->name)]));
-					cell->setPort("\\Y", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Y").as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == "\\DFF") {
-					log_assert(clk_sig.size() == 1);
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), clk_polarity ? "$_DFF_P_" : "$_DFF_N_");
-					cell->setPort("\\D", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\D").as_wire()->name)]));
-					cell->setPort("\\Q", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Q").as_wire()->name)]));
-					cell->setPort("\\C", clk_sig);
-					design->select(module, cell);
-					continue;
-				}
-				log_abort();
+			for (auto &part : partitions)
+			{
+				buffer = stringf("%s -s -f %s/abc%s.script 2>&1", exe_file.c_str(), tempdir_name.c_str(), part.suffix.c_str());
+				log("Running ABC command: %s\n", buffer.c_str());
+
+				abc_output_filter filt;
+				int ret = run_command(buffer, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
+				if (ret != 0)
+					log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
 			}
 		}
 		else
 		{
-			for (auto &it : mapped_mod->cells_)
+			// run up to partition_jobs ABC processes concurrently. Each process writes its
+			// output and return code to a file in the temp dir, that we read back afterwards.
+			for (int batch_begin = 0; batch_begin < GetSize(partitions); batch_begin += partition_jobs)
 			{
-				RTLIL::Cell *c = it.second;
-				cell_stats[RTLIL::unescape_id(c->type)]++;
-				if (c->type == "\\_const0_" || c->type == "\\_const1_") {
-					RTLIL::SigSig conn;
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->connections().begin()->second.as_wire()->name)]);
-					conn.second = RTLIL::SigSpec(c->type == "\\_const0_" ? 0 : 1, 1);
-					module->connect(conn);
-					continue;
-				}
-				if (c->type == "\\_dff_") {
-					log_assert(clk_sig.size() == 1);
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), clk_polarity ? "$_DFF_P_" : "$_DFF_N_");
-					cell->setPort("\\D", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\D").as_wire()->name)]));
-					cell->setPort("\\Q", RTLIL::SigSpec(module->wires_[remap_name(c->getPort("\\Q").as_wire()->name)]));
-					cell->setPort("\\C", clk_sig);
-					design->select(module, cell);
-					continue;
+				int batch_end = std::min(batch_begin + partition_jobs, GetSize(partitions));
+				log("Running ABC on partitions %d to %d (%d parallel jobs).\n", batch_begin+1, batch_end, batch_end-batch_begin);
+
+				buffer.clear();
+				for (int i = batch_begin; i < batch_end; i++) {
+					const char *suffix = partitions[i].suffix.c_str();
+					buffer += stringf("( %s -s -f %s/abc%s.script > %s/abc%s.log 2>&1; echo $? > %s/abc%s.ret ) & ", exe_file.c_str(),
+							tempdir_name.c_str(), suffix, tempdir_name.c_str(), suffix, tempdir_name.c_str(), suffix);
 				}
-				RTLIL::Cell *cell = module->addCell(remap_name(c->name), c->type);
-				cell->parameters = c->parameters;
-				for (auto &conn : c->connections()) {
-					RTLIL::SigSpec newsig;
-					for (auto &c : conn.second.chunks()) {
-						if (c.width == 0)
-							continue;
-						log_assert(c.width == 1);
-						newsig.append(module->wires_[remap_name(c.wire->name)]);
-					}
-					cell->setPort(conn.first, newsig);
+				buffer += "wait";
+
+				int ret = run_command(buffer);
+				if (ret != 0)
+					log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
+
+				for (int i = batch_begin; i < batch_end; i++)
+				{
+					const char *suffix = partitions[i].suffix.c_str();
+					log("Output of ABC run for partition %d:\n", i+1);
+
+					abc_output_filter filt;
+					std::ifstream log_f(stringf("%s/abc%s.log", tempdir_name.c_str(), suffix));
+					for (std::string line; std::getline(log_f, line);)
+						filt.next_line(line + "\n");
+
+					std::ifstream ret_f(stringf("%s/abc%s.ret", tempdir_name.c_str(), suffix));
+					if (!(ret_f >> ret) || ret != 0)
+						log_error("ABC: execution of ABC script `%s/abc%s.script' failed: return code %d.\n", tempdir_name.c_str(), suffix, ret);
 				}
-				design->select(module, cell);
 			}
 		}
 
-		for (auto conn : mapped_mod->connections()) {
-			if (!conn.first.is_fully_const())
-				conn.first = RTLIL::SigSpec(module->wires_[remap_name(conn.first.as_wire()->name)]);
-			if (!conn.second.is_fully_const())
-				conn.second = RTLIL::SigSpec(module->wires_[remap_name(conn.second.as_wire()->name)]);
-			module->connect(conn);
+		std::chrono::duration<double> abc_runtime = std::chrono::steady_clock::now() - abc_start_time;
+		log("ABC took %.2f sec wall-clock time.\n", abc_runtime.count());
+
+		log_header("Re-integrating ABC results.\n");
+		integrate_timer.begin();
+
+		bool builtin_lib = liberty_file.empty() && script_file.empty() && !lut_mode;
+		std::map<std::string, int> cell_stats;
+		std::vector<bool> input_counted(signal_list.size());
+		int in_wires = 0, out_wires = 0, boundary_wires = 0;
+
+		for (auto &part : partitions) {
+			if (&part != &partitions.front())
+				map_autoidx = autoidx++;
+			buffer = stringf("%s/output%s.blif", tempdir_name.c_str(), part.suffix.c_str());
+			integrate_abc_results(design, part, buffer, builtin_lib, cell_stats, out_wires);
+			for (int id : part.inputs) {
+				if (input_counted[id])
+					continue;
+				input_counted[id] = true;
+				if (signal_list[id].type == G(NONE))
+					in_wires++;
+				else
+					boundary_wires++;
+			}
 		}
 
 		for (auto &it : cell_stats)
 			log("ABC RESULTS:   %15s cells: %8d\n", it.first.c_str(), it.second);
-		int in_wires = 0, out_wires = 0;
-		for (auto &si : signal_list)
-			if (si.is_port) {
-				char buffer[100];
-				snprintf(buffer, 100, "\\n%d", si.id);
-				RTLIL::SigSig conn;
-				if (si.type != G(NONE)) {
-					conn.first = si.bit;
-					conn.second = RTLIL::SigSpec(module->wires_[remap_name(buffer)]);
-					out_wires++;
-				} else {
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(buffer)]);
-					conn.second = si.bit;
-					in_wires++;
-				}
-				module->connect(conn);
-			}
 		log("ABC RESULTS:        internal signals: %8d\n", int(signal_list.size()) - in_wires - out_wires);
 		log("ABC RESULTS:           input signals: %8d\n", in_wires);
 		log("ABC RESULTS:          output signals: %8d\n", out_wires);
+		if (GetSize(partitions) > 1)
+			log("ABC RESULTS:        boundary signals: %8d\n", boundary_wires);
 
-		delete mapped_design;
+		integrate_timer.end();
+		log("Re-integration took %.2f sec CPU time.\n", integrate_timer.sec());
 	}
 	else
 	{
@@ -1083,6 +1415,19 @@ struct AbcPass : public Pass {
 		log("        set the \"keep\" attribute on flip-flop output wires. (and thus preserve\n");
 		log("        them, for example for equivialence checking.)\n");
 		log("\n");
+		log("    -partition <size>\n");
+		log("        split the extracted gate netlist into partitions of (at most) the\n");
+		log("        specified number of gates and map each partition with a separate ABC\n");
+		log("        run. the gates are collected by walking the fan-in cones of the\n");
+		log("        outputs, and a new partition is started whenever the current one is\n");
+		log("        full, also in the middle of a cone. this bounds the runtime and memory\n");
+		log("        usage of ABC on very large (flattened) modules at the cost of some\n");
+		log("        optimization across partition boundaries.\n");
+		log("\n");
+		log("    -jobs <N>\n");
+		log("        run up to N ABC processes in parallel when -partition is used. the\n");
+		log("        default is the number of available CPUs.\n");
+		log("\n");
 		log("    -nocleanup\n");
 		log("        when this option is used, the temporary files created by this pass\n");
 		log("        are not removed. this is useful for debugging.\n");
@@ -1104,7 +1449,11 @@ struct AbcPass : public Pass {
 		std::string exe_file = proc_self_dirname() + "yosys-abc";
 		std::string script_file, liberty_file, constr_file, clk_str, delay_target;
 		bool fast_mode = false, dff_mode = false, keepff = false, cleanup = true;
-		int lut_mode = 0;
+		int lut_mode = 0, partition_size = 0, partition_jobs = 1;
+
+#ifndef _WIN32
+		partition_jobs = std::max(int(sysconf(_SC_NPROCESSORS_ONLN)), 1);
+#endif
 
 #ifdef _WIN32
 		if (!check_file_exists(exe_file + ".exe") && check_file_exists(proc_self_dirname() + "..\\yosys-abc.exe"))
@@ -1165,6 +1514,14 @@ struct AbcPass : public Pass {
 				keepff = true;
 				continue;
 			}
+			if (arg == "-partition" && argidx+1 < args.size()) {
+				partition_size = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (arg == "-jobs" && argidx+1 < args.size()) {
+				partition_jobs = atoi(args[++argidx].c_str());
+				continue;
+			}
 			if (arg == "-nocleanup") {
 				cleanup = false;
 				continue;
@@ -1183,7 +1540,7 @@ struct AbcPass : public Pass {
 				if (mod_it.second->processes.size() > 0)
 					log("Skipping module %s as it contains processes.\n", mod_it.second->name.c_str());
 				else
-					abc_module(design, mod_it.second, script_file, exe_file, liberty_file, constr_file, cleanup, lut_mode, dff_mode, clk_str, keepff, delay_target, fast_mode);
+					abc_module(design, mod_it.second, script_file, exe_file, liberty_file, constr_file, cleanup, lut_mode, dff_mode, clk_str, keepff, delay_target, fast_mode, partition_size, partition_jobs);
 			}
 
 		assign_map.clear();
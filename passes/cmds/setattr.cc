@@ -176,7 +176,11 @@ struct SetparamPass : public Pass {
 
 			for (auto &it : module->cells_)
 				if (design->selected(module, it.second))
-					do_setunset(it.second->parameters, setunset_list);
+					for (auto &item : setunset_list)
+						if (item.unset)
+							it.second->unsetParam(item.name);
+						else
+							it.second->setParam(item.name, item.value);
 		}
 	}
 } SetparamPass;
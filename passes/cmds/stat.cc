@@ -20,6 +20,7 @@
 #include "kernel/register.h"
 #include "kernel/celltypes.h"
 #include "kernel/log.h"
+#include "kernel/cost.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -182,12 +183,23 @@ struct StatPass : public Pass {
 		log("        annotate internal cell types with their word width.\n");
 		log("        e.g. $add_8 for an 8 bit wide $add cell.\n");
 		log("\n");
+		log("    -cost\n");
+		log("        print the estimated cost of the selected cells, using the same cost\n");
+		log("        model as the abc pass. instances of user modules are counted with the\n");
+		log("        cost of the whole module, including its submodules.\n");
+		log("\n");
+		log("    -assert-cost <N>\n");
+		log("        like -cost, but also fail with an error if the total estimated cost of\n");
+		log("        the selected cells is not <N>.\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
 		log_header("Printing statistics.\n");
 
 		bool width_mode = false;
+		bool cost_mode = false;
+		int assert_cost = -1;
 		RTLIL::Module *top_mod = NULL;
 		std::map<RTLIL::IdString, statdata_t> mod_stat;
 
@@ -198,6 +210,15 @@ struct StatPass : public Pass {
 				width_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-cost") {
+				cost_mode = true;
+				continue;
+			}
+			if (args[argidx] == "-assert-cost" && argidx+1 < args.size()) {
+				assert_cost = atoi(args[++argidx].c_str());
+				cost_mode = true;
+				continue;
+			}
 			if (args[argidx] == "-top" && argidx+1 < args.size()) {
 				if (design->modules_.count(RTLIL::escape_id(args[argidx+1])) == 0)
 					log_cmd_error("Can't find module %s.\n", args[argidx+1].c_str());
@@ -208,6 +229,9 @@ struct StatPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		CostCache *cost_cache = cost_mode ? CostCache::get(design) : nullptr;
+		int total_cost = 0;
+
 		for (auto &it : design->modules_)
 		{
 			if (!design->selected_module(it.first))
@@ -224,6 +248,15 @@ struct StatPass : public Pass {
 			log("=== %s%s ===\n", RTLIL::id2cstr(it.first), design->selected_whole_module(it.first) ? "" : " (partially selected)");
 			log("\n");
 			data.log_data();
+
+			if (cost_mode) {
+				int cost = 0;
+				for (auto cell : it.second->selected_cells())
+					cost += cost_cache->get_cost(cell);
+				log("\n");
+				log("   Estimated cost:              %6d\n", cost);
+				total_cost += cost;
+			}
 		}
 
 		if (top_mod != NULL)
@@ -240,6 +273,9 @@ struct StatPass : public Pass {
 		}
 
 		log("\n");
+
+		if (assert_cost >= 0 && total_cost != assert_cost)
+			log_error("Assertion failed: estimated cost is %d instead of the asserted %d.\n", total_cost, assert_cost);
 	}
 } StatPass;
  
@@ -116,7 +116,7 @@ static RTLIL::Const sig2const(ConstEval &ce, RTLIL::SigSpec sig, RTLIL::State no
 	}
 
 	ce.assign_map.apply(sig);
-	ce.values_map.apply(sig);
+	ce.apply_values(sig);
 
 	for (int i = 0; i < GetSize(sig); i++)
 		if (sig[i].wire != NULL)
@@ -161,16 +161,16 @@ undef_bit_in_next_state:
 		if (state_in >= 0)
 			log_state_in = fsm_data.state_table.at(state_in);
 
-		if (states.count(ce.values_map(ce.assign_map(dff_in)).as_const()) == 0) {
+		if (states.count(ce.values(dff_in).as_const()) == 0) {
 			log("  transition: %10s %s -> INVALID_STATE(%s) %s  <ignored invalid transistion!>%s\n",
 					log_signal(log_state_in), log_signal(tr.ctrl_in),
-					log_signal(ce.values_map(ce.assign_map(dff_in))), log_signal(tr.ctrl_out),
+					log_signal(ce.values(dff_in)), log_signal(tr.ctrl_out),
 					undef_bit_in_next_state_mode ? " SHORTENED" : "");
 			return;
 		}
 
 		tr.state_in = state_in;
-		tr.state_out = states.at(ce.values_map(ce.assign_map(dff_in)).as_const());
+		tr.state_out = states.at(ce.values(dff_in).as_const());
 
 		if (dff_in.is_fully_def()) {
 			fsm_data.transition_table.push_back(tr);
@@ -190,7 +190,7 @@ undef_bit_in_next_state:
 			goto undef_bit_in_next_state;
 
 	log_assert(undef.size() > 0);
-	log_assert(ce.stop_signals.check_all(undef));
+	log_assert(ce.is_stopped(undef));
 
 	undef = undef.extract(0, 1);
 	constval = undef;
@@ -171,9 +171,9 @@ static void map_fsm(RTLIL::Cell *fsm_cell, RTLIL::Module *module)
 
 	RTLIL::Cell *state_dff = module->addCell(NEW_ID, "");
 	if (fsm_cell->getPort("\\ARST").is_fully_const()) {
-		state_dff->type = "$dff";
+		state_dff->setType("$dff");
 	} else {
-		state_dff->type = "$adff";
+		state_dff->setType("$adff");
 		state_dff->parameters["\\ARST_POLARITY"] = fsm_cell->parameters["\\ARST_POLARITY"];
 		state_dff->parameters["\\ARST_VALUE"] = fsm_data.state_table[fsm_data.reset_state];
 		for (auto &bit : state_dff->parameters["\\ARST_VALUE"].bits)
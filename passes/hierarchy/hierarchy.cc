@@ -155,14 +155,14 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 			int idx = atoi(cell->type.str().substr(pos_idx + 1, pos_num).c_str());
 			int num = atoi(cell->type.str().substr(pos_num + 1, pos_type).c_str());
 			array_cells[cell] = std::pair<int, int>(idx, num);
-			cell->type = cell->type.str().substr(pos_type + 1);
+			cell->setType(cell->type.str().substr(pos_type + 1));
 		}
 
 		if (design->modules_.count(cell->type) == 0)
 		{
 			if (design->modules_.count("$abstract" + cell->type.str()))
 			{
-				cell->type = design->modules_.at("$abstract" + cell->type.str())->derive(design, cell->parameters);
+				cell->setType(design->modules_.at("$abstract" + cell->type.str())->derive(design, cell->parameters));
 				cell->parameters.clear();
 				did_something = true;
 				continue;
@@ -208,7 +208,7 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 			continue;
 
 		RTLIL::Module *mod = design->modules_[cell->type];
-		cell->type = mod->derive(design, cell->parameters);
+		cell->setType(mod->derive(design, cell->parameters));
 		cell->parameters.clear();
 		did_something = true;
 	}
@@ -21,6 +21,7 @@
 #include "kernel/satgen.h"
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
+#include "kernel/utils.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -45,6 +46,8 @@ struct MemoryShareWorker
 	std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, int>> sig_to_mux;
 	std::map<std::set<std::map<RTLIL::SigBit, bool>>, RTLIL::SigBit> conditions_logic_cache;
 
+	PerformanceTimer feedback_timer, addr_timer, sat_setup_timer, sat_solve_timer;
+
 
 	// -----------------------------------------------------------------
 	// Converting feedbacks to async read ports to proper enable signals
@@ -480,6 +483,62 @@ struct MemoryShareWorker
 	}
 
 
+	// ---------------------------------------------------------------------------
+	// One SAT problem for the whole module, extended with the input cones of the EN
+	// signals as they are needed. When the cone logic contains loops or bits with
+	// more than one driver then there is one SAT problem per memory instead, so
+	// constraints from cells outside the cones can not affect the result.
+	// ---------------------------------------------------------------------------
+
+	ezDefaultSAT *ez;
+	SatGen *satgen;
+	std::set<RTLIL::Cell*> sat_cells;
+	std::map<std::pair<int, int>, bool> sat_pair_cache;
+	bool sat_shared;
+
+	bool cone_logic_is_safe()
+	{
+		TopoSort<RTLIL::Cell*> toposort;
+		toposort.analyze_loops = false;
+
+		for (auto &it : modwalker.cell_inputs) {
+			toposort.node(it.first);
+			for (auto bit : it.second) {
+				if (modwalker.signal_drivers.count(bit) == 0)
+					continue;
+				if (GetSize(modwalker.signal_drivers.at(bit)) > 1)
+					return false;
+				for (auto &pbit : modwalker.signal_drivers.at(bit))
+					toposort.edge(pbit.cell, it.first);
+			}
+		}
+
+		return toposort.sort();
+	}
+
+	void reset_sat()
+	{
+		delete satgen;
+		delete ez;
+
+		ez = new ezDefaultSAT;
+		satgen = new SatGen(ez, &modwalker.sigmap);
+		sat_cells.clear();
+		sat_pair_cache.clear();
+	}
+
+	bool sat_both_active(int en1, int en2)
+	{
+		std::pair<int, int> key(std::min(en1, en2), std::max(en1, en2));
+		if (sat_pair_cache.count(key) == 0) {
+			sat_solve_timer.begin();
+			sat_pair_cache[key] = ez->solve(en1, en2);
+			sat_solve_timer.end();
+		}
+		return sat_pair_cache.at(key);
+	}
+
+
 	// --------------------------------------------------------
 	// Consolidate write ports using sat-based resource sharing
 	// --------------------------------------------------------
@@ -489,9 +548,6 @@ struct MemoryShareWorker
 		if (wr_ports.size() <= 1)
 			return;
 
-		ezDefaultSAT ez;
-		SatGen satgen(&ez, &modwalker.sigmap);
-
 		// find list of considered ports and port pairs
 
 		std::set<int> considered_ports;
@@ -544,7 +600,12 @@ struct MemoryShareWorker
 
 		// create SAT representation of common input cone of all considered EN signals
 
-		std::set<RTLIL::Cell*> sat_cells;
+		sat_setup_timer.begin();
+
+		if (ez == NULL || !sat_shared)
+			reset_sat();
+
+		std::set<RTLIL::Cell*> cone_cells;
 		std::set<RTLIL::SigBit> bits_queue;
 		std::map<int, int> port_to_sat_variable;
 
@@ -552,7 +613,7 @@ struct MemoryShareWorker
 			if (considered_port_pairs.count(i) || considered_port_pairs.count(i+1))
 			{
 				RTLIL::SigSpec sig = modwalker.sigmap(wr_ports[i]->getPort("\\EN"));
-				port_to_sat_variable[i] = ez.expression(ez.OpOr, satgen.importSigSpec(sig));
+				port_to_sat_variable[i] = ez->expression(ez->OpOr, satgen->importSigSpec(sig));
 
 				std::vector<RTLIL::SigBit> bits = sig;
 				bits_queue.insert(bits.begin(), bits.end());
@@ -564,20 +625,24 @@ struct MemoryShareWorker
 			modwalker.get_drivers(portbits, bits_queue);
 			bits_queue.clear();
 
+			// cells already in the SAT problem have their input cone imported too
 			for (auto &pbit : portbits)
-				if (sat_cells.count(pbit.cell) == 0 && cone_ct.cell_known(pbit.cell->type)) {
+				if (sat_cells.count(pbit.cell) == 0 && cone_cells.count(pbit.cell) == 0 && cone_ct.cell_known(pbit.cell->type)) {
 					std::set<RTLIL::SigBit> &cell_inputs = modwalker.cell_inputs[pbit.cell];
 					bits_queue.insert(cell_inputs.begin(), cell_inputs.end());
-					sat_cells.insert(pbit.cell);
+					cone_cells.insert(pbit.cell);
 				}
 		}
 
-		log("  Common input cone for all EN signals: %d cells.\n", int(sat_cells.size()));
+		for (auto cell : cone_cells) {
+			satgen->importCell(cell);
+			sat_cells.insert(cell);
+		}
 
-		for (auto cell : sat_cells)
-			satgen.importCell(cell);
+		sat_setup_timer.end();
 
-		log("  Size of unconstrained SAT problem: %d variables, %d clauses\n", ez.numCnfVariables(), ez.numCnfClauses());
+		log("  Common input cone for all EN signals: %d cells (%d new).\n", GetSize(sat_cells), GetSize(cone_cells));
+		log("  Size of unconstrained SAT problem: %d variables, %d clauses\n", ez->numCnfVariables(), ez->numCnfClauses());
 
 		// merge subsequent ports if possible
 
@@ -586,13 +651,13 @@ struct MemoryShareWorker
 			if (!considered_port_pairs.count(i))
 				continue;
 
-			if (ez.solve(port_to_sat_variable.at(i-1), port_to_sat_variable.at(i))) {
+			if (sat_both_active(port_to_sat_variable.at(i-1), port_to_sat_variable.at(i))) {
 				log("  According to SAT solver sharing of port %d with port %d is not possible.\n", i-1, i);
 				continue;
 			}
 
 			log("  Merging port %d into port %d.\n", i-1, i);
-			port_to_sat_variable.at(i) = ez.OR(port_to_sat_variable.at(i-1), port_to_sat_variable.at(i));
+			port_to_sat_variable.at(i) = ez->OR(port_to_sat_variable.at(i-1), port_to_sat_variable.at(i));
 
 			RTLIL::SigSpec last_addr = wr_ports[i-1]->getPort("\\ADDR");
 			RTLIL::SigSpec last_data = wr_ports[i-1]->getPort("\\DATA");
@@ -645,7 +710,7 @@ struct MemoryShareWorker
 	// -------------
 
 	MemoryShareWorker(RTLIL::Design *design, RTLIL::Module *module) :
-			design(design), module(module), sigmap(module)
+			design(design), module(module), sigmap(module), ez(NULL), satgen(NULL)
 	{
 		std::map<std::string, std::pair<std::vector<RTLIL::Cell*>, std::vector<RTLIL::Cell*>>> memindex;
 
@@ -679,11 +744,18 @@ struct MemoryShareWorker
 			}
 		}
 
+		if (memindex.empty())
+			return;
+
 		for (auto &it : memindex) {
 			std::sort(it.second.first.begin(), it.second.first.end(), memcells_cmp);
 			std::sort(it.second.second.begin(), it.second.second.end(), memcells_cmp);
+			feedback_timer.begin();
 			translate_rd_feedback_to_en(it.first, it.second.first, it.second.second);
+			feedback_timer.end();
+			addr_timer.begin();
 			consolidate_wr_by_addr(it.first, it.second.second);
+			addr_timer.end();
 		}
 
 		cone_ct.setup_internals();
@@ -698,10 +770,20 @@ struct MemoryShareWorker
 		cone_ct.cell_types.erase("$shift");
 		cone_ct.cell_types.erase("$shiftx");
 
+		sat_setup_timer.begin();
 		modwalker.setup(design, module, &cone_ct);
+		sat_shared = cone_logic_is_safe();
+		sat_setup_timer.end();
 
 		for (auto &it : memindex)
 			consolidate_wr_using_sat(it.first, it.second.second);
+
+		delete satgen;
+		delete ez;
+
+		log("Sharing memory ports in module %s took %.2f sec CPU time (%.2f sec read feedback, %.2f sec merging by address, %.2f sec SAT setup, %.2f sec SAT solving).\n",
+				log_id(module), feedback_timer.sec() + addr_timer.sec() + sat_setup_timer.sec() + sat_solve_timer.sec(),
+				feedback_timer.sec(), addr_timer.sec(), sat_setup_timer.sec(), sat_solve_timer.sec());
 	}
 };
 
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <set>
+#include <unordered_map>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -33,54 +34,215 @@ using RTLIL::id2cstr;
 CellTypes ct, ct_reg, ct_all;
 int count_rm_cells, count_rm_wires;
 
-void rmunused_module_cells(RTLIL::Module *module, bool verbose)
+// Dense integer ids for all wire bits in a module, and a union-find structure
+// over these ids that resolves the module connections like a SigMap would do.
+// Bit pools are simply std::vector<bool> indexed by the same ids. The entries
+// in map_to are bit ids, or -1-state for classes driven by a constant.
+
+struct ModuleBits
 {
-	SigMap sigmap(module);
-	std::set<RTLIL::Cell*, RTLIL::sort_by_name_id<RTLIL::Cell>> queue, unused;
+	std::unordered_map<RTLIL::Wire*, int> wire_offset;
+	std::vector<RTLIL::SigBit> bits;
+	std::vector<int> map_to, parent, class_size;
+
+	ModuleBits(RTLIL::Module *module)
+	{
+		for (auto &it : module->wires_) {
+			wire_offset[it.second] = GetSize(bits);
+			for (int i = 0; i < it.second->width; i++)
+				bits.push_back(RTLIL::SigBit(it.second, i));
+		}
+
+		map_to.resize(GetSize(bits));
+		parent.resize(GetSize(bits));
+		class_size.resize(GetSize(bits), 1);
+		for (int i = 0; i < GetSize(bits); i++)
+			map_to[i] = parent[i] = i;
+
+		for (auto &it : module->connections())
+			add(it.first, it.second);
+	}
+
+	int size() const
+	{
+		return GetSize(bits);
+	}
+
+	int id(const RTLIL::SigBit &bit) const
+	{
+		return bit.wire ? wire_offset.at(bit.wire) + bit.offset : -1;
+	}
+
+	int find(int i)
+	{
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	}
+
+	// same as SigMap::add(from, to): the merged class is mapped to
+	// whatever the class of 'to' was mapped to before
+	void add(const RTLIL::SigSpec &from, const RTLIL::SigSpec &to)
+	{
+		log_assert(GetSize(from) == GetSize(to));
+
+		for (int i = 0; i < GetSize(from); i++)
+		{
+			if (from[i].wire == NULL)
+				continue;
+
+			int r1 = find(id(from[i]));
+
+			if (to[i].wire == NULL) {
+				map_to[r1] = -1 - int(to[i].data);
+				continue;
+			}
+
+			int r2 = find(id(to[i]));
+
+			if (r1 == r2)
+				continue;
+
+			if (class_size[r1] < class_size[r2]) {
+				parent[r1] = r2;
+				class_size[r2] += class_size[r1];
+			} else {
+				parent[r2] = r1;
+				class_size[r1] += class_size[r2];
+				map_to[r1] = map_to[r2];
+			}
+		}
+	}
+
+	// same as SigMap::add(bit): make the bit the representative of its class
+	void set_canonical(int i)
+	{
+		map_to[find(i)] = i;
+	}
+
+	int map_id(const RTLIL::SigBit &bit)
+	{
+		return bit.wire ? map_to[find(id(bit))] : -1;
+	}
+
+	RTLIL::SigBit map(const RTLIL::SigBit &bit)
+	{
+		int i = map_id(bit);
+		if (i >= 0)
+			return bits[i];
+		return bit.wire ? RTLIL::SigBit(RTLIL::State(-1 - i)) : bit;
+	}
+
+	void apply(RTLIL::SigSpec &sig)
+	{
+		for (auto &bit : sig)
+			bit = map(bit);
+	}
+
+	void pool_add(std::vector<bool> &pool, const RTLIL::SigSpec &sig) const
+	{
+		for (auto &bit : sig)
+			if (bit.wire != NULL)
+				pool[id(bit)] = true;
+	}
+
+	bool pool_check(const std::vector<bool> &pool, const RTLIL::SigBit &bit) const
+	{
+		return bit.wire != NULL && pool[id(bit)];
+	}
+
+	bool pool_check_any(const std::vector<bool> &pool, const RTLIL::SigSpec &sig) const
+	{
+		for (auto &bit : sig)
+			if (pool_check(pool, bit))
+				return true;
+		return false;
+	}
+};
+
+void rmunused_module_cells(RTLIL::Module *module, ModuleBits &modbits, bool verbose)
+{
+	RTLIL::IdString id_keep = "\\keep";
+
+	// cell i reads the bits input_bits[input_start[i]] .. input_bits[input_start[i+1]-1]
+	std::vector<RTLIL::Cell*> cells;
+	std::vector<std::pair<int, int>> driver_list;
+	std::vector<int> input_start, input_bits;
+	std::vector<int> queue;
 
-	SigSet<RTLIL::Cell*> wire2driver;
 	for (auto &it : module->cells_) {
 		RTLIL::Cell *cell = it.second;
+		int cell_idx = GetSize(cells);
+		cells.push_back(cell);
+		input_start.push_back(GetSize(input_bits));
 		for (auto &it2 : cell->connections()) {
-			if (!ct.cell_input(cell->type, it2.first))
-				wire2driver.insert(sigmap(it2.second), cell);
+			bool is_input = ct.cell_input(cell->type, it2.first);
+			bool is_output = ct.cell_output(cell->type, it2.first);
+			for (auto &bit : it2.second) {
+				int bit_id = modbits.map_id(bit);
+				if (bit_id < 0)
+					continue;
+				if (!is_input)
+					driver_list.push_back(std::pair<int, int>(bit_id, cell_idx));
+				if (!is_output)
+					input_bits.push_back(bit_id);
+			}
 		}
 		if (cell->type == "$memwr" || cell->type == "$assert" || cell->has_keep_attr())
-			queue.insert(cell);
-		unused.insert(cell);
+			queue.push_back(cell_idx);
 	}
-
+	input_start.push_back(GetSize(input_bits));
+
+	// the driver graph in compressed form, the cells driving bit i
+	// are driver_cells[driver_start[i]] .. driver_cells[driver_start[i+1]-1]
+	std::vector<int> driver_start(modbits.size() + 1), driver_cells(GetSize(driver_list));
+	for (auto &it : driver_list)
+		driver_start[it.first + 1]++;
+	for (int i = 0; i < modbits.size(); i++)
+		driver_start[i + 1] += driver_start[i];
+	std::vector<int> driver_pos(driver_start.begin(), driver_start.end() - 1);
+	for (auto &it : driver_list)
+		driver_cells[driver_pos[it.first]++] = it.second;
+
+	std::vector<bool> used_cells(GetSize(cells));
+	for (int cell_idx : queue)
+		used_cells[cell_idx] = true;
+
+	std::vector<int> bit_queue;
 	for (auto &it : module->wires_) {
 		RTLIL::Wire *wire = it.second;
-		if (wire->port_output || wire->get_bool_attribute("\\keep")) {
-			std::set<RTLIL::Cell*> cell_list;
-			wire2driver.find(sigmap(wire), cell_list);
-			for (auto cell : cell_list)
-				queue.insert(cell);
-		}
+		if (wire->port_output || wire->get_bool_attribute(id_keep))
+			for (int i = 0; i < wire->width; i++)
+				bit_queue.push_back(modbits.map_id(RTLIL::SigBit(wire, i)));
 	}
 
-	while (!queue.empty())
+	while (!bit_queue.empty() || !queue.empty())
 	{
-		std::set<RTLIL::Cell*, RTLIL::sort_by_name_id<RTLIL::Cell>> new_queue;
-		for (auto cell : queue)
-			unused.erase(cell);
-		for (auto cell : queue) {
-			for (auto &it : cell->connections()) {
-				if (!ct.cell_output(cell->type, it.first)) {
-					std::set<RTLIL::Cell*> cell_list;
-					wire2driver.find(sigmap(it.second), cell_list);
-					for (auto c : cell_list) {
-						if (unused.count(c))
-							new_queue.insert(c);
-					}
+		while (!bit_queue.empty()) {
+			int bit_id = bit_queue.back();
+			bit_queue.pop_back();
+			if (bit_id < 0)
+				continue;
+			for (int i = driver_start[bit_id]; i < driver_start[bit_id + 1]; i++) {
+				int cell_idx = driver_cells[i];
+				if (!used_cells[cell_idx]) {
+					used_cells[cell_idx] = true;
+					queue.push_back(cell_idx);
 				}
 			}
 		}
-		queue.swap(new_queue);
+
+		if (!queue.empty()) {
+			int cell_idx = queue.back();
+			queue.pop_back();
+			bit_queue.insert(bit_queue.end(), input_bits.begin() + input_start[cell_idx], input_bits.begin() + input_start[cell_idx + 1]);
+		}
 	}
 
-	for (auto cell : unused) {
+	for (int i = 0; i < GetSize(cells); i++) {
+		if (used_cells[i])
+			continue;
+		RTLIL::Cell *cell = cells[i];
 		if (verbose)
 			log("  removing unused `%s' cell `%s'.\n", cell->type.c_str(), cell->name.c_str());
 		module->design->scratchpad_set_bool("opt.did_something", true);
@@ -91,13 +253,14 @@ void rmunused_module_cells(RTLIL::Module *module, bool verbose)
 
 int count_nontrivial_wire_attrs(RTLIL::Wire *w)
 {
-	int count = w->attributes.size();
-	count -= w->attributes.count("\\src");
-	count -= w->attributes.count("\\unused_bits");
+	int count = 0;
+	for (auto &it : w->attributes)
+		if (it.first != "\\src" && it.first != "\\unused_bits")
+			count++;
 	return count;
 }
 
-bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, SigPool &regs, SigPool &conns, std::set<RTLIL::Wire*> &direct_wires)
+bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, ModuleBits &modbits, std::vector<bool> &regs, std::vector<bool> &conns, std::vector<bool> &direct_bits)
 {
 	RTLIL::Wire *w1 = s1.wire;
 	RTLIL::Wire *w2 = s2.wire;
@@ -109,12 +272,13 @@ bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, SigPool &regs, SigPoo
 		return w2->port_input;
 
 	if (w1->name[0] == '\\' && w2->name[0] == '\\') {
-		if (regs.check_any(s1) != regs.check_any(s2))
-			return regs.check_any(s2);
-		if (direct_wires.count(w1) != direct_wires.count(w2))
-			return direct_wires.count(w2) != 0;
-		if (conns.check_any(s1) != conns.check_any(s2))
-			return conns.check_any(s2);
+		int i1 = modbits.id(s1), i2 = modbits.id(s2);
+		if (regs[i1] != regs[i2])
+			return regs[i2];
+		if (direct_bits[i1] != direct_bits[i2])
+			return direct_bits[i2];
+		if (conns[i1] != conns[i2])
+			return conns[i2];
 	}
 
 	if (w1->port_output != w2->port_output)
@@ -144,10 +308,12 @@ bool check_public_name(RTLIL::IdString id)
 	return true;
 }
 
-void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbose)
+void rmunused_module_signals(RTLIL::Module *module, ModuleBits &modbits, bool purge_mode, bool verbose)
 {
-	SigPool register_signals;
-	SigPool connected_signals;
+	RTLIL::IdString id_keep = "\\keep", id_unused_bits = "\\unused_bits";
+
+	std::vector<bool> register_signals(modbits.size());
+	std::vector<bool> connected_signals(modbits.size());
 
 	if (!purge_mode)
 		for (auto &it : module->cells_) {
@@ -155,71 +321,100 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 			if (ct_reg.cell_known(cell->type))
 				for (auto &it2 : cell->connections())
 					if (ct_reg.cell_output(cell->type, it2.first))
-						register_signals.add(it2.second);
+						modbits.pool_add(register_signals, it2.second);
 			for (auto &it2 : cell->connections())
-				connected_signals.add(it2.second);
+				modbits.pool_add(connected_signals, it2.second);
 		}
-	
-	SigMap assign_map(module);
-	std::set<RTLIL::SigSpec> direct_sigs;
-	std::set<RTLIL::Wire*> direct_wires;
+
+	// a wire is "direct" if it is exactly the output of a cell, the
+	// output signals are looked up by their first non-constant bit
+	std::unordered_map<int, std::vector<RTLIL::SigSpec>> direct_sigs;
+	std::vector<bool> direct_bits(modbits.size());
 	for (auto &it : module->cells_) {
 		RTLIL::Cell *cell = it.second;
 		if (ct_all.cell_known(cell->type))
 			for (auto &it2 : cell->connections())
-				if (ct_all.cell_output(cell->type, it2.first))
-					direct_sigs.insert(assign_map(it2.second));
-	}
-	for (auto &it : module->wires_) {
-		if (direct_sigs.count(assign_map(it.second)) || it.second->port_input)
-			direct_wires.insert(it.second);
+				if (ct_all.cell_output(cell->type, it2.first)) {
+					RTLIL::SigSpec sig = it2.second;
+					modbits.apply(sig);
+					int key = -1;
+					for (auto &bit : sig)
+						if (bit.wire != NULL) {
+							key = modbits.id(bit);
+							break;
+						}
+					direct_sigs[key].push_back(sig);
+				}
 	}
-
 	for (auto &it : module->wires_) {
 		RTLIL::Wire *wire = it.second;
-		for (int i = 0; i < wire->width; i++) {
-			RTLIL::SigBit s1 = RTLIL::SigBit(wire, i), s2 = assign_map(s1);
-			if (!compare_signals(s1, s2, register_signals, connected_signals, direct_wires))
-				assign_map.add(s1);
+		bool is_direct = wire->port_input;
+		if (!is_direct && !direct_sigs.empty()) {
+			RTLIL::SigSpec sig = wire;
+			modbits.apply(sig);
+			int key = -1;
+			for (auto &bit : sig)
+				if (bit.wire != NULL) {
+					key = modbits.id(bit);
+					break;
+				}
+			if (direct_sigs.count(key))
+				for (auto &other : direct_sigs.at(key))
+					if (other == sig) {
+						is_direct = true;
+						break;
+					}
 		}
+		if (is_direct)
+			modbits.pool_add(direct_bits, wire);
+	}
+
+	// choose the best name for every signal in a single pass over all wire bits
+	for (int i = 0; i < modbits.size(); i++) {
+		RTLIL::SigBit s1 = modbits.bits[i], s2 = modbits.map(s1);
+		if (!compare_signals(s1, s2, modbits, register_signals, connected_signals, direct_bits))
+			modbits.set_canonical(i);
 	}
 
 	module->connections_.clear();
 
-	SigPool used_signals;
-	SigPool used_signals_nodrivers;
+	std::vector<bool> used_signals(modbits.size());
+	std::vector<bool> used_signals_nodrivers(modbits.size());
 	for (auto &it : module->cells_) {
 		RTLIL::Cell *cell = it.second;
 		for (auto &it2 : cell->connections_) {
-			assign_map.apply(it2.second);
-			used_signals.add(it2.second);
+			modbits.apply(it2.second);
+			modbits.pool_add(used_signals, it2.second);
 			if (!ct.cell_output(cell->type, it2.first))
-				used_signals_nodrivers.add(it2.second);
+				modbits.pool_add(used_signals_nodrivers, it2.second);
 		}
 	}
 	for (auto &it : module->wires_) {
 		RTLIL::Wire *wire = it.second;
 		if (wire->port_id > 0) {
 			RTLIL::SigSpec sig = RTLIL::SigSpec(wire);
-			assign_map.apply(sig);
-			used_signals.add(sig);
+			modbits.apply(sig);
+			modbits.pool_add(used_signals, sig);
 			if (!wire->port_input)
-				used_signals_nodrivers.add(sig);
+				modbits.pool_add(used_signals_nodrivers, sig);
 		}
-		if (wire->get_bool_attribute("\\keep")) {
+		if (wire->get_bool_attribute(id_keep)) {
 			RTLIL::SigSpec sig = RTLIL::SigSpec(wire);
-			assign_map.apply(sig);
-			used_signals.add(sig);
+			modbits.apply(sig);
+			modbits.pool_add(used_signals, sig);
 		}
 	}
 
 	std::vector<RTLIL::Wire*> maybe_del_wires;
 	for (auto wire : module->wires())
 	{
-		if ((!purge_mode && check_public_name(wire->name)) || wire->port_id != 0 || wire->get_bool_attribute("\\keep")) {
-			RTLIL::SigSpec s1 = RTLIL::SigSpec(wire), s2 = s1;
-			assign_map.apply(s2);
-			if (!used_signals.check_any(s2) && wire->port_id == 0 && !wire->get_bool_attribute("\\keep")) {
+		RTLIL::SigSpec s1 = RTLIL::SigSpec(wire), s2 = s1;
+		modbits.apply(s2);
+
+		bool keep_wire = wire->get_bool_attribute(id_keep);
+
+		if ((!purge_mode && check_public_name(wire->name)) || wire->port_id != 0 || keep_wire) {
+			if (!modbits.pool_check_any(used_signals, s2) && wire->port_id == 0 && !keep_wire) {
 				maybe_del_wires.push_back(wire);
 			} else {
 				log_assert(GetSize(s1) == GetSize(s2));
@@ -230,34 +425,33 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 						new_conn.second.append_bit(s2[i]);
 					}
 				if (new_conn.first.size() > 0) {
-					used_signals.add(new_conn.first);
-					used_signals.add(new_conn.second);
+					modbits.pool_add(used_signals, new_conn.first);
+					modbits.pool_add(used_signals, new_conn.second);
 					module->connect(new_conn);
 				}
 			}
 		} else {
-			if (!used_signals.check_any(RTLIL::SigSpec(wire)))
+			if (!modbits.pool_check_any(used_signals, s1))
 				maybe_del_wires.push_back(wire);
 		}
 
-		RTLIL::SigSpec sig = assign_map(RTLIL::SigSpec(wire));
-		if (!used_signals_nodrivers.check_any(sig)) {
+		if (!modbits.pool_check_any(used_signals_nodrivers, s2)) {
 			std::string unused_bits;
-			for (int i = 0; i < GetSize(sig); i++) {
-				if (sig[i].wire == NULL)
+			for (int i = 0; i < GetSize(s2); i++) {
+				if (s2[i].wire == NULL)
 					continue;
-				if (!used_signals_nodrivers.check(sig[i])) {
+				if (!modbits.pool_check(used_signals_nodrivers, s2[i])) {
 					if (!unused_bits.empty())
 						unused_bits += " ";
 					unused_bits += stringf("%d", i);
 				}
 			}
 			if (unused_bits.empty() || wire->port_id != 0)
-				wire->attributes.erase("\\unused_bits");
+				wire->attributes.erase(id_unused_bits);
 			else
-				wire->attributes["\\unused_bits"] = RTLIL::Const(unused_bits);
+				wire->attributes[id_unused_bits] = RTLIL::Const(unused_bits);
 		} else {
-			wire->attributes.erase("\\unused_bits");
+			wire->attributes.erase(id_unused_bits);
 		}
 	}
 
@@ -266,7 +460,7 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 
 	int del_wires_count = 0;
 	for (auto wire : maybe_del_wires)
-		if (!used_signals.check_any(RTLIL::SigSpec(wire))) {
+		if (!modbits.pool_check_any(used_signals, RTLIL::SigSpec(wire))) {
 			if (check_public_name(wire->name) && verbose) {
 				log("  removing unused non-port wire %s.\n", wire->name.c_str());
 				del_wires_count++;
@@ -274,7 +468,8 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 			del_wires.insert(wire);
 		}
 
-	module->remove(del_wires);
+	if (!del_wires.empty())
+		module->remove(del_wires);
 	count_rm_wires += del_wires.size();;
 
 	if (del_wires_count > 0)
@@ -299,8 +494,9 @@ void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose)
 	for (auto cell : delcells)
 		module->remove(cell);
 
-	rmunused_module_cells(module, verbose);
-	rmunused_module_signals(module, purge_mode, verbose);
+	ModuleBits modbits(module);
+	rmunused_module_cells(module, modbits, verbose);
+	rmunused_module_signals(module, modbits, purge_mode, verbose);
 }
 
 struct OptCleanPass : public Pass {
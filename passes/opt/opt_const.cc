@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <algorithm>
+#include <deque>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -73,7 +74,7 @@ void replace_undriven(RTLIL::Design *design, RTLIL::Module *module)
 	}
 }
 
-void replace_cell(SigMap &assign_map, RTLIL::Module *module, RTLIL::Cell *cell, std::string info, std::string out_port, RTLIL::SigSpec out_val)
+void replace_cell(RTLIL::Module *module, RTLIL::Cell *cell, std::string info, std::string out_port, RTLIL::SigSpec out_val)
 {
 	RTLIL::SigSpec Y = cell->getPort(out_port);
 	out_val.extend_u0(Y.size(), false);
@@ -82,13 +83,12 @@ void replace_cell(SigMap &assign_map, RTLIL::Module *module, RTLIL::Cell *cell,
 			cell->type.c_str(), cell->name.c_str(), info.c_str(),
 			module->name.c_str(), log_signal(Y), log_signal(out_val));
 	// log_cell(cell);
-	assign_map.add(Y, out_val);
 	module->connect(Y, out_val);
 	module->remove(cell);
 	did_something = true;
 }
 
-bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutative, SigMap &sigmap)
+bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutative, SigMap &sigmap, std::vector<RTLIL::Cell*> &new_cells)
 {
 	std::string b_name = cell->hasPort("\\B") ? "\\B" : "\\A";
 
@@ -156,6 +156,7 @@ bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutativ
 		}
 
 		RTLIL::Cell *c = module->addCell(NEW_ID, cell->type);
+		new_cells.push_back(c);
 
 		c->setPort("\\A", new_a);
 		c->parameters["\\A_WIDTH"] = new_a.size();
@@ -186,6 +187,98 @@ bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutativ
 	return true;
 }
 
+struct ConstWorklist
+{
+	RTLIL::Module *module;
+	SigMap &assign_map;
+	CellTypes &ct;
+	std::map<RTLIL::SigSpec, RTLIL::SigSpec> &invert_map;
+
+	std::deque<RTLIL::IdString> queue;
+	std::set<RTLIL::IdString> queued;
+	std::map<RTLIL::SigBit, std::set<RTLIL::IdString>> consumers;
+	std::set<RTLIL::SigSpec> reverse_inverters;
+
+	ConstWorklist(RTLIL::Module *module, SigMap &assign_map, CellTypes &ct, std::map<RTLIL::SigSpec, RTLIL::SigSpec> &invert_map) :
+			module(module), assign_map(assign_map), ct(ct), invert_map(invert_map) { }
+
+	void push(RTLIL::IdString name)
+	{
+		if (queued.insert(name).second)
+			queue.push_back(name);
+	}
+
+	RTLIL::Cell *pop()
+	{
+		RTLIL::IdString name = queue.front();
+		queue.pop_front();
+		queued.erase(name);
+		return module->cell(name);
+	}
+
+	void add_consumer(RTLIL::Cell *cell)
+	{
+		for (auto &conn : cell->connections())
+			if (!ct.cell_known(cell->type) || ct.cell_input(cell->type, conn.first))
+				for (auto &bit : assign_map(conn.second))
+					if (bit.wire != NULL)
+						consumers[bit].insert(cell->name);
+	}
+
+	void push_consumers(RTLIL::SigBit bit)
+	{
+		if (bit.wire != NULL && consumers.count(bit))
+			for (auto &name : consumers.at(bit))
+				push(name);
+	}
+
+	void merge_consumers(RTLIL::SigBit from, RTLIL::SigBit to)
+	{
+		if (from != to && from.wire != NULL && to.wire != NULL && consumers.count(from))
+			consumers[to].insert(consumers.at(from).begin(), consumers.at(from).end());
+	}
+
+	// after a double inverter was removed an inverter pair can be recorded in both
+	// directions. the double inverter rule may use both, but the mux select rule
+	// must not follow the reverse entry or it would swap A and B forever.
+	void merge_inverter(RTLIL::SigBit from, RTLIL::SigBit to)
+	{
+		if (from == to || to.wire == NULL || !invert_map.count(from) || invert_map.count(to))
+			return;
+		RTLIL::SigSpec inv = invert_map.at(from);
+		if (invert_map.count(inv) && invert_map.at(inv) == to)
+			reverse_inverters.insert(to);
+		invert_map[to] = inv;
+	}
+
+	// add new module connections to assign_map and keep the consumers of merged
+	// signals and the inverter outputs attached to the new representative bit
+	void add_connections(size_t first_conn)
+	{
+		for (size_t i = first_conn; i < module->connections().size(); i++)
+		{
+			std::vector<RTLIL::SigBit> lhs = module->connections()[i].first;
+			std::vector<RTLIL::SigBit> rhs = module->connections()[i].second;
+
+			for (int j = 0; j < GetSize(lhs); j++)
+			{
+				RTLIL::SigBit old_lhs = assign_map(lhs[j]), old_rhs = assign_map(rhs[j]);
+				if (old_lhs == old_rhs)
+					continue;
+
+				push_consumers(old_lhs);
+				assign_map.add(lhs[j], rhs[j]);
+				RTLIL::SigBit new_bit = assign_map(lhs[j]);
+
+				merge_consumers(old_lhs, new_bit);
+				merge_consumers(old_rhs, new_bit);
+				merge_inverter(old_lhs, new_bit);
+				merge_inverter(old_rhs, new_bit);
+			}
+		}
+	}
+};
+
 void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool consume_x, bool mux_undef, bool mux_bool, bool do_fine, bool keepdc)
 {
 	if (!design->selected(module))
@@ -227,16 +320,36 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 
 	cells.sort();
 
-	for (auto cell : cells.sorted)
+	// Visit all cells in topological order once, and after that only revisit cells
+	// that have been changed or whose inputs have been changed. This reaches the
+	// fixed point in one call with work proportional to the number of changes.
+	ConstWorklist worklist(module, assign_map, ct_combinational, invert_map);
+
+	for (auto cell : cells.sorted) {
+		worklist.add_consumer(cell);
+		worklist.push(cell->name);
+	}
+
+	while (!worklist.queue.empty())
 	{
-#define ACTION_DO(_p_, _s_) do { cover("opt.opt_const.action_" S__LINE__); replace_cell(assign_map, module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
+		RTLIL::Cell *cell = worklist.pop();
+		if (cell == NULL)
+			continue;
+
+		RTLIL::IdString cell_name = cell->name;
+		size_t num_connections = module->connections().size();
+		std::vector<RTLIL::Cell*> new_cells;
+		bool prev_did_something = did_something;
+		did_something = false;
+
+#define ACTION_DO(_p_, _s_) do { cover("opt.opt_const.action_" S__LINE__); replace_cell(module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
 #define ACTION_DO_Y(_v_) ACTION_DO("\\Y", RTLIL::SigSpec(RTLIL::State::S ## _v_))
 
 		if (do_fine)
 		{
 			if (cell->type == "$not" || cell->type == "$pos" ||
 					cell->type == "$and" || cell->type == "$or" || cell->type == "$xor" || cell->type == "$xnor")
-				if (group_cell_inputs(module, cell, true, assign_map))
+				if (group_cell_inputs(module, cell, true, assign_map, new_cells))
 					goto next_cell;
 
 			if (cell->type == "$reduce_and")
@@ -320,13 +433,13 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 
 		if (cell->type == "$logic_or" && (assign_map(cell->getPort("\\A")) == RTLIL::State::S1 || assign_map(cell->getPort("\\B")) == RTLIL::State::S1)) {
 			cover("opt.opt_const.one_high");
-			replace_cell(assign_map, module, cell, "one high", "\\Y", RTLIL::State::S1);
+			replace_cell(module, cell, "one high", "\\Y", RTLIL::State::S1);
 			goto next_cell;
 		}
 
 		if (cell->type == "$logic_and" && (assign_map(cell->getPort("\\A")) == RTLIL::State::S0 || assign_map(cell->getPort("\\B")) == RTLIL::State::S0)) {
 			cover("opt.opt_const.one_low");
-			replace_cell(assign_map, module, cell, "one low", "\\Y", RTLIL::State::S0);
+			replace_cell(module, cell, "one low", "\\Y", RTLIL::State::S0);
 			goto next_cell;
 		}
 
@@ -356,9 +469,9 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 						"$lt", "$le", "$ge", "$gt", "$neg", "$add", "$sub", "$mul", "$div", "$mod", "$pow", cell->type.str());
 				if (cell->type == "$reduce_xor" || cell->type == "$reduce_xnor" ||
 						cell->type == "$lt" || cell->type == "$le" || cell->type == "$ge" || cell->type == "$gt")
-					replace_cell(assign_map, module, cell, "x-bit in input", "\\Y", RTLIL::State::Sx);
+					replace_cell(module, cell, "x-bit in input", "\\Y", RTLIL::State::Sx);
 				else
-					replace_cell(assign_map, module, cell, "x-bit in input", "\\Y", RTLIL::SigSpec(RTLIL::State::Sx, cell->getPort("\\Y").size()));
+					replace_cell(module, cell, "x-bit in input", "\\Y", RTLIL::SigSpec(RTLIL::State::Sx, cell->getPort("\\Y").size()));
 				goto next_cell;
 			}
 		}
@@ -366,11 +479,12 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 		if ((cell->type == "$_NOT_" || cell->type == "$not" || cell->type == "$logic_not") && cell->getPort("\\Y").size() == 1 &&
 				invert_map.count(assign_map(cell->getPort("\\A"))) != 0) {
 			cover_list("opt.opt_const.invert.double", "$_NOT_", "$not", "$logic_not", cell->type.str());
-			replace_cell(assign_map, module, cell, "double_invert", "\\Y", invert_map.at(assign_map(cell->getPort("\\A"))));
+			replace_cell(module, cell, "double_invert", "\\Y", invert_map.at(assign_map(cell->getPort("\\A"))));
 			goto next_cell;
 		}
 
-		if ((cell->type == "$_MUX_" || cell->type == "$mux") && invert_map.count(assign_map(cell->getPort("\\S"))) != 0) {
+		if ((cell->type == "$_MUX_" || cell->type == "$mux") && invert_map.count(assign_map(cell->getPort("\\S"))) != 0 &&
+				worklist.reverse_inverters.count(assign_map(cell->getPort("\\S"))) == 0) {
 			cover_list("opt.opt_const.invert.muxsel", "$_MUX_", "$mux", cell->type.str());
 			log("Optimizing away select inverter for %s cell `%s' in module `%s'.\n", log_id(cell->type), log_id(cell), log_id(module));
 			RTLIL::SigSpec tmp = cell->getPort("\\A");
@@ -455,7 +569,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			if (input.match("01 ")) ACTION_DO("\\Y", input.extract(0, 1));
 			if (input.match("10 ")) {
 				cover("opt.opt_const.mux_to_inv");
-				cell->type = "$_NOT_";
+				cell->setType("$_NOT_");
 				cell->setPort("\\A", input.extract(0, 1));
 				cell->unsetPort("\\B");
 				cell->unsetPort("\\S");
@@ -492,7 +606,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 					cover_list("opt.opt_const.eqneq.isneq", "$eq", "$ne", "$eqx", "$nex", cell->type.str());
 					RTLIL::SigSpec new_y = RTLIL::SigSpec((cell->type == "$eq" || cell->type == "$eqx") ?  RTLIL::State::S0 : RTLIL::State::S1);
 					new_y.extend(cell->parameters["\\Y_WIDTH"].as_int(), false);
-					replace_cell(assign_map, module, cell, "isneq", "\\Y", new_y);
+					replace_cell(module, cell, "isneq", "\\Y", new_y);
 					goto next_cell;
 				}
 				if (a[i] == b[i])
@@ -505,7 +619,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				cover_list("opt.opt_const.eqneq.empty", "$eq", "$ne", "$eqx", "$nex", cell->type.str());
 				RTLIL::SigSpec new_y = RTLIL::SigSpec((cell->type == "$eq" || cell->type == "$eqx") ?  RTLIL::State::S1 : RTLIL::State::S0);
 				new_y.extend(cell->parameters["\\Y_WIDTH"].as_int(), false);
-				replace_cell(assign_map, module, cell, "empty", "\\Y", new_y);
+				replace_cell(module, cell, "empty", "\\Y", new_y);
 				goto next_cell;
 			}
 
@@ -538,7 +652,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				} else {
 					cover_list("opt.opt_const.eqneq.isnot", "$eq", "$ne", cell->type.str());
 					log("Replacing %s cell `%s' in module `%s' with inverter.\n", log_id(cell->type), log_id(cell), log_id(module));
-					cell->type = "$not";
+					cell->setType("$not");
 					cell->parameters.erase("\\B_WIDTH");
 					cell->parameters.erase("\\B_SIGNED");
 					cell->unsetPort("\\B");
@@ -643,7 +757,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 					cell->parameters.at("\\A_SIGNED") = cell->parameters.at("\\B_SIGNED");
 				}
 
-				cell->type = "$pos";
+				cell->setType("$pos");
 				cell->unsetPort("\\B");
 				cell->parameters.erase("\\B_WIDTH");
 				cell->parameters.erase("\\B_SIGNED");
@@ -657,7 +771,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 		if (mux_bool && (cell->type == "$mux" || cell->type == "$_MUX_") &&
 				cell->getPort("\\A") == RTLIL::SigSpec(0, 1) && cell->getPort("\\B") == RTLIL::SigSpec(1, 1)) {
 			cover_list("opt.opt_const.mux_bool", "$mux", "$_MUX_", cell->type.str());
-			replace_cell(assign_map, module, cell, "mux_bool", "\\Y", cell->getPort("\\S"));
+			replace_cell(module, cell, "mux_bool", "\\Y", cell->getPort("\\S"));
 			goto next_cell;
 		}
 
@@ -673,9 +787,9 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				cell->parameters["\\Y_WIDTH"] = cell->parameters["\\WIDTH"];
 				cell->parameters["\\A_SIGNED"] = 0;
 				cell->parameters.erase("\\WIDTH");
-				cell->type = "$not";
+				cell->setType("$not");
 			} else
-				cell->type = "$_NOT_";
+				cell->setType("$_NOT_");
 			did_something = true;
 			goto next_cell;
 		}
@@ -692,9 +806,9 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				cell->parameters["\\A_SIGNED"] = 0;
 				cell->parameters["\\B_SIGNED"] = 0;
 				cell->parameters.erase("\\WIDTH");
-				cell->type = "$and";
+				cell->setType("$and");
 			} else
-				cell->type = "$_AND_";
+				cell->setType("$_AND_");
 			did_something = true;
 			goto next_cell;
 		}
@@ -711,9 +825,9 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				cell->parameters["\\A_SIGNED"] = 0;
 				cell->parameters["\\B_SIGNED"] = 0;
 				cell->parameters.erase("\\WIDTH");
-				cell->type = "$or";
+				cell->setType("$or");
 			} else
-				cell->type = "$_OR_";
+				cell->setType("$_OR_");
 			did_something = true;
 			goto next_cell;
 		}
@@ -724,7 +838,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			if ((cell->getPort("\\A").is_fully_undef() && cell->getPort("\\B").is_fully_undef()) ||
 					cell->getPort("\\S").is_fully_undef()) {
 				cover_list("opt.opt_const.mux_undef", "$mux", "$pmux", cell->type.str());
-				replace_cell(assign_map, module, cell, "mux_undef", "\\Y", cell->getPort("\\A"));
+				replace_cell(module, cell, "mux_undef", "\\Y", cell->getPort("\\A"));
 				goto next_cell;
 			}
 			for (int i = 0; i < cell->getPort("\\S").size(); i++) {
@@ -743,12 +857,12 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			}
 			if (new_s.size() == 0) {
 				cover_list("opt.opt_const.mux_empty", "$mux", "$pmux", cell->type.str());
-				replace_cell(assign_map, module, cell, "mux_empty", "\\Y", new_a);
+				replace_cell(module, cell, "mux_empty", "\\Y", new_a);
 				goto next_cell;
 			}
 			if (new_a == RTLIL::SigSpec(RTLIL::State::S0) && new_b == RTLIL::SigSpec(RTLIL::State::S1)) {
 				cover_list("opt.opt_const.mux_sel01", "$mux", "$pmux", cell->type.str());
-				replace_cell(assign_map, module, cell, "mux_sel01", "\\Y", new_s);
+				replace_cell(module, cell, "mux_sel01", "\\Y", new_s);
 				goto next_cell;
 			}
 			if (cell->getPort("\\S").size() != new_s.size()) {
@@ -759,10 +873,10 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				cell->setPort("\\B", new_b);
 				cell->setPort("\\S", new_s);
 				if (new_s.size() > 1) {
-					cell->type = "$pmux";
+					cell->setType("$pmux");
 					cell->parameters["\\S_WIDTH"] = new_s.size();
 				} else {
-					cell->type = "$mux";
+					cell->setType("$mux");
 					cell->parameters.erase("\\S_WIDTH");
 				}
 				did_something = true;
@@ -779,7 +893,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 						cell->parameters["\\A_SIGNED"].as_bool(), false, \
 						cell->parameters["\\Y_WIDTH"].as_int())); \
 				cover("opt.opt_const.const.$" #_t); \
-				replace_cell(assign_map, module, cell, stringf("%s", log_signal(a)), "\\Y", y); \
+				replace_cell(module, cell, stringf("%s", log_signal(a)), "\\Y", y); \
 				goto next_cell; \
 			} \
 		}
@@ -794,7 +908,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 						cell->parameters["\\B_SIGNED"].as_bool(), \
 						cell->parameters["\\Y_WIDTH"].as_int())); \
 				cover("opt.opt_const.const.$" #_t); \
-				replace_cell(assign_map, module, cell, stringf("%s, %s", log_signal(a), log_signal(b)), "\\Y", y); \
+				replace_cell(module, cell, stringf("%s, %s", log_signal(a), log_signal(b)), "\\Y", y); \
 				goto next_cell; \
 			} \
 		}
@@ -903,7 +1017,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 						while (GetSize(new_b) > 1 && new_b.back() == RTLIL::State::S0)
 							new_b.pop_back();
 
-						cell->type = "$shl";
+						cell->setType("$shl");
 						cell->parameters["\\B_WIDTH"] = GetSize(new_b);
 						cell->parameters["\\B_SIGNED"] = false;
 						cell->setPort("\\B", new_b);
@@ -915,7 +1029,32 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			}
 		}
 
-	next_cell:;
+	next_cell:
+		if (did_something)
+		{
+			worklist.add_connections(num_connections);
+
+			cell = module->cell(cell_name);
+			if (cell != NULL)
+				new_cells.push_back(cell);
+
+			for (auto c : new_cells)
+			{
+				if (!design->selected(module, c))
+					continue;
+				if ((c->type == "$_NOT_" || c->type == "$not" || c->type == "$logic_not") &&
+						c->getPort("\\A").size() == 1 && c->getPort("\\Y").size() == 1)
+					invert_map[assign_map(c->getPort("\\Y"))] = assign_map(c->getPort("\\A"));
+				for (auto &conn : c->connections())
+					if (!ct_combinational.cell_known(c->type) || ct_combinational.cell_output(c->type, conn.first))
+						for (auto &bit : assign_map(conn.second))
+							worklist.push_consumers(bit);
+				worklist.add_consumer(c);
+				worklist.push(c->name);
+			}
+		}
+		did_something = did_something || prev_did_something;
+
 #undef ACTION_DO
 #undef ACTION_DO_Y
 #undef FOLD_1ARG_CELL
@@ -1004,15 +1143,11 @@ struct OptConstPass : public Pass {
 			if (undriven)
 				replace_undriven(design, module);
 
-			do {
-				do {
-					did_something = false;
-					replace_const_cells(design, module, false, mux_undef, mux_bool, do_fine, keepdc);
-					if (did_something)
-						design->scratchpad_set_bool("opt.did_something", true);
-				} while (did_something);
-				replace_const_cells(design, module, true, mux_undef, mux_bool, do_fine, keepdc);
-			} while (did_something);
+			did_something = false;
+			replace_const_cells(design, module, false, mux_undef, mux_bool, do_fine, keepdc);
+			replace_const_cells(design, module, true, mux_undef, mux_bool, do_fine, keepdc);
+			if (did_something)
+				design->scratchpad_set_bool("opt.did_something", true);
 		}
 
 		log_pop();
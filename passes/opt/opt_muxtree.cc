@@ -47,7 +47,7 @@ struct OptMuxtreeWorker
 		int num;
 		bitDef_t bit;
 		bool seen_non_mux;
-		std::vector<int> mux_users;
+		int num_ctrl_muxes;
 		std::vector<int> mux_drivers;
 	};
 
@@ -55,20 +55,32 @@ struct OptMuxtreeWorker
 	std::vector<bitinfo_t> bit2info;
 
 	struct portinfo_t {
-		std::vector<int> ctrl_sigs;
+		// control signals are single bits, -1 means the control signal is constant
+		int ctrl_sig;
 		std::vector<int> input_sigs;
 		std::vector<int> input_muxes;
 		bool const_activated;
+		bool shared_ctrl;
 		bool enabled;
 	};
 
 	struct muxinfo_t {
 		RTLIL::Cell *cell;
 		std::vector<portinfo_t> ports;
+		// ports (not including the default port) with a control signal that is
+		// also used by another mux. only for those the known_active and
+		// known_inactive status can ever be set when evaluating this mux.
+		std::vector<int> shared_ports;
+		int const_port;
+		bool saturated;
 	};
 
 	std::vector<muxinfo_t> mux2info;
 
+	// (mux, knowledge) pairs that already have been evaluated for the
+	// current root mux, cleared by eval_root_mux()
+	std::set<std::vector<int>> eval_cache;
+
 	OptMuxtreeWorker(RTLIL::Design *design, RTLIL::Module *module) :
 			design(design), module(module), assign_map(module), removed_count(0)
 	{
@@ -78,10 +90,10 @@ struct OptMuxtreeWorker
 
 		// Populate bit2info[]:
 		//	.seen_non_mux
-		//	.mux_users
+		//	.num_ctrl_muxes
 		//	.mux_drivers
 		// Populate mux2info[].ports[]:
-		//	.ctrl_sigs
+		//	.ctrl_sig
 		//	.input_sigs
 		//	.const_activated
 		for (auto cell : module->cells())
@@ -95,35 +107,43 @@ struct OptMuxtreeWorker
 
 				muxinfo_t muxinfo;
 				muxinfo.cell = cell;
+				muxinfo.const_port = -1;
+				muxinfo.saturated = false;
 
+				std::set<int> ctrl_bits;
 				for (int i = 0; i < sig_s.size(); i++) {
 					RTLIL::SigSpec sig = sig_b.extract(i*sig_a.size(), sig_a.size());
 					RTLIL::SigSpec ctrl_sig = assign_map(sig_s.extract(i, 1));
 					portinfo_t portinfo;
-					for (int idx : sig2bits(sig)) {
-						add_to_list(bit2info[idx].mux_users, mux2info.size());
-						add_to_list(portinfo.input_sigs, idx);
-					}
-					for (int idx : sig2bits(ctrl_sig))
-						add_to_list(portinfo.ctrl_sigs, idx);
+					portinfo.input_sigs = sig2bits(sig, true);
+					portinfo.ctrl_sig = -1;
+					for (int idx : sig2bits(ctrl_sig, false))
+						portinfo.ctrl_sig = idx;
+					if (portinfo.ctrl_sig >= 0)
+						ctrl_bits.insert(portinfo.ctrl_sig);
 					portinfo.const_activated = ctrl_sig.is_fully_const() && ctrl_sig.as_bool();
+					portinfo.shared_ctrl = false;
 					portinfo.enabled = false;
+					if (portinfo.const_activated && muxinfo.const_port < 0)
+						muxinfo.const_port = i;
 					muxinfo.ports.push_back(portinfo);
 				}
 
 				portinfo_t portinfo;
-				for (int idx : sig2bits(sig_a)) {
-					add_to_list(bit2info[idx].mux_users, mux2info.size());
-					add_to_list(portinfo.input_sigs, idx);
-				}
+				portinfo.input_sigs = sig2bits(sig_a, true);
+				portinfo.ctrl_sig = -1;
 				portinfo.const_activated = false;
+				portinfo.shared_ctrl = false;
 				portinfo.enabled = false;
 				muxinfo.ports.push_back(portinfo);
 
-				for (int idx : sig2bits(sig_y))
+				for (int idx : ctrl_bits)
+					bit2info[idx].num_ctrl_muxes++;
+
+				for (int idx : sig2bits(sig_y, false))
 					add_to_list(bit2info[idx].mux_drivers, mux2info.size());
 
-				for (int idx : sig2bits(sig_s))
+				for (int idx : sig2bits(sig_s, false))
 					bit2info[idx].seen_non_mux = true;
 
 				mux2info.push_back(muxinfo);
@@ -131,14 +151,14 @@ struct OptMuxtreeWorker
 			else
 			{
 				for (auto &it : cell->connections()) {
-					for (int idx : sig2bits(it.second))
+					for (int idx : sig2bits(it.second, false))
 						bit2info[idx].seen_non_mux = true;
 				}
 			}
 		}
 		for (auto wire : module->wires()) {
 			if (wire->port_output)
-				for (int idx : sig2bits(RTLIL::SigSpec(wire)))
+				for (int idx : sig2bits(RTLIL::SigSpec(wire), false))
 					bit2info[idx].seen_non_mux = true;
 		}
 
@@ -147,18 +167,32 @@ struct OptMuxtreeWorker
 			return;
 		}
 
-		// Populate mux2info[].ports[]:
-		//	.input_muxes
-		for (size_t i = 0; i < bit2info.size(); i++)
-		for (int j : bit2info[i].mux_users)
-		for (auto &p : mux2info[j].ports) {
-			if (is_in_list(p.input_sigs, i))
-				for (int k : bit2info[i].mux_drivers)
-					add_to_list(p.input_muxes, k);
+		// Populate mux2info[]:
+		//	.ports[].input_muxes
+		//	.ports[].shared_ctrl
+		//	.shared_ports
+		std::vector<int> last_seen_port(mux2info.size(), -1);
+		int port_counter = 0;
+		for (auto &mi : mux2info)
+		for (int port_idx = 0; port_idx < GetSize(mi.ports); port_idx++, port_counter++) {
+			portinfo_t &pi = mi.ports[port_idx];
+			for (int i : pi.input_sigs)
+			for (int k : bit2info[i].mux_drivers)
+				if (last_seen_port[k] != port_counter) {
+					last_seen_port[k] = port_counter;
+					pi.input_muxes.push_back(k);
+				}
+			if (pi.ctrl_sig >= 0 && bit2info[pi.ctrl_sig].num_ctrl_muxes > 1) {
+				pi.shared_ctrl = true;
+				mi.shared_ports.push_back(port_idx);
+			}
 		}
 
 		log("  Evaluating internal representation of mux trees.\n");
 
+		root_knowledge.known_inactive.resize(bit2info.size());
+		root_knowledge.known_active.resize(bit2info.size());
+
 		std::set<int> root_muxes;
 		for (auto &bi : bit2info) {
 			if (!bi.seen_non_mux)
@@ -225,7 +259,7 @@ struct OptMuxtreeWorker
 				mi.cell->setPort("\\B", new_sig_b);
 				mi.cell->setPort("\\S", new_sig_s);
 				if (new_sig_s.size() == 1) {
-					mi.cell->type = "$mux";
+					mi.cell->setType("$mux");
 					mi.cell->parameters.erase("\\S_WIDTH");
 				} else {
 					mi.cell->parameters["\\S_WIDTH"] = RTLIL::Const(new_sig_s.size());
@@ -234,14 +268,6 @@ struct OptMuxtreeWorker
 		}
 	}
 
-	bool list_is_subset(const std::vector<int> &sub, const std::vector<int> &super)
-	{
-		for (int v : sub)
-			if (!is_in_list(super, v))
-				return false;
-		return true;
-	}
-
 	bool is_in_list(const std::vector<int> &list, int value)
 	{
 		for (int v : list)
@@ -256,9 +282,10 @@ struct OptMuxtreeWorker
 			list.push_back(value);
 	}
 
-	std::vector<int> sig2bits(RTLIL::SigSpec sig)
+	std::vector<int> sig2bits(RTLIL::SigSpec sig, bool skip_duplicates)
 	{
 		std::vector<int> results;
+		std::set<int> seen;
 		assign_map.apply(sig);
 		for (auto &bit : sig)
 			if (bit.wire != NULL) {
@@ -267,49 +294,63 @@ struct OptMuxtreeWorker
 					info.num = bit2info.size();
 					info.bit = bit;
 					info.seen_non_mux = false;
+					info.num_ctrl_muxes = 0;
 					bit2info.push_back(info);
 					bit2num[info.bit] = info.num;
 				}
-				results.push_back(bit2num[bit]);
+				int idx = bit2num[bit];
+				if (!skip_duplicates || seen.insert(idx).second)
+					results.push_back(idx);
 			}
 		return results;
 	}
 
 	struct knowledge_t
 	{
-		// database of known inactive signals
-		// the 2nd integer is a reference counter used to manage the
-		// list. when it is non-zero the signal in known to be inactive
-		std::map<int, int> known_inactive;
+		// reference counters for known inactive and known active control
+		// signals, indexed by bit number. when a counter is non-zero the signal
+		// is known to be inactive (active). only control signals that are
+		// shared between muxes are tracked, because all other control signals
+		// are only ever looked at by the mux they belong to.
+		std::vector<int> known_inactive;
+		std::vector<int> known_active;
 
-		// database of known active signals
-		// the 2nd dimension is the list of or-ed signals. so we know that
-		// for each i there is a j so that known_active[i][j] points to an
-		// inactive control signal.
-		std::vector<std::vector<int>> known_active;
+		// the bits with non-zero counters, used as key for eval_cache
+		std::set<int> inactive_bits, active_bits;
 
 		// this is just used to keep track of visited muxes in order to prohibit
 		// endless recursion in mux loops
 		std::set<int> visited_muxes;
 	};
 
+	// shared by all calls to eval_root_mux(). the counters are back to zero
+	// after each root mux, so the vectors are only allocated once.
+	knowledge_t root_knowledge;
+
+	void update_knowledge(std::vector<int> &counters, std::set<int> &bits, int bit, int delta)
+	{
+		if (counters[bit] == 0)
+			bits.insert(bit);
+		counters[bit] += delta;
+		if (counters[bit] == 0)
+			bits.erase(bit);
+	}
+
 	void eval_mux_port(knowledge_t &knowledge, int mux_idx, int port_idx)
 	{
 		muxinfo_t &muxinfo = mux2info[mux_idx];
-		muxinfo.ports[port_idx].enabled = true;
+		portinfo_t &portinfo = muxinfo.ports[port_idx];
+		portinfo.enabled = true;
 
-		for (size_t i = 0; i < muxinfo.ports.size(); i++) {
-			if (int(i) == port_idx)
-				continue;
-			for (int b : muxinfo.ports[i].ctrl_sigs)
-				knowledge.known_inactive[b]++;
-		}
+		for (int i : muxinfo.shared_ports)
+			if (i != port_idx)
+				update_knowledge(knowledge.known_inactive, knowledge.inactive_bits, muxinfo.ports[i].ctrl_sig, +1);
 
-		if (port_idx < int(muxinfo.ports.size())-1 && !muxinfo.ports[port_idx].const_activated)
-			knowledge.known_active.push_back(muxinfo.ports[port_idx].ctrl_sigs);
+		if (portinfo.shared_ctrl)
+			update_knowledge(knowledge.known_active, knowledge.active_bits, portinfo.ctrl_sig, +1);
 
 		std::vector<int> parent_muxes;
-		for (int m : muxinfo.ports[port_idx].input_muxes) {
+		for (int m : portinfo.input_muxes) {
 			if (knowledge.visited_muxes.count(m) > 0)
 				continue;
 			knowledge.visited_muxes.insert(m);
@@ -320,84 +361,88 @@ struct OptMuxtreeWorker
 		for (int m : parent_muxes)
 			knowledge.visited_muxes.erase(m);
 
-		if (port_idx < int(muxinfo.ports.size())-1 && !muxinfo.ports[port_idx].const_activated)
-			knowledge.known_active.pop_back();
+		if (portinfo.shared_ctrl)
+			update_knowledge(knowledge.known_active, knowledge.active_bits, portinfo.ctrl_sig, -1);
 
-		for (size_t i = 0; i < muxinfo.ports.size(); i++) {
-			if (int(i) == port_idx)
-				continue;
-			for (int b : muxinfo.ports[i].ctrl_sigs)
-				knowledge.known_inactive[b]--;
-		}
+		for (int i : muxinfo.shared_ports)
+			if (i != port_idx)
+				update_knowledge(knowledge.known_inactive, knowledge.inactive_bits, muxinfo.ports[i].ctrl_sig, -1);
 	}
 
-	void eval_mux(knowledge_t &knowledge, int mux_idx)
+	void eval_mux_ports(knowledge_t &knowledge, int mux_idx)
 	{
 		muxinfo_t &muxinfo = mux2info[mux_idx];
 
 		// if there is a constant activated port we just use it
-		for (size_t port_idx = 0; port_idx < muxinfo.ports.size()-1; port_idx++)
-		{
-			portinfo_t &portinfo = muxinfo.ports[port_idx];
-			if (portinfo.const_activated) {
-				eval_mux_port(knowledge, mux_idx, port_idx);
-				return;
-			}
+		if (muxinfo.const_port >= 0) {
+			eval_mux_port(knowledge, mux_idx, muxinfo.const_port);
+			return;
 		}
 
 		// compare ports with known_active signals. if we find a match, only this
-		// port can be active. do not include the last port (its the default port
-		// that has no control signals).
-		for (size_t port_idx = 0; port_idx < muxinfo.ports.size()-1; port_idx++)
-		{
-			portinfo_t &portinfo = muxinfo.ports[port_idx];
-			for (size_t i = 0; i < knowledge.known_active.size(); i++) {
-				if (list_is_subset(knowledge.known_active[i], portinfo.ctrl_sigs)) {
-					eval_mux_port(knowledge, mux_idx, port_idx);
-					return;
-				}
+		// port can be active. the default port has no control signals.
+		for (int port_idx : muxinfo.shared_ports)
+			if (knowledge.known_active[muxinfo.ports[port_idx].ctrl_sig] > 0) {
+				eval_mux_port(knowledge, mux_idx, port_idx);
+				return;
 			}
-		}
 
-		// compare ports with known_inactive and known_active signals. If all control
-		// signals of the port are know_inactive or if the control signals of all other
-		// ports are known_active this port can't be activated. this loop includes the
-		// default port but no known_inactive match is performed on the default port.
-		for (size_t port_idx = 0; port_idx < muxinfo.ports.size(); port_idx++)
+		// no control signal of this mux is known to be active at this point.
+		// so all ports are possible, except the ones that have a constant or
+		// known_inactive control signal. this loop includes the default port.
+		for (int port_idx = 0; port_idx < GetSize(muxinfo.ports); port_idx++)
 		{
 			portinfo_t &portinfo = muxinfo.ports[port_idx];
 
-			if (port_idx < muxinfo.ports.size()-1) {
-				bool found_non_known_inactive = false;
-				for (int i : portinfo.ctrl_sigs)
-					if (knowledge.known_inactive[i] == 0)
-						found_non_known_inactive = true;
-				if (!found_non_known_inactive)
+			if (port_idx < GetSize(muxinfo.ports)-1) {
+				if (portinfo.ctrl_sig < 0)
 					continue;
-			}
-
-			bool port_active = true;
-			std::vector<int> other_ctrl_sig;
-			for (size_t i = 0; i < muxinfo.ports.size()-1; i++) {
-				if (i == port_idx)
+				if (portinfo.shared_ctrl && knowledge.known_inactive[portinfo.ctrl_sig] > 0)
 					continue;
-				other_ctrl_sig.insert(other_ctrl_sig.end(),
-						muxinfo.ports[i].ctrl_sigs.begin(), muxinfo.ports[i].ctrl_sigs.end());
-			}
-			for (size_t i = 0; i < knowledge.known_active.size(); i++) {
-				if (list_is_subset(knowledge.known_active[i], other_ctrl_sig))
-					port_active = false;
 			}
-			if (port_active)
-				eval_mux_port(knowledge, mux_idx, port_idx);
+
+			eval_mux_port(knowledge, mux_idx, port_idx);
+		}
+	}
+
+	void eval_mux(knowledge_t &knowledge, int mux_idx)
+	{
+		muxinfo_t &muxinfo = mux2info[mux_idx];
+
+		// nothing left to enable in this tree
+		if (muxinfo.saturated)
+			return;
+
+		// evaluating the same mux with the same knowledge again would not
+		// enable any new ports. visited_muxes is not part of the key, it only
+		// differs between two paths to this mux if the mux tree has a loop.
+		std::vector<int> key;
+		key.push_back(mux_idx);
+		key.insert(key.end(), knowledge.inactive_bits.begin(), knowledge.inactive_bits.end());
+		key.push_back(-1);
+		key.insert(key.end(), knowledge.active_bits.begin(), knowledge.active_bits.end());
+		if (!eval_cache.insert(key).second)
+			return;
+
+		eval_mux_ports(knowledge, mux_idx);
+
+		for (auto &portinfo : muxinfo.ports) {
+			if (!portinfo.enabled)
+				return;
+			for (int m : portinfo.input_muxes)
+				if (!mux2info[m].saturated)
+					return;
 		}
+		muxinfo.saturated = true;
 	}
 
 	void eval_root_mux(int mux_idx)
 	{
-		knowledge_t knowledge;
-		knowledge.visited_muxes.insert(mux_idx);
-		eval_mux(knowledge, mux_idx);
+		root_knowledge.visited_muxes.insert(mux_idx);
+		eval_mux(root_knowledge, mux_idx);
+		root_knowledge.visited_muxes.erase(mux_idx);
+		log_assert(root_knowledge.inactive_bits.empty() && root_knowledge.active_bits.empty());
+		eval_cache.clear();
 	}
 };
 
@@ -158,7 +158,7 @@ struct OptReduceWorker
 			if (new_sig_s.size() > 1) {
 				cell->parameters["\\S_WIDTH"] = RTLIL::Const(new_sig_s.size());
 			} else {
-				cell->type = "$mux";
+				cell->setType("$mux");
 				cell->parameters.erase("\\S_WIDTH");
 			}
 		}
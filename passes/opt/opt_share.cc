@@ -21,12 +21,10 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
-#include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <set>
-
-#define USE_CELL_HASH_CACHE
+#include <unordered_map>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -40,96 +38,85 @@ struct OptShareWorker
 
 	CellTypes ct;
 	int total_count;
-#ifdef USE_CELL_HASH_CACHE
-	std::map<const RTLIL::Cell*, std::string> cell_hash_cache;
-#endif
 
-#ifdef USE_CELL_HASH_CACHE
-	std::string int_to_hash_string(unsigned int v)
+	// structural hash of a cell: type, parameters and (sigmapped) input signals,
+	// with the same canonicalization of commutative inputs as the comparison below
+
+	static void hash_add(uint64_t &h, uint64_t v)
+	{
+		h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	}
+
+	static uint64_t hash_sig(const RTLIL::SigSpec &sig)
 	{
-		if (v == 0)
-			return "0";
-		std::string str = "";
-		while (v > 0) {
-			str += 'a' + (v & 15);
-			v = v >> 4;
+		uint64_t h = sig.size();
+		for (auto &bit : sig) {
+			if (bit.wire == NULL)
+				hash_add(h, bit.data);
+			else
+				hash_add(h, (uint64_t(bit.wire->name.index_) << 32) + bit.offset + 4);
 		}
-		return str;
+		return h;
 	}
 
-	std::string hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
+	uint64_t hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
 	{
-		if (cell_hash_cache.count(cell) > 0)
-			return cell_hash_cache[cell];
+		RTLIL::IdString type = cell->type;
+		uint64_t h = type.index_;
+
+		for (auto &it : cell->parameters) {
+			hash_add(h, it.first.index_);
+			for (auto bit : it.second.bits)
+				hash_add(h, bit);
+		}
 
-		std::string hash_string = cell->type.str() + "\n";
+		bool commutative = type.in("$and", "$or", "$xor", "$xnor", "$add", "$mul",
+				"$logic_and", "$logic_or", "$_AND_", "$_OR_", "$_XOR_");
+		uint64_t hash_a = 0, hash_b = 0;
+
+		for (auto &it : cell->connections())
+		{
+			if (ct.cell_output(cell->type, it.first))
+				continue;
 
-		for (auto &it : cell->parameters)
-			hash_string += "P " + it.first.str() + "=" + it.second.as_string() + "\n";
+			RTLIL::SigSpec sig = assign_map(it.second);
 
-		const std::map<RTLIL::IdString, RTLIL::SigSpec> *conn = &cell->connections();
-		std::map<RTLIL::IdString, RTLIL::SigSpec> alt_conn;
+			if (it.first == "\\A") {
+				if (type.in("$reduce_xor", "$reduce_xnor"))
+					sig.sort();
+				if (type.in("$reduce_and", "$reduce_or", "$reduce_bool"))
+					sig.sort_and_unify();
+			}
 
-		if (cell->type == "$and" || cell->type == "$or" || cell->type == "$xor" || cell->type == "$xnor" || cell->type == "$add" || cell->type == "$mul" ||
-				cell->type == "$logic_and" || cell->type == "$logic_or" || cell->type == "$_AND_" || cell->type == "$_OR_" || cell->type == "$_XOR_") {
-			alt_conn = *conn;
-			if (assign_map(alt_conn.at("\\A")) < assign_map(alt_conn.at("\\B"))) {
-				alt_conn["\\A"] = conn->at("\\B");
-				alt_conn["\\B"] = conn->at("\\A");
+			if (commutative && it.first == "\\A") {
+				hash_a = hash_sig(sig);
+				continue;
 			}
-			conn = &alt_conn;
-		} else
-		if (cell->type == "$reduce_xor" || cell->type == "$reduce_xnor") {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at("\\A"));
-			alt_conn.at("\\A").sort();
-			conn = &alt_conn;
-		} else
-		if (cell->type == "$reduce_and" || cell->type == "$reduce_or" || cell->type == "$reduce_bool") {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at("\\A"));
-			alt_conn.at("\\A").sort_and_unify();
-			conn = &alt_conn;
-		}
 
-		for (auto &it : *conn) {
-			if (ct.cell_output(cell->type, it.first))
+			if (commutative && it.first == "\\B") {
+				hash_b = hash_sig(sig);
 				continue;
-			RTLIL::SigSpec sig = it.second;
-			assign_map.apply(sig);
-			hash_string += "C " + it.first.str() + "=";
-			for (auto &chunk : sig.chunks()) {
-				if (chunk.wire)
-					hash_string += "{" + chunk.wire->name.str() + " " +
-							int_to_hash_string(chunk.offset) + " " +
-							int_to_hash_string(chunk.width) + "}";
-				else
-					hash_string += RTLIL::Const(chunk.data).as_string();
 			}
-			hash_string += "\n";
+
+			hash_add(h, it.first.index_);
+			hash_add(h, hash_sig(sig));
+		}
+
+		if (commutative) {
+			hash_add(h, std::min(hash_a, hash_b));
+			hash_add(h, std::max(hash_a, hash_b));
 		}
 
-		cell_hash_cache[cell] = sha1(hash_string);
-		return cell_hash_cache[cell];
+		return h;
 	}
-#endif
 
-	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2, bool &lt)
+	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
 	{
-#ifdef USE_CELL_HASH_CACHE
-		std::string hash1 = hash_cell_parameters_and_connections(cell1);
-		std::string hash2 = hash_cell_parameters_and_connections(cell2);
-
-		if (hash1 != hash2) {
-			lt = hash1 < hash2;
-			return true;
-		}
-#endif
+		if (cell1->type != cell2->type)
+			return false;
 
-		if (cell1->parameters != cell2->parameters) {
-			lt = cell1->parameters < cell2->parameters;
-			return true;
-		}
+		if (cell1->parameters != cell2->parameters)
+			return false;
 
 		std::map<RTLIL::IdString, RTLIL::SigSpec> conn1 = cell1->connections();
 		std::map<RTLIL::IdString, RTLIL::SigSpec> conn2 = cell2->connections();
@@ -170,50 +157,20 @@ struct OptShareWorker
 			conn2["\\A"].sort_and_unify();
 		}
 
-		if (conn1 != conn2) {
-			lt = conn1 < conn2;
-			return true;
-		}
+		if (conn1 != conn2)
+			return false;
 
 		if (cell1->type.substr(0, 1) == "$" && conn1.count("\\Q") != 0) {
 			std::vector<RTLIL::SigBit> q1 = dff_init_map(cell1->getPort("\\Q")).to_sigbit_vector();
 			std::vector<RTLIL::SigBit> q2 = dff_init_map(cell2->getPort("\\Q")).to_sigbit_vector();
 			for (size_t i = 0; i < q1.size(); i++)
-				if ((q1.at(i).wire == NULL || q2.at(i).wire == NULL) && q1.at(i) != q2.at(i)) {
-					lt = q1.at(i) < q2.at(i);
-					return true;
-				}
+				if ((q1.at(i).wire == NULL || q2.at(i).wire == NULL) && q1.at(i) != q2.at(i))
+					return false;
 		}
 
-		return false;
-	}
-
-	bool compare_cells(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
-	{
-		if (cell1->type != cell2->type)
-			return cell1->type < cell2->type;
-
-		if (!ct.cell_known(cell1->type))
-			return cell1 < cell2;
-
-		if (cell1->has_keep_attr() || cell2->has_keep_attr())
-			return cell1 < cell2;
-
-		bool lt;
-		if (compare_cell_parameters_and_connections(cell1, cell2, lt))
-			return lt;
-
-		return false;
+		return true;
 	}
 
-	struct CompareCells {
-		OptShareWorker *that;
-		CompareCells(OptShareWorker *that) : that(that) {}
-		bool operator()(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2) const {
-			return that->compare_cells(cell1, cell2);
-		}
-	};
-
 	OptShareWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux) :
 		design(design), module(module), assign_map(module)
 	{
@@ -239,26 +196,34 @@ struct OptShareWorker
 		bool did_something = true;
 		while (did_something)
 		{
-#ifdef USE_CELL_HASH_CACHE
-			cell_hash_cache.clear();
-#endif
 			std::vector<RTLIL::Cell*> cells;
 			cells.reserve(module->cells_.size());
 			for (auto &it : module->cells_) {
-				if (ct.cell_known(it.second->type) && design->selected(module, it.second))
+				if (ct.cell_known(it.second->type) && !it.second->has_keep_attr() && design->selected(module, it.second))
 					cells.push_back(it.second);
 			}
 
+			// cells are only compared in full when their hashes match
 			did_something = false;
-			std::map<RTLIL::Cell*, RTLIL::Cell*, CompareCells> sharemap(CompareCells(this));
+			std::unordered_map<uint64_t, std::vector<RTLIL::Cell*>> sharemap;
+			sharemap.reserve(cells.size());
 			for (auto cell : cells)
 			{
-				if (sharemap.count(cell) > 0) {
+				std::vector<RTLIL::Cell*> &bucket = sharemap[hash_cell_parameters_and_connections(cell)];
+				RTLIL::Cell *other_cell = NULL;
+
+				for (auto c : bucket)
+					if (compare_cell_parameters_and_connections(cell, c)) {
+						other_cell = c;
+						break;
+					}
+
+				if (other_cell != NULL) {
 					did_something = true;
-					log("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), sharemap[cell]->name.c_str());
+					log("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), other_cell->name.c_str());
 					for (auto &it : cell->connections()) {
 						if (ct.cell_output(cell->type, it.first)) {
-							RTLIL::SigSpec other_sig = sharemap[cell]->getPort(it.first);
+							RTLIL::SigSpec other_sig = other_cell->getPort(it.first);
 							log("    Redirecting output %s: %s = %s\n", it.first.c_str(),
 									log_signal(it.second), log_signal(other_sig));
 							module->connect(RTLIL::SigSig(it.second, other_sig));
@@ -269,7 +234,7 @@ struct OptShareWorker
 					module->remove(cell);
 					total_count++;
 				} else {
-					sharemap[cell] = cell;
+					bucket.push_back(cell);
 				}
 			}
 		}
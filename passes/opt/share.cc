@@ -23,6 +23,7 @@
 #include "kernel/modtools.h"
 #include "kernel/utils.h"
 #include "kernel/macc.h"
+#include "kernel/bitsim.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -59,6 +60,8 @@ struct ShareWorker
 
 	std::vector<std::pair<RTLIL::SigBit, RTLIL::SigBit>> exclusive_ctrls;
 
+	int stats_sim_rejected, stats_sat_queries;
+
 
 	// ------------------------------------------------------------------------------
 	// Find terminal bits -- i.e. bits that do not (exclusively) feed into a mux tree
@@ -929,6 +932,205 @@ struct ShareWorker
 	}
 
 
+	// ------------------------------------------------------------------------------
+	// One incremental SAT problem for the control logic of the module. Each cell is
+	// imported only once, the queries for the individual pairs only use assumptions.
+	// (This is only done when the module has no logic loops, as the constraints for
+	// cells outside the cone of a pair of cells must not affect the result.)
+	// ------------------------------------------------------------------------------
+
+	ezDefaultSAT *ez;
+	SatGen *satgen;
+	std::set<RTLIL::Cell*> sat_cells;
+	bool sat_shared;
+
+	void reset_sat()
+	{
+		delete satgen;
+		delete ez;
+
+		ez = new ezDefaultSAT;
+		satgen = new SatGen(ez, &modwalker.sigmap);
+		sat_cells.clear();
+	}
+
+	void find_ctrl_cone(const RTLIL::SigSpec &sig, std::set<RTLIL::Cell*> &cone_cells, std::set<RTLIL::SigBit> &cone_bits)
+	{
+		std::set<RTLIL::SigBit> bits_queue;
+
+		for (auto &bit : sig.to_sigbit_vector()) {
+			bits_queue.insert(bit);
+			cone_bits.insert(bit);
+		}
+
+		while (!bits_queue.empty())
+		{
+			std::set<ModWalker::PortBit> portbits;
+			modwalker.get_drivers(portbits, bits_queue);
+			bits_queue.clear();
+
+			for (auto &pbit : portbits)
+				if (cone_cells.count(pbit.cell) == 0 && cone_ct.cell_known(pbit.cell->type)) {
+					if (config.opt_fast && modwalker.cell_outputs[pbit.cell].size() >= 4)
+						continue;
+					bits_queue.insert(modwalker.cell_inputs[pbit.cell].begin(), modwalker.cell_inputs[pbit.cell].end());
+					cone_bits.insert(modwalker.cell_inputs[pbit.cell].begin(), modwalker.cell_inputs[pbit.cell].end());
+					cone_bits.insert(modwalker.cell_outputs[pbit.cell].begin(), modwalker.cell_outputs[pbit.cell].end());
+					cone_cells.insert(pbit.cell);
+				}
+
+			if (config.opt_fast && cone_cells.size() > 100)
+				break;
+		}
+	}
+
+	void import_ctrl_cone(const std::set<RTLIL::Cell*> &cone_cells)
+	{
+		for (auto cell : cone_cells)
+			if (sat_cells.count(cell) == 0) {
+				satgen->importCell(cell);
+				sat_cells.insert(cell);
+			}
+	}
+
+
+	// ----------------------------------------------------------------------------
+	// Random simulation of the control logic. Pairs of cells that are active at the
+	// same time for one of the simulated vectors can not be shared. Signals that
+	// depend on cells in the SAT problem that are not simulated are marked inexact.
+	// ----------------------------------------------------------------------------
+
+	typedef BitParallelSim::word_t word_t;
+	static const int num_words = BitParallelSim::num_words;
+
+	BitParallelSim *sim;
+	std::vector<bool> sim_inexact;
+	std::vector<word_t> sim_valid_lanes;
+
+	void setup_sim()
+	{
+		CellTypes sim_ct;
+		for (auto &it : cone_ct.cell_types)
+			if (it.second.is_evaluable && it.first != "$lcu" && it.first != "$fa" && it.first != "$macc" && it.second.outputs.count("\\Y"))
+				sim_ct.cell_types.insert(it);
+
+		// activation patterns and exclusive control bits are built from mux select
+		// inputs, so only the input cones of those need to be simulated
+		std::set<RTLIL::SigBit> sim_driven_bits, inexact_bits;
+		RTLIL::SigSpec inputs, outputs;
+
+		for (auto cell : module->cells()) {
+			if (sim_ct.cell_known(cell->type))
+				sim_driven_bits.insert(modwalker.cell_outputs[cell].begin(), modwalker.cell_outputs[cell].end());
+			else if (cone_ct.cell_known(cell->type))
+				inexact_bits.insert(modwalker.cell_outputs[cell].begin(), modwalker.cell_outputs[cell].end());
+			if (cell->type.in("$mux", "$pmux"))
+				outputs.append(modwalker.sigmap(cell->getPort("\\S")));
+		}
+
+		for (auto &it : module->wires_)
+			for (auto bit : modwalker.sigmap(it.second))
+				if (sim_driven_bits.count(bit) == 0)
+					inputs.append_bit(bit);
+
+		inputs.sort_and_unify();
+		outputs.sort_and_unify();
+
+		sim = new BitParallelSim(module, inputs, outputs);
+		if (!sim->fail_reason.empty()) {
+			log("Not using simulation for module %s: %s\n", log_id(module), sim->fail_reason.c_str());
+			delete sim;
+			sim = NULL;
+			return;
+		}
+
+		uint64_t rng_state = 314159265359;
+		for (int idx : sim->input_bits)
+			for (int k = 0; k < num_words; k++) {
+				rng_state ^= rng_state << 13;
+				rng_state ^= rng_state >> 7;
+				rng_state ^= rng_state << 17;
+				sim->value[idx*num_words + k] = rng_state;
+			}
+		sim->eval(BitParallelSim::num_lanes);
+
+		sim_inexact.resize(GetSize(sim->value) / num_words);
+		for (auto bit : inexact_bits)
+			if (sim->bit_index.count(bit))
+				sim_inexact.at(sim->bit_index.at(bit)) = true;
+
+		for (auto &sc : sim->sim_cells) {
+			bool inexact = false;
+			for (auto v : {&sc.a, &sc.b, &sc.c, &sc.d, &sc.s})
+				for (int idx : *v)
+					inexact = inexact || sim_inexact[idx];
+			if (inexact)
+				for (auto v : {&sc.y, &sc.x, &sc.co})
+					for (int idx : *v)
+						sim_inexact[idx] = true;
+		}
+
+		// lanes that violate one of the exclusive control constraints are not used
+		sim_valid_lanes = std::vector<word_t>(num_words, ~word_t(0));
+		for (auto &it : exclusive_ctrls) {
+			int idx1 = sim_exact_bit(it.first), idx2 = sim_exact_bit(it.second);
+			if (idx1 < 0 || idx2 < 0)
+				continue;
+			for (int k = 0; k < num_words; k++)
+				sim_valid_lanes[k] &= ~((sim->value[idx1*num_words + k] | sim->undef[idx1*num_words + k]) &
+						(sim->value[idx2*num_words + k] | sim->undef[idx2*num_words + k]));
+		}
+	}
+
+	// index of a bit in the simulation, or -1 if the simulation does not know the
+	// bit or its value is inexact. (sim->bit() would allocate a new unused index.)
+	int sim_exact_bit(RTLIL::SigBit bit)
+	{
+		bit = sim->sigmap(bit);
+		if (bit.wire == NULL)
+			return sim->bit(bit);
+		auto it = sim->bit_index.find(bit);
+		if (it == sim->bit_index.end() || sim_inexact[it->second])
+			return -1;
+		return it->second;
+	}
+
+	bool sim_activation_lanes(const std::set<std::pair<RTLIL::SigSpec, RTLIL::Const>> &activation_patterns, std::vector<word_t> &lanes)
+	{
+		lanes = std::vector<word_t>(num_words, 0);
+
+		for (auto &p : activation_patterns)
+		{
+			std::vector<word_t> match = sim_valid_lanes;
+			std::vector<RTLIL::SigBit> p_first = p.first;
+
+			for (int i = 0; i < GetSize(p_first); i++) {
+				int idx = sim_exact_bit(p_first[i]);
+				if (idx < 0)
+					return false;
+				for (int k = 0; k < num_words; k++) {
+					word_t v = sim->value[idx*num_words + k], x = sim->undef[idx*num_words + k];
+					match[k] &= (p.second.bits.at(i) == RTLIL::State::S1 ? v : ~v) & ~x;
+				}
+			}
+
+			for (int k = 0; k < num_words; k++)
+				lanes[k] |= match[k];
+		}
+
+		return true;
+	}
+
+	static int find_lane(const std::vector<word_t> &lanes)
+	{
+		for (int k = 0; k < num_words; k++)
+			for (int i = 0; i < 64; i++)
+				if ((lanes[k] >> i) & 1)
+					return 64*k + i;
+		return -1;
+	}
+
+
 	// -------------------------------------------------------------------------------------
 	// Helper functions used to make sure that this pass does not introduce new logic loops.
 	// -------------------------------------------------------------------------------------
@@ -1050,7 +1252,7 @@ struct ShareWorker
 	// -------------
 
 	ShareWorker(ShareWorkerConfig config, RTLIL::Design *design, RTLIL::Module *module) :
-			config(config), design(design), module(module), mi(module)
+			config(config), design(design), module(module), mi(module), ez(NULL), satgen(NULL), sim(NULL)
 	{
 		bool before_scc = module_has_scc();
 
@@ -1084,11 +1286,21 @@ struct ShareWorker
 
 		for (auto cell : module->cells())
 			if (cell->type == "$pmux")
-				for (auto bit : cell->getPort("\\S"))
-				for (auto other_bit : cell->getPort("\\S"))
+				for (auto bit : modwalker.sigmap(cell->getPort("\\S")))
+				for (auto other_bit : modwalker.sigmap(cell->getPort("\\S")))
 					if (bit < other_bit)
 						exclusive_ctrls.push_back(std::pair<RTLIL::SigBit, RTLIL::SigBit>(bit, other_bit));
 
+		stats_sim_rejected = 0;
+		stats_sat_queries = 0;
+
+		sat_shared = !before_scc;
+		if (sat_shared)
+			reset_sat();
+
+		if (!before_scc)
+			setup_sim();
+
 		while (!shareable_cells.empty() && config.limit != 0)
 		{
 			RTLIL::Cell *cell = *shareable_cells.begin();
@@ -1167,84 +1379,90 @@ struct ShareWorker
 				optimize_activation_patterns(filtered_cell_activation_patterns);
 				optimize_activation_patterns(filtered_other_cell_activation_patterns);
 
-				ezDefaultSAT ez;
-				SatGen satgen(&ez, &modwalker.sigmap);
+				if (!sat_shared)
+					reset_sat();
 
-				std::set<RTLIL::Cell*> sat_cells;
-				std::set<RTLIL::SigBit> bits_queue;
+				std::set<RTLIL::Cell*> cone_cells;
+				std::set<RTLIL::SigBit> cone_bits;
 
 				std::vector<int> cell_active, other_cell_active;
 				RTLIL::SigSpec all_ctrl_signals;
 
 				for (auto &p : filtered_cell_activation_patterns) {
 					log("      Activation pattern for cell %s: %s = %s\n", log_id(cell), log_signal(p.first), log_signal(p.second));
-					cell_active.push_back(ez.vec_eq(satgen.importSigSpec(p.first), satgen.importSigSpec(p.second)));
+					cell_active.push_back(ez->vec_eq(satgen->importSigSpec(p.first), satgen->importSigSpec(p.second)));
 					all_ctrl_signals.append(p.first);
 				}
 
 				for (auto &p : filtered_other_cell_activation_patterns) {
 					log("      Activation pattern for cell %s: %s = %s\n", log_id(other_cell), log_signal(p.first), log_signal(p.second));
-					other_cell_active.push_back(ez.vec_eq(satgen.importSigSpec(p.first), satgen.importSigSpec(p.second)));
+					other_cell_active.push_back(ez->vec_eq(satgen->importSigSpec(p.first), satgen->importSigSpec(p.second)));
 					all_ctrl_signals.append(p.first);
 				}
 
-				for (auto &bit : cell_activation_signals.to_sigbit_vector())
-					bits_queue.insert(bit);
-
-				for (auto &bit : other_cell_activation_signals.to_sigbit_vector())
-					bits_queue.insert(bit);
+				find_ctrl_cone(cell_activation_signals, cone_cells, cone_bits);
+				find_ctrl_cone(other_cell_activation_signals, cone_cells, cone_bits);
 
-				while (!bits_queue.empty())
-				{
-					std::set<ModWalker::PortBit> portbits;
-					modwalker.get_drivers(portbits, bits_queue);
-					bits_queue.clear();
-
-					for (auto &pbit : portbits)
-						if (sat_cells.count(pbit.cell) == 0 && cone_ct.cell_known(pbit.cell->type)) {
-							if (config.opt_fast && modwalker.cell_outputs[pbit.cell].size() >= 4)
-								continue;
-							// log("      Adding cell %s (%s) to SAT problem.\n", log_id(pbit.cell), log_id(pbit.cell->type));
-							bits_queue.insert(modwalker.cell_inputs[pbit.cell].begin(), modwalker.cell_inputs[pbit.cell].end());
-							satgen.importCell(pbit.cell);
-							sat_cells.insert(pbit.cell);
-						}
+				all_ctrl_signals.sort_and_unify();
 
-					if (config.opt_fast && sat_cells.size() > 100)
-						break;
-				}
+				std::vector<int> exclusive_ctrl_bits;
+				bool use_sim = sim != NULL;
 
 				for (auto it : exclusive_ctrls)
-					if (satgen.importedSigBit(it.first) && satgen.importedSigBit(it.second)) {
+					if (cone_bits.count(it.first) && cone_bits.count(it.second)) {
 						log("      Adding exclusive control bits: %s vs. %s\n", log_signal(it.first), log_signal(it.second));
-						ez.assume(ez.NOT(ez.AND(satgen.importSigBit(it.first), satgen.importSigBit(it.second))));
+						exclusive_ctrl_bits.push_back(ez->NOT(ez->AND(satgen->importSigBit(it.first), satgen->importSigBit(it.second))));
+						if (use_sim && (sim_exact_bit(it.first) < 0 || sim_exact_bit(it.second) < 0))
+							use_sim = false;
 					}
 
-				if (!ez.solve(ez.expression(ez.OpOr, cell_active))) {
+				int exclusive_ctrls_ok = ez->expression(ez->OpAnd, exclusive_ctrl_bits);
+
+				std::vector<word_t> cell_active_lanes, other_cell_active_lanes;
+				bool cell_sim_ok = use_sim && sim_activation_lanes(filtered_cell_activation_patterns, cell_active_lanes);
+				bool other_cell_sim_ok = use_sim && sim_activation_lanes(filtered_other_cell_activation_patterns, other_cell_active_lanes);
+
+				if (cell_sim_ok && other_cell_sim_ok)
+				{
+					std::vector<word_t> both_active_lanes(num_words);
+					for (int k = 0; k < num_words; k++)
+						both_active_lanes[k] = cell_active_lanes[k] & other_cell_active_lanes[k];
+
+					int lane = find_lane(both_active_lanes);
+					if (lane >= 0) {
+						log("      According to the simulation this pair of cells can not be shared.\n");
+						log("      Simulated vector: %s = %s\n", log_signal(all_ctrl_signals),
+								log_signal(sim->get_lane(sim->bits(all_ctrl_signals), lane)));
+						stats_sim_rejected++;
+						continue;
+					}
+				}
+
+				import_ctrl_cone(cone_cells);
+
+				if ((!cell_sim_ok || find_lane(cell_active_lanes) < 0) && (stats_sat_queries++,
+						!ez->solve(ez->AND(ez->expression(ez->OpOr, cell_active), exclusive_ctrls_ok)))) {
 					log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(cell));
 					cells_to_remove.insert(cell);
 					break;
 				}
 
-				if (!ez.solve(ez.expression(ez.OpOr, other_cell_active))) {
+				if ((!other_cell_sim_ok || find_lane(other_cell_active_lanes) < 0) && (stats_sat_queries++,
+						!ez->solve(ez->AND(ez->expression(ez->OpOr, other_cell_active), exclusive_ctrls_ok)))) {
 					log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(other_cell));
 					cells_to_remove.insert(other_cell);
 					shareable_cells.erase(other_cell);
 					continue;
 				}
 
-				ez.non_incremental();
-
-				all_ctrl_signals.sort_and_unify();
-				std::vector<int> sat_model = satgen.importSigSpec(all_ctrl_signals);
+				std::vector<int> sat_model = satgen->importSigSpec(all_ctrl_signals);
 				std::vector<bool> sat_model_values;
 
-				ez.assume(ez.AND(ez.expression(ez.OpOr, cell_active), ez.expression(ez.OpOr, other_cell_active)));
-
-				log("      Size of SAT problem: %d cells, %d variables, %d clauses\n",
-						GetSize(sat_cells), ez.numCnfVariables(), ez.numCnfClauses());
+				log("      Size of SAT problem: %d cells (%d in cone of this pair), %d variables, %d clauses\n",
+						GetSize(sat_cells), GetSize(cone_cells), ez->numCnfVariables(), ez->numCnfClauses());
 
-				if (ez.solve(sat_model, sat_model_values)) {
+				stats_sat_queries++;
+				if (ez->solve(sat_model, sat_model_values, ez->AND(ez->expression(ez->OpOr, cell_active), ez->expression(ez->OpOr, other_cell_active)), exclusive_ctrls_ok)) {
 					log("      According to the SAT solver this pair of cells can not be shared.\n");
 					log("      Model from SAT solver: %s = %d'", log_signal(all_ctrl_signals), GetSize(sat_model_values));
 					for (int i = GetSize(sat_model_values)-1; i >= 0; i--)
@@ -1332,6 +1550,12 @@ struct ShareWorker
 			}
 		}
 
+		log("Rejected %d pairs of cells using simulation, used %d SAT queries.\n", stats_sim_rejected, stats_sat_queries);
+
+		delete sim;
+		delete satgen;
+		delete ez;
+
 		if (!cells_to_remove.empty()) {
 			log("Removing %d cells in module %s:\n", GetSize(cells_to_remove), log_id(module));
 			for (auto c : cells_to_remove) {
@@ -1357,6 +1581,8 @@ struct SharePass : public Pass {
 		log("\n");
 		log("This pass merges shareable resources into a single resource. A SAT solver\n");
 		log("is used to determine if two resources are share-able.\n");
+		log("Pairs of resources that are active at the same time for one of a set of\n");
+		log("random input vectors are rejected without running the SAT solver.\n");
 		log("\n");
 		log("  -force\n");
 		log("    Per default the selection of cells that is considered for sharing is\n");
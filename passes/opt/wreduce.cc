@@ -50,11 +50,36 @@ struct WreduceWorker
 	ModIndex mi;
 
 	std::set<Cell*, IdString::compare_ptr_by_name<Cell>> work_queue_cells;
-	std::set<SigBit> work_queue_bits;
+	std::map<IdString, int> removed_bits_per_type;
+	std::map<IdString, int> removed_cells_per_type;
 
 	WreduceWorker(WreduceConfig *config, Module *module) :
 			config(config), module(module), mi(module) { }
 
+	void queue_bits(const SigSpec &sig)
+	{
+		for (auto bit : sig)
+		for (auto &port : mi.query_ports(bit))
+			if (module->selected(port.cell))
+				work_queue_cells.insert(port.cell);
+	}
+
+	void remove_cell(Cell *cell)
+	{
+		log("Removed cell %s.%s (%s).\n", log_id(module), log_id(cell), log_id(cell->type));
+		removed_cells_per_type[cell->type]++;
+
+		SigSpec sig;
+		for (auto &conn : cell->connections())
+			sig.append(conn.second);
+
+		work_queue_cells.erase(cell);
+		module->remove(cell);
+
+		// the drivers of the inputs of this cell may have lost their last user
+		queue_bits(sig);
+	}
+
 	void run_cell_mux(Cell *cell)
 	{
 		// Reduce size of MUX if inputs agree on a value for a bit or a output bit is unused
@@ -94,9 +119,9 @@ struct WreduceWorker
 			sig_removed.append_bit(bits_removed[i]);
 
 		if (GetSize(bits_removed) == GetSize(sig_y)) {
-			log("Removed cell %s.%s (%s).\n", log_id(module), log_id(cell), log_id(cell->type));
+			queue_bits(sig_y);
 			module->connect(sig_y, sig_removed);
-			module->remove(cell);
+			remove_cell(cell);
 			return;
 		}
 
@@ -105,10 +130,10 @@ struct WreduceWorker
 
 		int n_removed = GetSize(sig_removed);
 		int n_kept = GetSize(sig_y) - GetSize(sig_removed);
+		removed_bits_per_type[cell->type] += n_removed * (GetSize(sig_s) + 2);
 
 		SigSpec new_work_queue_bits;
 		new_work_queue_bits.append(sig_a.extract(n_kept, n_removed));
-		new_work_queue_bits.append(sig_y.extract(n_kept, n_removed));
 
 		SigSpec new_sig_a = sig_a.extract(0, n_kept);
 		SigSpec new_sig_y = sig_y.extract(0, n_kept);
@@ -119,14 +144,14 @@ struct WreduceWorker
 			new_work_queue_bits.append(sig_b.extract(k*GetSize(sig_a) + n_kept, n_removed));
 		}
 
-		for (auto bit : new_work_queue_bits)
-			work_queue_bits.insert(bit);
-
 		cell->setPort("\\A", new_sig_a);
 		cell->setPort("\\B", new_sig_b);
 		cell->setPort("\\Y", new_sig_y);
 		cell->fixup_parameters();
+		queue_bits(new_work_queue_bits);
 
+		// users of the removed output bits now see the replacement signal
+		queue_bits(sig_y.extract(n_kept, n_removed));
 		module->connect(sig_y.extract(n_kept, n_removed), sig_removed);
 	}
 
@@ -141,23 +166,24 @@ struct WreduceWorker
 		int bits_removed = 0;
 		if (GetSize(sig) > max_port_size) {
 			bits_removed = GetSize(sig) - max_port_size;
-			for (auto bit : sig.extract(max_port_size, bits_removed))
-				work_queue_bits.insert(bit);
 			sig = sig.extract(0, max_port_size);
 		}
 
 		if (port_signed) {
 			while (GetSize(sig) > 1 && sig[GetSize(sig)-1] == sig[GetSize(sig)-2])
-				work_queue_bits.insert(sig[GetSize(sig)-1]), sig.remove(GetSize(sig)-1), bits_removed++;
+				sig.remove(GetSize(sig)-1), bits_removed++;
 		} else {
 			while (GetSize(sig) > 1 && sig[GetSize(sig)-1] == S0)
-				work_queue_bits.insert(sig[GetSize(sig)-1]), sig.remove(GetSize(sig)-1), bits_removed++;
+				sig.remove(GetSize(sig)-1), bits_removed++;
 		}
 
 		if (bits_removed) {
 			log("Removed top %d bits (of %d) from port %c of cell %s.%s (%s).\n",
 					bits_removed, GetSize(sig) + bits_removed, port, log_id(module), log_id(cell), log_id(cell->type));
+			SigSpec old_sig = cell->getPort(stringf("\\%c", port));
 			cell->setPort(stringf("\\%c", port), sig);
+			queue_bits(old_sig.extract(GetSize(sig), bits_removed));
+			removed_bits_per_type[cell->type] += bits_removed;
 			did_something = true;
 		}
 	}
@@ -230,6 +256,7 @@ struct WreduceWorker
 				max_y_size = a_size + b_size;
 
 			while (GetSize(sig) > 1 && GetSize(sig) > max_y_size) {
+				queue_bits(sig[GetSize(sig)-1]);
 				module->connect(sig[GetSize(sig)-1], is_signed ? sig[GetSize(sig)-2] : S0);
 				sig.remove(GetSize(sig)-1);
 				bits_removed++;
@@ -237,8 +264,7 @@ struct WreduceWorker
 		}
 
 		if (GetSize(sig) == 0) {
-			log("Removed cell %s.%s (%s).\n", log_id(module), log_id(cell), log_id(cell->type));
-			module->remove(cell);
+			remove_cell(cell);
 			return;
 		}
 
@@ -246,6 +272,7 @@ struct WreduceWorker
 			log("Removed top %d bits (of %d) from port Y of cell %s.%s (%s).\n",
 					bits_removed, GetSize(sig) + bits_removed, log_id(module), log_id(cell), log_id(cell->type));
 			cell->setPort("\\Y", sig);
+			removed_bits_per_type[cell->type] += bits_removed;
 			did_something = true;
 		}
 
@@ -268,17 +295,14 @@ struct WreduceWorker
 		for (auto c : module->selected_cells())
 			work_queue_cells.insert(c);
 
+		// narrowing a cell queues the cells sharing the affected bits, so
+		// this converges without re-running the pass
+
 		while (!work_queue_cells.empty())
 		{
-			work_queue_bits.clear();
-			for (auto c : work_queue_cells)
-				run_cell(c);
-
-			work_queue_cells.clear();
-			for (auto bit : work_queue_bits)
-			for (auto port : mi.query_ports(bit))
-				if (module->selected(port.cell))
-					work_queue_cells.insert(port.cell);
+			Cell *cell = *work_queue_cells.begin();
+			work_queue_cells.erase(work_queue_cells.begin());
+			run_cell(cell);
 		}
 
 		for (auto w : module->selected_wires())
@@ -335,6 +359,9 @@ struct WreducePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		std::map<IdString, int> removed_bits_per_type;
+		std::map<IdString, int> removed_cells_per_type;
+
 		for (auto module : design->selected_modules())
 		{
 			if (module->has_processes_warn())
@@ -342,6 +369,26 @@ struct WreducePass : public Pass {
 
 			WreduceWorker worker(&config, module);
 			worker.run();
+
+			for (auto &it : worker.removed_bits_per_type)
+				removed_bits_per_type[it.first] += it.second;
+			for (auto &it : worker.removed_cells_per_type)
+				removed_cells_per_type[it.first] += it.second;
+		}
+
+		std::set<IdString, RTLIL::sort_by_id_str> cell_types;
+		for (auto &it : removed_bits_per_type)
+			cell_types.insert(it.first);
+		for (auto &it : removed_cells_per_type)
+			cell_types.insert(it.first);
+
+		if (!cell_types.empty()) {
+			log("\n");
+			log("Removed port bits and cells by cell type:\n");
+			for (auto type : cell_types)
+				log("  %-10s %8d bits %8d cells\n", log_id(type),
+						removed_bits_per_type.count(type) ? removed_bits_per_type.at(type) : 0,
+						removed_cells_per_type.count(type) ? removed_cells_per_type.at(type) : 0);
 		}
 	}
 } WreducePass;
@@ -23,6 +23,7 @@
 #include "kernel/register.h"
 #include "kernel/celltypes.h"
 #include "kernel/consteval.h"
+#include "kernel/bitsim.h"
 #include "kernel/sigtools.h"
 #include "kernel/satgen.h"
 #include "kernel/log.h"
@@ -40,21 +41,31 @@ struct BruteForceEquivChecker
 	RTLIL::Module *mod1, *mod2;
 	RTLIL::SigSpec mod1_inputs, mod1_outputs;
 	RTLIL::SigSpec mod2_inputs, mod2_outputs;
-	int counter, errors;
+	uint64_t counter;
+	int errors;
 	bool ignore_x_mod1;
 
-	void run_checker(RTLIL::SigSpec &inputs)
+	void report_counter_example(const RTLIL::SigSpec &inputs, const RTLIL::SigSpec &sig1, const RTLIL::SigSpec &sig2)
+	{
+		log("Found counter-example (ignore_x_mod1 = %s):\n", ignore_x_mod1 ? "active" : "inactive");
+		log("  Module 1:  %s = %s  =>  %s = %s\n", log_signal(mod1_inputs), log_signal(inputs), log_signal(mod1_outputs), log_signal(sig1));
+		log("  Module 2:  %s = %s  =>  %s = %s\n", log_signal(mod2_inputs), log_signal(inputs), log_signal(mod2_outputs), log_signal(sig2));
+		errors++;
+	}
+
+	void run_checker(ConstEval &ce1, ConstEval &ce2, RTLIL::SigSpec &inputs)
 	{
 		if (inputs.size() < mod1_inputs.size()) {
 			RTLIL::SigSpec inputs0 = inputs, inputs1 = inputs;
 			inputs0.append(RTLIL::Const(0, 1));
 			inputs1.append(RTLIL::Const(1, 1));
-			run_checker(inputs0);
-			run_checker(inputs1);
+			run_checker(ce1, ce2, inputs0);
+			run_checker(ce1, ce2, inputs1);
 			return;
 		}
 
-		ConstEval ce1(mod1), ce2(mod2);
+		ce1.push();
+		ce2.push();
 		ce1.set(mod1_inputs, inputs.as_const());
 		ce2.set(mod2_inputs, inputs.as_const());
 
@@ -68,22 +79,71 @@ struct BruteForceEquivChecker
 			log("Failed ConstEval of module 2 outputs at signal %s (input: %s = %s).\n",
 					log_signal(undef2), log_signal(mod1_inputs), log_signal(inputs));
 
+		ce1.pop();
+		ce2.pop();
+
 		if (ignore_x_mod1) {
 			for (int i = 0; i < GetSize(sig1); i++)
 				if (sig1[i] == RTLIL::State::Sx)
 					sig2[i] = RTLIL::State::Sx;
 		}
 
-		if (sig1 != sig2) {
-			log("Found counter-example (ignore_x_mod1 = %s):\n", ignore_x_mod1 ? "active" : "inactive");
-			log("  Module 1:  %s = %s  =>  %s = %s\n", log_signal(mod1_inputs), log_signal(inputs), log_signal(mod1_outputs), log_signal(sig1));
-			log("  Module 2:  %s = %s  =>  %s = %s\n", log_signal(mod2_inputs), log_signal(inputs), log_signal(mod2_outputs), log_signal(sig2));
-			errors++;
-		}
+		if (sig1 != sig2)
+			report_counter_example(inputs, sig1, sig2);
 
 		counter++;
 	}
 
+	void run_bitparallel(BitParallelSim &sim1, BitParallelSim &sim2)
+	{
+		typedef BitParallelSim::word_t word_t;
+		const int num_words = BitParallelSim::num_words;
+		uint64_t num_vectors = uint64_t(1) << GetSize(mod1_inputs);
+
+		for (uint64_t base = 0; base < num_vectors; base += BitParallelSim::num_lanes)
+		{
+			int num_valid_lanes = std::min(num_vectors - base, uint64_t(BitParallelSim::num_lanes));
+
+			sim1.set_inputs(base);
+			sim2.set_inputs(base);
+			sim1.eval(num_valid_lanes);
+			sim2.eval(num_valid_lanes);
+
+			for (int k = 0; k < num_words; k++)
+			{
+				word_t mismatch = 0;
+				for (int i = 0; i < GetSize(sim1.output_bits); i++) {
+					word_t v1 = sim1.value[sim1.output_bits[i]*num_words + k], x1 = sim1.undef[sim1.output_bits[i]*num_words + k];
+					word_t v2 = sim2.value[sim2.output_bits[i]*num_words + k], x2 = sim2.undef[sim2.output_bits[i]*num_words + k];
+					word_t diff = (x1 ^ x2) | (~x1 & ~x2 & (v1 ^ v2));
+					mismatch |= ignore_x_mod1 ? diff & ~x1 : diff;
+				}
+
+				for (int lane = 64*k; mismatch != 0 && lane < std::min(64*(k+1), num_valid_lanes); lane++)
+				{
+					if (((mismatch >> (lane % 64)) & 1) == 0)
+						continue;
+
+					RTLIL::Const inputs(RTLIL::State::S0, GetSize(mod1_inputs));
+					for (int i = 0; i < GetSize(mod1_inputs); i++)
+						if (((base + lane) >> i) & 1)
+							inputs.bits[i] = RTLIL::State::S1;
+
+					RTLIL::Const sig1 = sim1.get_lane(sim1.output_bits, lane);
+					RTLIL::Const sig2 = sim2.get_lane(sim2.output_bits, lane);
+					if (ignore_x_mod1) {
+						for (int i = 0; i < GetSize(sig1); i++)
+							if (sig1.bits[i] == RTLIL::State::Sx)
+								sig2.bits[i] = RTLIL::State::Sx;
+					}
+					report_counter_example(inputs, sig1, sig2);
+				}
+			}
+
+			counter += num_valid_lanes;
+		}
+	}
+
 	BruteForceEquivChecker(RTLIL::Module *mod1, RTLIL::Module *mod2, bool ignore_x_mod1) :
 			mod1(mod1), mod2(mod2), counter(0), errors(0), ignore_x_mod1(ignore_x_mod1)
 	{
@@ -110,8 +170,25 @@ struct BruteForceEquivChecker
 			}
 		}
 
+		if (GetSize(mod1_inputs) >= 63)
+			log_cmd_error("Too many input bits for a brute-force check (%d).\n", GetSize(mod1_inputs));
+
+		BitParallelSim sim1(mod1, mod1_inputs, mod1_outputs);
+		BitParallelSim sim2(mod2, mod2_inputs, mod2_outputs);
+
+		if (sim1.fail_reason.empty() && sim2.fail_reason.empty()) {
+			log("Using bit-parallel simulation (%d and %d cells, %d vectors per pass).\n",
+					GetSize(sim1.sim_cells), GetSize(sim2.sim_cells), BitParallelSim::num_lanes);
+			run_bitparallel(sim1, sim2);
+			return;
+		}
+
+		log("Can't use bit-parallel simulation on module %d (%s), using ConstEval.\n",
+				sim1.fail_reason.empty() ? 2 : 1, (sim1.fail_reason.empty() ? sim2 : sim1).fail_reason.c_str());
+
+		ConstEval ce1(mod1), ce2(mod2);
 		RTLIL::SigSpec inputs;
-		run_checker(inputs);
+		run_checker(ce1, ce2, inputs);
 	}
 };
 
@@ -237,6 +314,10 @@ struct VlogHammerReporter
 
 	void run()
 	{
+		std::vector<ConstEval*> ce_list;
+		for (auto module : modules)
+			ce_list.push_back(new ConstEval(module));
+
 		for (int idx = 0; idx < int(patterns.size()); idx++)
 		{
 			log("Creating report for pattern %d: %s\n", idx, log_signal(patterns[idx]));
@@ -249,7 +330,8 @@ struct VlogHammerReporter
 				RTLIL::Const recorded_set_vals;
 				RTLIL::Module *module = modules[mod];
 				std::string module_name = module_names[mod].c_str();
-				ConstEval ce(module);
+				ConstEval &ce = *ce_list[mod];
+				ce.push();
 
 				std::vector<RTLIL::State> bits(patterns[idx].bits.begin(), patterns[idx].bits.begin() + total_input_width);
 				for (int i = 0; i < int(inputs.size()); i++) {
@@ -296,10 +378,15 @@ struct VlogHammerReporter
 				}
 
 				log("++RPT++ %d%s %s %s\n", idx, input_pattern_list.c_str(), sig.as_const().as_string().c_str(), module_name.c_str());
+				ce.pop();
 			}
 
 			log("++RPT++ ----\n");
 		}
+
+		for (auto ce : ce_list)
+			delete ce;
+
 		log("++OK++\n");
 	}
 
@@ -422,8 +509,8 @@ struct EvalPass : public Pass {
 				BruteForceEquivChecker checker(design->modules_.at(mod1_name), design->modules_.at(mod2_name), args[argidx-2] == "-brute_force_equiv_checker_x");
 				if (checker.errors > 0)
 					log_cmd_error("Modules are not equivialent!\n");
-				log("Verified %s = %s (using brute-force check on %d cases).\n",
-						mod1_name.c_str(), mod2_name.c_str(), checker.counter);
+				log("Verified %s = %s (using brute-force check on %llu cases).\n",
+						mod1_name.c_str(), mod2_name.c_str(), (unsigned long long)checker.counter);
 				return;
 			}
 			if (args[argidx] == "-vloghammer_report" && argidx+5 == args.size()) {
@@ -23,16 +23,25 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/satgen.h"
+#include "kernel/bitsim.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <limits>
+#include <chrono>
+
+#if EZMINISAT_THREADS
+#  include <condition_variable>
+#  include <mutex>
+#  include <thread>
+#endif
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-bool inv_mode;
-int verbose_level, reduce_counter, reduce_stop_at;
+bool inv_mode, sim_mode;
+int verbose_level, reduce_counter, reduce_stop_at, num_threads;
 typedef std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, std::set<RTLIL::SigBit>>> drivers_t;
 std::string dump_prefix;
 
@@ -68,6 +77,145 @@ struct CountBitUsage
 	}
 };
 
+// random simulation of the module. the simulation results (signatures) are used to
+// split buckets before they are passed to the SAT solver, and the results with one
+// input flipped are used to find relevant inputs of a signal without the solver.
+// counter examples found by the SAT solver are simulated in the next pass.
+struct FreduceSim
+{
+	typedef BitParallelSim::word_t word_t;
+
+	BitParallelSim sim;
+	std::vector<std::vector<word_t>> pass_values, pass_undefs;
+	std::vector<std::map<RTLIL::SigBit, bool>> pending_cex;
+	uint64_t rng_state;
+	int num_cex;
+
+	FreduceSim(RTLIL::Module *module, const RTLIL::SigSpec &inputs, const RTLIL::SigSpec &outputs) :
+			sim(module, inputs, outputs), rng_state(88172645463325252ULL), num_cex(0)
+	{
+	}
+
+	word_t random_word()
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+		return rng_state;
+	}
+
+	int index(RTLIL::SigBit bit) const
+	{
+		bit = sim.sigmap(bit);
+		if (bit.wire == NULL)
+			return bit.data == RTLIL::State::S0 ? 0 : bit.data == RTLIL::State::S1 ? 1 : 2;
+		auto it = sim.bit_index.find(bit);
+		return it != sim.bit_index.end() ? it->second : -1;
+	}
+
+	int num_sig_words() const
+	{
+		return GetSize(pass_values) * BitParallelSim::num_words;
+	}
+
+	// lanes with a defined 1 (set) or 0 (clr) for the given signal index
+	word_t set_word(int idx, int j, bool inverted) const
+	{
+		if (idx < 0)
+			return 0;
+		int n = BitParallelSim::num_words, k = idx*n + j%n;
+		word_t v = pass_values[j/n][k];
+		return (inverted ? ~v : v) & ~pass_undefs[j/n][k];
+	}
+
+	word_t clr_word(int idx, int j, bool inverted) const
+	{
+		if (idx < 0)
+			return 0;
+		int n = BitParallelSim::num_words, k = idx*n + j%n;
+		word_t v = pass_values[j/n][k];
+		return (inverted ? v : ~v) & ~pass_undefs[j/n][k];
+	}
+
+	void add_cex(const std::vector<RTLIL::SigBit> &bits, const std::vector<bool> &values)
+	{
+		pending_cex.push_back(std::map<RTLIL::SigBit, bool>());
+		for (int i = 0; i < GetSize(bits); i++)
+			pending_cex.back()[bits[i]] = values[i];
+		num_cex++;
+	}
+
+	void run_pass()
+	{
+		int n = BitParallelSim::num_words;
+
+		for (int idx : sim.input_bits)
+			for (int k = 0; k < n; k++) {
+				sim.value[idx*n + k] = random_word();
+				sim.undef[idx*n + k] = 0;
+			}
+
+		// counter examples go to the first lanes, all other inputs stay random
+		int num_lanes = std::min(GetSize(pending_cex), 64*n);
+		for (int lane = 0; lane < num_lanes; lane++)
+			for (auto &it : pending_cex[lane]) {
+				int idx = index(it.first);
+				if (idx > 2)
+					sim.set_lane(idx, lane, it.second ? RTLIL::State::S1 : RTLIL::State::S0);
+			}
+		pending_cex.erase(pending_cex.begin(), pending_cex.begin() + num_lanes);
+
+		sim.eval(64*n);
+		pass_values.push_back(sim.value);
+		pass_undefs.push_back(sim.undef);
+	}
+
+	// an input is relevant for a signal if flipping only this input changes the
+	// (defined) value of the signal. this uses the input vectors of the first pass.
+	void find_relevant_inputs(std::map<RTLIL::SigBit, std::set<RTLIL::SigBit>> &relevant_inputs, const std::vector<RTLIL::SigBit> &outputs)
+	{
+		int n = BitParallelSim::num_words;
+		log_assert(!pass_values.empty());
+
+		// cells that are not simulated bit-parallel are evaluated once per lane
+		int64_t cost = 0;
+		for (auto &sc : sim.sim_cells)
+			cost += sc.kind == BitParallelSim::KIND_GENERIC ? 64*n : 1;
+		if (cost * GetSize(sim.input_bits) > 100000000) {
+			if (verbose_level >= 1)
+				log("  Skipping search for relevant inputs using simulation (too expensive).\n");
+			return;
+		}
+
+		std::vector<std::pair<RTLIL::SigBit, int>> out_idx;
+		for (auto &bit : outputs)
+			if (index(bit) > 2)
+				out_idx.push_back(std::pair<RTLIL::SigBit, int>(bit, index(bit)));
+
+		std::map<int, RTLIL::SigBit> input_sigbits;
+		for (auto &it : sim.bit_index)
+			input_sigbits[it.second] = it.first;
+
+		for (int idx : sim.input_bits)
+		{
+			sim.value = pass_values.front();
+			sim.undef = pass_undefs.front();
+			for (int k = 0; k < n; k++)
+				sim.value[idx*n + k] = ~sim.value[idx*n + k];
+			sim.eval(64*n);
+
+			for (auto &it : out_idx)
+				for (int k = 0; k < n; k++) {
+					int i = it.second*n + k;
+					if ((sim.value[i] ^ pass_values[0][i]) & ~sim.undef[i] & ~pass_undefs[0][i]) {
+						relevant_inputs[it.first].insert(input_sigbits.at(idx));
+						break;
+					}
+				}
+		}
+	}
+};
+
 struct FindReducedInputs
 {
 	SigMap &sigmap;
@@ -165,7 +313,7 @@ struct FindReducedInputs
 		pi.insert(pi.end(), pi_set.begin(), pi_set.end());
 	}
 
-	void analyze(std::vector<RTLIL::SigBit> &reduced_inputs, RTLIL::SigBit output, int prec)
+	void analyze(std::vector<RTLIL::SigBit> &reduced_inputs, RTLIL::SigBit output, int prec, const std::set<RTLIL::SigBit> *known_inputs)
 	{
 		if (verbose_level >= 1)
 			log("[%2d%%]  Analyzing input cone for signal %s:\n", prec, log_signal(output));
@@ -187,9 +335,13 @@ struct FindReducedInputs
 		std::set<int> unused_pi_idx;
 
 		for (size_t i = 0; i < pi.size(); i++)
-			unused_pi_idx.insert(i);
+			if (known_inputs == NULL || known_inputs->count(pi[i]) == 0)
+				unused_pi_idx.insert(i);
+
+		if (verbose_level >= 1 && known_inputs != NULL)
+			log("         Found %d relevant inputs using simulation.\n", int(pi.size() - unused_pi_idx.size()));
 
-		while (1)
+		while (!unused_pi_idx.empty())
 		{
 			std::vector<int> model_pi_idx;
 			std::vector<int> model_expr;
@@ -229,6 +381,8 @@ struct PerformReduction
 	SigMap &sigmap;
 	drivers_t &drivers;
 	std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs;
+	FreduceSim *fsim;
+	bool sim_feedback;
 
 	ezDefaultSAT ez;
 	SatGen satgen;
@@ -236,9 +390,14 @@ struct PerformReduction
 	std::vector<int> sat_pi, sat_out, sat_def;
 	std::vector<RTLIL::SigBit> out_bits, pi_bits;
 	std::vector<bool> out_inverted;
-	std::vector<int> out_depth;
+	std::vector<int> out_depth, out_sim_index;
 	int cone_size;
 
+	// results of solve_const() and solve(), turned into equiv_bit_t groups by
+	// finish_const() and finish()
+	std::vector<RTLIL::State> const_values;
+	std::vector<std::vector<int>> groups;
+
 	int register_cone_worker(std::set<RTLIL::Cell*> &celldone, std::map<RTLIL::SigBit, int> &sigdepth, RTLIL::SigBit out)
 	{
 		if (out.wire == NULL)
@@ -267,8 +426,8 @@ struct PerformReduction
 		return sigdepth.at(out);
 	}
 
-	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, std::vector<RTLIL::SigBit> &bits, int cone_size) :
-			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), satgen(&ez, &sigmap), out_bits(bits), cone_size(cone_size)
+	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, std::vector<RTLIL::SigBit> &bits, int cone_size, FreduceSim *fsim) :
+			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), fsim(fsim), sim_feedback(true), satgen(&ez, &sigmap), out_bits(bits), cone_size(cone_size)
 	{
 		satgen.model_undef = true;
 
@@ -277,10 +436,18 @@ struct PerformReduction
 
 		for (auto &bit : bits) {
 			out_depth.push_back(register_cone_worker(celldone, sigdepth, bit));
+			out_sim_index.push_back(fsim ? fsim->index(bit) : -1);
 			sat_out.push_back(satgen.importSigSpec(bit).front());
 			sat_def.push_back(ez.NOT(satgen.importUndefSigSpec(bit).front()));
 		}
+	}
 
+	// find_inverted(), solve_const(), solve() and the methods they call only
+	// work on the SAT solver and on integer indices into out_bits, so they can
+	// run in a worker thread (when not logging anything). all lookups of
+	// RTLIL data are done in the constructor and in finish_const()/finish().
+	void find_inverted()
+	{
 		if (inv_mode && cone_size > 0) {
 			if (!ez.solve(sat_out, out_inverted, ez.expression(ezSAT::OpAnd, sat_def)))
 				log_error("Solving for initial model failed!\n");
@@ -291,22 +458,40 @@ struct PerformReduction
 			out_inverted = std::vector<bool>(sat_out.size(), false);
 	}
 
-	void analyze_const(std::vector<std::vector<equiv_bit_t>> &results, int idx)
+	void solve_const()
 	{
-		if (verbose_level == 1)
-			log("    Finding const value for %s.\n", log_signal(out_bits[idx]));
+		find_inverted();
 
-		bool can_be_set = ez.solve(ez.AND(sat_out[idx], sat_def[idx]));
-		bool can_be_clr = ez.solve(ez.AND(ez.NOT(sat_out[idx]), sat_def[idx]));
-		log_assert(!can_be_set || !can_be_clr);
+		for (size_t idx = 0; idx < out_bits.size(); idx++)
+		{
+			if (verbose_level == 1)
+				log("    Finding const value for %s.\n", log_signal(out_bits[idx]));
+
+			bool can_be_set = ez.solve(ez.AND(sat_out[idx], sat_def[idx]));
+			bool can_be_clr = ez.solve(ez.AND(ez.NOT(sat_out[idx]), sat_def[idx]));
+			log_assert(!can_be_set || !can_be_clr);
+
+			RTLIL::State value = RTLIL::State::Sx;
+			if (can_be_set)
+				value = RTLIL::State::S1;
+			if (can_be_clr)
+				value = RTLIL::State::S0;
+			if (verbose_level == 1)
+				log("      Constant value for this signal: %s\n", log_signal(value));
+
+			const_values.push_back(value);
+		}
+	}
 
-		RTLIL::SigBit value(RTLIL::State::Sx);
-		if (can_be_set)
-			value = RTLIL::State::S1;
-		if (can_be_clr)
-			value = RTLIL::State::S0;
-		if (verbose_level == 1)
-			log("      Constant value for this signal: %s\n", log_signal(value));
+	void finish_const(std::vector<std::vector<equiv_bit_t>> &results)
+	{
+		for (size_t idx = 0; idx < out_bits.size(); idx++)
+			finish_const(results, idx);
+	}
+
+	void finish_const(std::vector<std::vector<equiv_bit_t>> &results, int idx)
+	{
+		RTLIL::SigBit value(const_values.at(idx));
 
 		int result_idx = -1;
 		for (size_t i = 0; i < results.size(); i++) {
@@ -363,13 +548,16 @@ struct PerformReduction
 		std::vector<bool> model;
 
 		modelVars.insert(modelVars.end(), sat_def.begin(), sat_def.end());
-		if (verbose_level >= 2)
+		if (verbose_level >= 2 || fsim)
 			modelVars.insert(modelVars.end(), sat_pi.begin(), sat_pi.end());
 
 		if (ez.solve(modelVars, model, ez.expression(ezSAT::OpOr, sat_set_list), ez.expression(ezSAT::OpOr, sat_clr_list)))
 		{
 			int iter_count = 1;
 
+			if (fsim && sim_feedback)
+				fsim->add_cex(pi_bits, std::vector<bool>(model.begin() + 2*sat_out.size(), model.end()));
+
 			while (1)
 			{
 				sat_set_list.clear();
@@ -476,15 +664,62 @@ struct PerformReduction
 		}
 	}
 
-	void analyze(std::vector<std::vector<equiv_bit_t>> &results, int perc)
+	// split a bucket like a SAT model would, but using the simulation results
+	void sim_split(std::vector<std::vector<int>> &sim_buckets, std::vector<int> &bucket, int word)
 	{
+		for (; bucket.size() > 1 && word < fsim->num_sig_words(); word++)
+		{
+			FreduceSim::word_t any_set = 0, any_clr = 0;
+			for (int idx : bucket) {
+				int sim_idx = out_sim_index[idx];
+				any_set |= fsim->set_word(sim_idx, word, out_inverted[idx]);
+				any_clr |= fsim->clr_word(sim_idx, word, out_inverted[idx]);
+			}
+
+			FreduceSim::word_t lanes = any_set & any_clr;
+			if (lanes == 0)
+				continue;
+
+			FreduceSim::word_t lane = lanes & ~(lanes - 1);
+			std::vector<int> buckets_a, buckets_b;
+
+			for (int idx : bucket) {
+				int sim_idx = out_sim_index[idx];
+				if ((fsim->clr_word(sim_idx, word, out_inverted[idx]) & lane) == 0)
+					buckets_a.push_back(idx);
+				if ((fsim->set_word(sim_idx, word, out_inverted[idx]) & lane) == 0)
+					buckets_b.push_back(idx);
+			}
+
+			sim_split(sim_buckets, buckets_a, word);
+			sim_split(sim_buckets, buckets_b, word);
+			return;
+		}
+
+		if (bucket.size() > 1)
+			sim_buckets.push_back(bucket);
+	}
+
+	void solve(int perc)
+	{
+		find_inverted();
+
 		std::vector<int> bucket;
 		for (size_t i = 0; i < sat_out.size(); i++)
 			bucket.push_back(i);
 
+		std::vector<std::vector<int>> sim_buckets;
+		if (fsim != NULL) {
+			sim_split(sim_buckets, bucket, 0);
+			if (verbose_level >= 1)
+				log("  Simulation split bucket with %d signals into %d candidate buckets.\n", int(bucket.size()), int(sim_buckets.size()));
+		} else
+			sim_buckets.push_back(bucket);
+
 		std::vector<std::set<int>> results_buf;
 		std::map<int, int> results_map;
-		analyze(results_buf, results_map, bucket, stringf("[%2d%%] %d ", perc, cone_size), "");
+		for (auto &sim_bucket : sim_buckets)
+			analyze(results_buf, results_map, sim_bucket, stringf("[%2d%%] %d ", perc, cone_size), "");
 
 		for (auto &r : results_buf)
 		{
@@ -519,6 +754,14 @@ struct PerformReduction
 			for (int idx : undef_slaves)
 				out_depth[idx] = std::numeric_limits<int>::max();
 
+			groups.push_back(std::vector<int>(r.begin(), r.end()));
+		}
+	}
+
+	void finish(std::vector<std::vector<equiv_bit_t>> &results)
+	{
+		for (auto &r : groups)
+		{
 			std::vector<equiv_bit_t> result;
 
 			for (int idx : r) {
@@ -557,10 +800,33 @@ struct FreduceWorker
 	drivers_t drivers;
 	std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> inv_pairs;
 
-	FreduceWorker(RTLIL::Design *design, RTLIL::Module *module) : design(design), module(module), sigmap(module)
+	std::map<RTLIL::SigBit, int> bit_levels;
+	bool found_loop;
+
+	FreduceWorker(RTLIL::Design *design, RTLIL::Module *module) : design(design), module(module), sigmap(module), found_loop(false)
 	{
 	}
 
+	int get_level(RTLIL::SigBit bit)
+	{
+		if (bit.wire == NULL || drivers.count(bit) == 0)
+			return 0;
+
+		auto it = bit_levels.find(bit);
+		if (it != bit_levels.end()) {
+			if (it->second < 0)
+				found_loop = true;
+			return std::max(it->second, 0);
+		}
+
+		bit_levels[bit] = -1;
+		int level = 0;
+		for (auto &b : drivers.at(bit).second)
+			level = std::max(level, get_level(b) + 1);
+		bit_levels[bit] = level;
+		return level;
+	}
+
 	bool find_bit_in_cone(std::set<RTLIL::Cell*> &celldone, RTLIL::SigBit needle, RTLIL::SigBit haystack)
 	{
 		if (needle == haystack)
@@ -582,6 +848,10 @@ struct FreduceWorker
 
 	bool find_bit_in_cone(RTLIL::SigBit needle, RTLIL::SigBit haystack)
 	{
+		// without logic loops a bit can only be in the input cone of bits on a higher level
+		if (!found_loop && needle != haystack && get_level(needle) >= get_level(haystack))
+			return false;
+
 		std::set<RTLIL::Cell*> celldone;
 		return find_bit_in_cone(celldone, needle, haystack);
 	}
@@ -593,8 +863,131 @@ struct FreduceWorker
 		Pass::call(design, stringf("dump -outfile %s %s", filename.c_str(), design->selected_active_module.empty() ? module->name.c_str() : ""));
 	}
 
+#if EZMINISAT_THREADS
+	struct ReductionJob
+	{
+		std::vector<RTLIL::SigBit> *bits;
+		int cone_size, perc;
+		PerformReduction *worker;
+		std::vector<std::vector<equiv_bit_t>> results;
+		bool done;
+	};
+
+	// the SAT problems are created in the main thread and only solved by the worker
+	// threads. RTLIL is not thread safe, not even comparing two SigBits (this copies
+	// IdStrings and changes their reference counts), so the workers only see integer
+	// indices and the results are turned into equiv_bit_t groups in the main thread,
+	// in the order of the buckets.
+	void finish_job(ReductionJob &job)
+	{
+		if (job.cone_size == 0)
+			job.worker->finish_const(job.results);
+		else
+			job.worker->finish(job.results);
+		delete job.worker;
+		job.worker = NULL;
+	}
+
+	void run_parallel(std::map<std::vector<RTLIL::SigBit>, std::vector<RTLIL::SigBit>> &buckets,
+			std::vector<std::vector<equiv_bit_t>> &equiv, FreduceSim *fsim)
+	{
+		std::vector<ReductionJob> jobs;
+		int bucket_count = 0;
+
+		for (auto &bucket : buckets) {
+			bucket_count++;
+			if (bucket.second.size() == 1)
+				continue;
+			ReductionJob job;
+			job.bits = &bucket.second;
+			job.cone_size = bucket.first.size();
+			job.perc = 100 * bucket_count / (buckets.size() + 1);
+			job.worker = NULL;
+			job.done = false;
+			jobs.push_back(job);
+		}
+
+		std::mutex mutex;
+		std::condition_variable cond;
+		int num_built = 0, num_started = 0, num_finished = 0;
+		bool all_built = false;
+
+		std::vector<double> thread_sec(num_threads);
+		std::vector<int> thread_jobs(num_threads);
+
+		auto worker_thread = [&](int thread_idx) {
+			while (1) {
+				int idx;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cond.wait(lock, [&]() { return num_started < num_built || all_built; });
+					if (num_started == num_built)
+						return;
+					idx = num_started++;
+				}
+				ReductionJob &job = jobs[idx];
+				auto start_time = std::chrono::steady_clock::now();
+				if (job.cone_size == 0)
+					job.worker->solve_const();
+				else
+					job.worker->solve(job.perc);
+				thread_sec[thread_idx] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+				thread_jobs[thread_idx]++;
+				std::lock_guard<std::mutex> lock(mutex);
+				job.done = true;
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < num_threads; i++)
+			threads.push_back(std::thread(worker_thread, i));
+
+		for (int idx = 0; idx < GetSize(jobs); idx++)
+		{
+			ReductionJob &job = jobs[idx];
+
+			if (job.cone_size == 0)
+				log("  Finding const values for bucket %s.\n", log_signal(*job.bits));
+			else
+				log("  Trying to shatter bucket %s.\n", log_signal(*job.bits));
+
+			PerformReduction *worker = new PerformReduction(sigmap, drivers, inv_pairs, *job.bits, job.cone_size, job.cone_size ? fsim : NULL);
+			worker->sim_feedback = false;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			job.worker = worker;
+			num_built++;
+			cond.notify_one();
+
+			// collect the results of finished jobs and free their SAT problems early
+			while (num_finished < idx && jobs[num_finished].done)
+				finish_job(jobs[num_finished++]);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			all_built = true;
+			cond.notify_all();
+		}
+		for (auto &thread : threads)
+			thread.join();
+
+		while (num_finished < GetSize(jobs))
+			finish_job(jobs[num_finished++]);
+
+		for (auto &job : jobs)
+			equiv.insert(equiv.end(), job.results.begin(), job.results.end());
+
+		for (int i = 0; i < num_threads; i++)
+			log("  Thread %d: solved %d buckets in %.2f sec.\n", i, thread_jobs[i], thread_sec[i]);
+	}
+#endif
+
 	int run()
 	{
+		// limit for the number of 64-bit signature words per signal
+		const int max_sim_words = 64;
+
 		log("Running functional reduction on module %s:\n", RTLIL::id2cstr(module->name));
 
 		CellTypes ct;
@@ -628,6 +1021,33 @@ struct FreduceWorker
 				inv_pairs.insert(std::pair<RTLIL::SigBit, RTLIL::SigBit>(sigmap(it.second->getPort("\\A")), sigmap(it.second->getPort("\\Y"))));
 		}
 
+		FreduceSim *fsim = NULL;
+		std::map<RTLIL::SigBit, std::set<RTLIL::SigBit>> relevant_inputs;
+
+		if (sim_mode)
+		{
+			std::set<RTLIL::SigBit> sim_inputs;
+			std::vector<RTLIL::SigBit> sim_outputs;
+			for (auto &it : drivers) {
+				sim_outputs.push_back(it.first);
+				for (auto &bit : it.second.second)
+					if (bit.wire != NULL && drivers.count(bit) == 0)
+						sim_inputs.insert(bit);
+			}
+
+			fsim = new FreduceSim(module, std::vector<RTLIL::SigBit>(sim_inputs.begin(), sim_inputs.end()), sim_outputs);
+			if (!fsim->sim.fail_reason.empty()) {
+				log("  Can't simulate module: %s. Using SAT solver only.\n", fsim->sim.fail_reason.c_str());
+				delete fsim;
+				fsim = NULL;
+			} else {
+				fsim->run_pass();
+				fsim->find_relevant_inputs(relevant_inputs, sim_outputs);
+				log("  Simulated %d random input vectors for %d cells (%d inputs).\n", BitParallelSim::num_lanes,
+						GetSize(fsim->sim.sim_cells), GetSize(sim_inputs));
+			}
+		}
+
 		int bits_count = 0;
 		int bits_full_count = 0;
 		std::map<std::vector<RTLIL::SigBit>, std::vector<RTLIL::SigBit>> buckets;
@@ -646,7 +1066,8 @@ struct FreduceWorker
 			FindReducedInputs infinder(sigmap, drivers);
 			for (auto &bit : batch) {
 				std::vector<RTLIL::SigBit> inputs;
-				infinder.analyze(inputs, bit, 100 * bits_full_count / bits_full_total);
+				infinder.analyze(inputs, bit, 100 * bits_full_count / bits_full_total,
+						fsim ? &relevant_inputs[bit] : NULL);
 				buckets[inputs].push_back(bit);
 				bits_full_count++;
 				bits_count++;
@@ -656,6 +1077,12 @@ struct FreduceWorker
 
 		int bucket_count = 0;
 		std::vector<std::vector<equiv_bit_t>> equiv;
+
+#if EZMINISAT_THREADS
+		if (num_threads > 1 && verbose_level == 0)
+			run_parallel(buckets, equiv, fsim);
+		else
+#endif
 		for (auto &bucket : buckets)
 		{
 			bucket_count++;
@@ -663,18 +1090,32 @@ struct FreduceWorker
 			if (bucket.second.size() == 1)
 				continue;
 
+			// simulate the counter examples found for the previous buckets
+			if (fsim && !fsim->pending_cex.empty() && fsim->num_sig_words() < max_sim_words)
+				fsim->run_pass();
+
 			if (bucket.first.size() == 0) {
 				log("  Finding const values for bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
-				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				for (size_t idx = 0; idx < bucket.second.size(); idx++)
-					worker.analyze_const(equiv, idx);
+				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size(), NULL);
+				worker.solve_const();
+				worker.finish_const(equiv);
 			} else {
 				log("  Trying to shatter bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
-				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				worker.analyze(equiv, 100 * bucket_count / (buckets.size() + 1));
+				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size(), fsim);
+				worker.solve(100 * bucket_count / (buckets.size() + 1));
+				worker.finish(equiv);
 			}
 		}
 
+		if (fsim) {
+			log("  Used %d simulation vectors, including %d counter examples from the SAT solver.\n",
+					fsim->num_sig_words() * 64, fsim->num_cex - GetSize(fsim->pending_cex));
+			delete fsim;
+		}
+
+		for (auto &it : drivers)
+			get_level(it.first);
+
 		std::map<RTLIL::SigBit, int> bitusage;
 		module->rewrite_sigspecs(CountBitUsage(sigmap, bitusage));
 
@@ -764,6 +1205,17 @@ struct FreducePass : public Pass {
 		log("    -inv\n");
 		log("        enable explicit handling of inverted signals\n");
 		log("\n");
+		log("    -threads <N>\n");
+		log("        analyze the candidate groups in <N> parallel threads. with more than\n");
+		log("        one thread the SAT counter examples are not fed back into the simulation,\n");
+		log("        so the result can differ from the one of \"-threads 1\" (the default),\n");
+		log("        but does not depend on the number of threads otherwise. (not used with\n");
+		log("        -v and -vv.)\n");
+		log("\n");
+		log("    -nosim\n");
+		log("        do not use random simulation to find relevant inputs and to split\n");
+		log("        candidate groups before calling the SAT solver.\n");
+		log("\n");
 		log("    -stop <n>\n");
 		log("        stop after <n> reduction operations. this is mostly used for\n");
 		log("        debugging the freduce command itself.\n");
@@ -785,6 +1237,8 @@ struct FreducePass : public Pass {
 		reduce_stop_at = 0;
 		verbose_level = 0;
 		inv_mode = false;
+		sim_mode = true;
+		num_threads = 1;
 		dump_prefix = std::string();
 
 		log_header("Executing FREDUCE pass (perform functional reduction).\n");
@@ -803,6 +1257,19 @@ struct FreducePass : public Pass {
 				inv_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-threads" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+#if !EZMINISAT_THREADS
+				if (num_threads > 1)
+					log_warning("This version of yosys is built without thread support, ignoring `-threads %d'.\n", num_threads);
+				num_threads = 1;
+#endif
+				continue;
+			}
+			if (args[argidx] == "-nosim") {
+				sim_mode = false;
+				continue;
+			}
 			if (args[argidx] == "-stop" && argidx+1 < args.size()) {
 				reduce_stop_at = atoi(args[++argidx].c_str());
 				continue;
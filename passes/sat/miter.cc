@@ -29,6 +29,7 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 	bool flag_ignore_gold_x = false;
 	bool flag_make_outputs = false;
 	bool flag_make_outcmp = false;
+	bool flag_make_outcmp_bits = false;
 	bool flag_make_assert = false;
 	bool flag_flatten = false;
 
@@ -49,6 +50,11 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 			flag_make_outcmp = true;
 			continue;
 		}
+		if (args[argidx] == "-make_outcmp_bits") {
+			flag_make_outcmp = true;
+			flag_make_outcmp_bits = true;
+			continue;
+		}
 		if (args[argidx] == "-make_assert") {
 			flag_make_assert = true;
 			continue;
@@ -147,7 +153,7 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 			gold_cell->setPort(w1->name, w2_gold);
 			gate_cell->setPort(w1->name, w2_gate);
 
-			RTLIL::SigSpec this_condition;
+			RTLIL::SigSpec this_condition, gold_cmp = w2_gold, gate_cmp = w2_gate;
 
 			if (flag_ignore_gold_x)
 			{
@@ -187,34 +193,29 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 				or_gate_cell->setPort("\\B", gold_x);
 				or_gate_cell->setPort("\\Y", gate_masked);
 
-				RTLIL::Cell *eq_cell = miter_module->addCell(NEW_ID, "$eqx");
-				eq_cell->parameters["\\A_WIDTH"] = w2_gold->width;
-				eq_cell->parameters["\\B_WIDTH"] = w2_gate->width;
-				eq_cell->parameters["\\Y_WIDTH"] = 1;
-				eq_cell->parameters["\\A_SIGNED"] = 0;
-				eq_cell->parameters["\\B_SIGNED"] = 0;
-				eq_cell->setPort("\\A", gold_masked);
-				eq_cell->setPort("\\B", gate_masked);
-				eq_cell->setPort("\\Y", miter_module->addWire(NEW_ID));
-				this_condition = eq_cell->getPort("\\Y");
+				gold_cmp = gold_masked;
+				gate_cmp = gate_masked;
 			}
-			else
+
+			// with -make_outcmp_bits there is one compare cell for each bit
+			int cmp_width = flag_make_outcmp_bits ? 1 : w2_gold->width;
+			for (int i = 0; i < w2_gold->width; i += cmp_width)
 			{
 				RTLIL::Cell *eq_cell = miter_module->addCell(NEW_ID, "$eqx");
-				eq_cell->parameters["\\A_WIDTH"] = w2_gold->width;
-				eq_cell->parameters["\\B_WIDTH"] = w2_gate->width;
+				eq_cell->parameters["\\A_WIDTH"] = cmp_width;
+				eq_cell->parameters["\\B_WIDTH"] = cmp_width;
 				eq_cell->parameters["\\Y_WIDTH"] = 1;
 				eq_cell->parameters["\\A_SIGNED"] = 0;
 				eq_cell->parameters["\\B_SIGNED"] = 0;
-				eq_cell->setPort("\\A", w2_gold);
-				eq_cell->setPort("\\B", w2_gate);
+				eq_cell->setPort("\\A", gold_cmp.extract(i, cmp_width));
+				eq_cell->setPort("\\B", gate_cmp.extract(i, cmp_width));
 				eq_cell->setPort("\\Y", miter_module->addWire(NEW_ID));
-				this_condition = eq_cell->getPort("\\Y");
+				this_condition.append(eq_cell->getPort("\\Y"));
 			}
 
 			if (flag_make_outcmp)
 			{
-				RTLIL::Wire *w_cmp = miter_module->addWire("\\cmp_" + RTLIL::unescape_id(w1->name));
+				RTLIL::Wire *w_cmp = miter_module->addWire("\\cmp_" + RTLIL::unescape_id(w1->name), this_condition.size());
 				w_cmp->port_output = true;
 				miter_module->connect(RTLIL::SigSig(w_cmp, this_condition));
 			}
@@ -284,6 +285,11 @@ struct MiterPass : public Pass {
 		log("    -make_outcmp\n");
 		log("        also create a cmp_* output for each gold/gate output pair.\n");
 		log("\n");
+		log("    -make_outcmp_bits\n");
+		log("        like -make_outcmp, but compare the outputs bit by bit, so that each\n");
+		log("        cmp_* output has one bit for each output bit. Use 'sat -prove-each'\n");
+		log("        to prove each output (bit) in its own SAT problem.\n");
+		log("\n");
 		log("    -make_assert\n");
 		log("        also create an 'assert' cell that checks if trigger is always low.\n");
 		log("\n");
@@ -32,17 +32,47 @@
 #include <algorithm>
 #include <errno.h>
 #include <string.h>
+#include <chrono>
+#include <sstream>
+
+#if EZMINISAT_THREADS
+#  include <atomic>
+#  include <condition_variable>
+#  include <mutex>
+#  include <thread>
+#endif
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// the selected cells of a module and the cell driving each signal bit, built once
+// for all -prove-each jobs so that each cone-of-influence walk only visits the cone
+struct SatDriverIndex
+{
+	std::vector<RTLIL::Cell*> cells;
+	std::map<RTLIL::SigBit, int> bit_drivers;
+
+	SatDriverIndex(RTLIL::Design *design, RTLIL::Module *module, SigMap &sigmap, CellTypes &ct)
+	{
+		for (auto &c : module->cells_)
+			if (design->selected(module, c.second)) {
+				for (auto &p : c.second->connections())
+					if (ct.cell_output(c.second->type, p.first))
+						for (auto bit : sigmap(p.second))
+							bit_drivers[bit] = GetSize(cells);
+				cells.push_back(c.second);
+			}
+	}
+};
+
 struct SatHelper
 {
 	RTLIL::Design *design;
 	RTLIL::Module *module;
 
 	ezDefaultSAT ez;
-	SigMap sigmap;
+	SigMap local_sigmap;
+	SigMap &sigmap;
 	CellTypes ct;
 	SatGen satgen;
 
@@ -64,8 +94,23 @@ struct SatHelper
 	int max_timestep, timeout;
 	bool gotTimeout;
 
-	SatHelper(RTLIL::Design *design, RTLIL::Module *module, bool enable_undef) :
-		design(design), module(module), sigmap(module), ct(design), satgen(&ez, &sigmap)
+	// external DIMACS solver (empty = use the built-in solver)
+	std::string solver_cmd;
+
+	// per-step statistics for temporal induction
+	double solve_sec;
+	int reported_clauses;
+
+	// cone-of-influence reduction (used by -prove-each)
+	bool enable_cone;
+	std::vector<RTLIL::Cell*> cone_cells;
+
+	// don't log the setup of the problem (used by -prove-each for all but the first job)
+	bool quiet;
+
+	SatHelper(RTLIL::Design *design, RTLIL::Module *module, bool enable_undef, SigMap *shared_sigmap = NULL) :
+		design(design), module(module), local_sigmap(shared_sigmap ? NULL : module),
+		sigmap(shared_sigmap ? *shared_sigmap : local_sigmap), ct(design), satgen(&ez, &sigmap)
 	{
 		this->enable_undef = enable_undef;
 		satgen.model_undef = enable_undef;
@@ -76,6 +121,10 @@ struct SatHelper
 		max_timestep = -1;
 		timeout = 0;
 		gotTimeout = false;
+		solve_sec = 0;
+		reported_clauses = 0;
+		enable_cone = false;
+		quiet = false;
 	}
 
 	void check_undef_enabled(const RTLIL::SigSpec &sig)
@@ -91,7 +140,8 @@ struct SatHelper
 
 	void setup_init()
 	{
-		log ("\nSetting up initial state:\n");
+		if (!quiet)
+			log ("\nSetting up initial state:\n");
 
 		RTLIL::SigSpec big_lhs, big_rhs;
 
@@ -116,10 +166,12 @@ struct SatHelper
 			}
 
 			if (removed_bits.size())
-				log_warning("ignoring initial value on non-register: %s\n", log_signal(removed_bits));
+				if (!quiet)
+					log_warning("ignoring initial value on non-register: %s\n", log_signal(removed_bits));
 
 			if (lhs.size()) {
-				log("Import set-constraint from init attribute: %s = %s\n", log_signal(lhs), log_signal(rhs));
+				if (!quiet)
+					log("Import set-constraint from init attribute: %s = %s\n", log_signal(lhs), log_signal(rhs));
 				big_lhs.remove2(lhs, &big_rhs);
 				big_lhs.append(lhs);
 				big_rhs.append(rhs);
@@ -141,7 +193,8 @@ struct SatHelper
 				log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
 					s.first.c_str(), log_signal(lhs), lhs.size(), s.second.c_str(), log_signal(rhs), rhs.size());
 
-			log("Import set-constraint: %s = %s\n", log_signal(lhs), log_signal(rhs));
+			if (!quiet)
+				log("Import set-constraint: %s = %s\n", log_signal(lhs), log_signal(rhs));
 			big_lhs.remove2(lhs, &big_rhs);
 			big_lhs.append(lhs);
 			big_rhs.append(rhs);
@@ -173,21 +226,25 @@ struct SatHelper
 		}
 
 		if (big_lhs.size() == 0) {
-			log("No constraints for initial state found.\n\n");
+			if (!quiet)
+				log("No constraints for initial state found.\n\n");
 			return;
 		}
 
-		log("Final constraint equation: %s = %s\n\n", log_signal(big_lhs), log_signal(big_rhs));
+		if (!quiet)
+			log("Final constraint equation: %s = %s\n\n", log_signal(big_lhs), log_signal(big_rhs));
 		check_undef_enabled(big_lhs), check_undef_enabled(big_rhs);
 		ez.assume(satgen.signals_eq(big_lhs, big_rhs, 1));
 	}
 
 	void setup(int timestep = -1)
 	{
-		if (timestep > 0)
-			log ("\nSetting up time step %d:\n", timestep);
-		else
-			log ("\nSetting up SAT problem:\n");
+		if (!quiet) {
+			if (timestep > 0)
+				log ("\nSetting up time step %d:\n", timestep);
+			else
+				log ("\nSetting up SAT problem:\n");
+		}
 
 		if (timestep > max_timestep)
 			max_timestep = timestep;
@@ -209,7 +266,8 @@ struct SatHelper
 				log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
 					s.first.c_str(), log_signal(lhs), lhs.size(), s.second.c_str(), log_signal(rhs), rhs.size());
 
-			log("Import set-constraint: %s = %s\n", log_signal(lhs), log_signal(rhs));
+			if (!quiet)
+				log("Import set-constraint: %s = %s\n", log_signal(lhs), log_signal(rhs));
 			big_lhs.remove2(lhs, &big_rhs);
 			big_lhs.append(lhs);
 			big_rhs.append(rhs);
@@ -230,7 +288,8 @@ struct SatHelper
 				log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
 					s.first.c_str(), log_signal(lhs), lhs.size(), s.second.c_str(), log_signal(rhs), rhs.size());
 
-			log("Import set-constraint for this timestep: %s = %s\n", log_signal(lhs), log_signal(rhs));
+			if (!quiet)
+				log("Import set-constraint for this timestep: %s = %s\n", log_signal(lhs), log_signal(rhs));
 			big_lhs.remove2(lhs, &big_rhs);
 			big_lhs.append(lhs);
 			big_rhs.append(rhs);
@@ -244,11 +303,13 @@ struct SatHelper
 				log_cmd_error("Failed to parse lhs set expression `%s'.\n", s.c_str());
 			show_signal_pool.add(sigmap(lhs));
 
-			log("Import unset-constraint for this timestep: %s\n", log_signal(lhs));
+			if (!quiet)
+				log("Import unset-constraint for this timestep: %s\n", log_signal(lhs));
 			big_lhs.remove2(lhs, &big_rhs);
 		}
 
-		log("Final constraint equation: %s = %s\n", log_signal(big_lhs), log_signal(big_rhs));
+		if (!quiet)
+			log("Final constraint equation: %s = %s\n", log_signal(big_lhs), log_signal(big_rhs));
 		check_undef_enabled(big_lhs), check_undef_enabled(big_rhs);
 		ez.assume(satgen.signals_eq(big_lhs, big_rhs, timestep));
 
@@ -307,7 +368,8 @@ struct SatHelper
 
 		for (int t = 0; t < 3; t++)
 		for (auto &sig : sets_def_undef[t]) {
-			log("Import %s constraint for this timestep: %s\n", t == 0 ? "def" : t == 1 ? "any_undef" : "all_undef", log_signal(sig));
+			if (!quiet)
+				log("Import %s constraint for this timestep: %s\n", t == 0 ? "def" : t == 1 ? "any_undef" : "all_undef", log_signal(sig));
 			std::vector<int> undef_sig = satgen.importUndefSigSpec(sig, timestep);
 			if (t == 0)
 				ez.assume(ez.NOT(ez.expression(ezSAT::OpOr, undef_sig)));
@@ -317,21 +379,103 @@ struct SatHelper
 				ez.assume(ez.expression(ezSAT::OpAnd, undef_sig));
 		}
 
+		std::vector<RTLIL::Cell*> selected_cells;
+		if (!enable_cone)
+			for (auto &c : module->cells_)
+				if (design->selected(module, c.second))
+					selected_cells.push_back(c.second);
+
 		int import_cell_counter = 0;
-		for (auto &c : module->cells_)
-			if (design->selected(module, c.second)) {
-				// log("Import cell: %s\n", RTLIL::id2cstr(c.first));
-				if (satgen.importCell(c.second, timestep)) {
-					for (auto &p : c.second->connections())
-						if (ct.cell_output(c.second->type, p.first))
-							show_drivers.insert(sigmap(p.second), c.second);
-					import_cell_counter++;
-				} else if (ignore_unknown_cells)
-					log_warning("Failed to import cell %s (type %s) to SAT database.\n", RTLIL::id2cstr(c.first), RTLIL::id2cstr(c.second->type));
-				else
-					log_error("Failed to import cell %s (type %s) to SAT database.\n", RTLIL::id2cstr(c.first), RTLIL::id2cstr(c.second->type));
+		for (auto cell : enable_cone ? cone_cells : selected_cells) {
+			// log("Import cell: %s\n", RTLIL::id2cstr(cell->name));
+			if (satgen.importCell(cell, timestep)) {
+				for (auto &p : cell->connections())
+					if (ct.cell_output(cell->type, p.first))
+						show_drivers.insert(sigmap(p.second), cell);
+				import_cell_counter++;
+			} else if (!ignore_unknown_cells)
+				log_error("Failed to import cell %s (type %s) to SAT database.\n", RTLIL::id2cstr(cell->name), RTLIL::id2cstr(cell->type));
+			else if (!quiet)
+				log_warning("Failed to import cell %s (type %s) to SAT database.\n", RTLIL::id2cstr(cell->name), RTLIL::id2cstr(cell->type));
 		}
-		log("Imported %d cells to SAT database.\n", import_cell_counter);
+		if (!quiet)
+			log("Imported %d cells to SAT database.\n", import_cell_counter);
+	}
+
+	void setup_cone(RTLIL::SigSpec sig, const SatDriverIndex &index)
+	{
+		// the cone must also contain everything that is constrained or shown,
+		// otherwise constraints on internal signals would be lost
+		std::vector<std::string> exprs = shows;
+		for (auto &s : sets)
+			exprs.push_back(s.first), exprs.push_back(s.second);
+		for (auto &it : sets_at)
+			for (auto &s : it.second)
+				exprs.push_back(s.first), exprs.push_back(s.second);
+		for (auto &s : sets_init)
+			exprs.push_back(s.first);
+		exprs.insert(exprs.end(), sets_def.begin(), sets_def.end());
+		exprs.insert(exprs.end(), sets_any_undef.begin(), sets_any_undef.end());
+		exprs.insert(exprs.end(), sets_all_undef.begin(), sets_all_undef.end());
+		for (auto it : {&sets_def_at, &sets_any_undef_at, &sets_all_undef_at})
+			for (auto &it2 : *it)
+				exprs.insert(exprs.end(), it2.second.begin(), it2.second.end());
+
+		for (auto &expr : exprs) {
+			RTLIL::SigSpec expr_sig;
+			if (RTLIL::SigSpec::parse_sel(expr_sig, design, module, expr))
+				sig.append(expr_sig);
+		}
+
+		std::set<int> cone;
+		std::set<RTLIL::SigBit> visited;
+		std::vector<RTLIL::SigBit> queue;
+		for (auto bit : sigmap(sig))
+			if (bit.wire != NULL && visited.insert(bit).second)
+				queue.push_back(bit);
+
+		while (!queue.empty())
+		{
+			RTLIL::SigBit bit = queue.back();
+			queue.pop_back();
+
+			auto it = index.bit_drivers.find(bit);
+			if (it == index.bit_drivers.end() || !cone.insert(it->second).second)
+				continue;
+
+			RTLIL::Cell *cell = index.cells.at(it->second);
+			for (auto &p : cell->connections())
+				if (!ct.cell_output(cell->type, p.first))
+					for (auto in_bit : sigmap(p.second))
+						if (in_bit.wire != NULL && visited.insert(in_bit).second)
+							queue.push_back(in_bit);
+		}
+
+		// keep the cells in module order, so that the problem does not depend on the walk
+		cone_cells.clear();
+		for (int idx : cone)
+			cone_cells.push_back(index.cells.at(idx));
+		enable_cone = true;
+	}
+
+	int setup_proof_sig(const RTLIL::SigSpec &lhs, const RTLIL::SigSpec &rhs, bool proof_x, int timestep = -1)
+	{
+		if (!proof_x) {
+			check_undef_enabled(lhs), check_undef_enabled(rhs);
+			return satgen.signals_eq(lhs, rhs, timestep);
+		}
+
+		std::vector<int> value_lhs = satgen.importDefSigSpec(lhs, timestep);
+		std::vector<int> value_rhs = satgen.importDefSigSpec(rhs, timestep);
+
+		std::vector<int> undef_lhs = satgen.importUndefSigSpec(lhs, timestep);
+		std::vector<int> undef_rhs = satgen.importUndefSigSpec(rhs, timestep);
+
+		std::vector<int> prove_bits;
+		for (size_t i = 0; i < value_lhs.size(); i++)
+			prove_bits.push_back(ez.OR(undef_lhs.at(i), ez.AND(ez.NOT(undef_rhs.at(i)), ez.NOT(ez.XOR(value_lhs.at(i), value_rhs.at(i))))));
+
+		return ez.expression(ezSAT::OpAnd, prove_bits);
 	}
 
 	int setup_proof(int timestep = -1)
@@ -365,8 +509,7 @@ struct SatHelper
 			}
 
 			log("Final proof equation: %s = %s\n", log_signal(big_lhs), log_signal(big_rhs));
-			check_undef_enabled(big_lhs), check_undef_enabled(big_rhs);
-			prove_bits.push_back(satgen.signals_eq(big_lhs, big_rhs, timestep));
+			prove_bits.push_back(setup_proof_sig(big_lhs, big_rhs, false, timestep));
 		}
 
 		if (prove_x.size() > 0)
@@ -393,15 +536,7 @@ struct SatHelper
 			}
 
 			log("Final proof-x equation: %s = %s\n", log_signal(big_lhs), log_signal(big_rhs));
-
-			std::vector<int> value_lhs = satgen.importDefSigSpec(big_lhs, timestep);
-			std::vector<int> value_rhs = satgen.importDefSigSpec(big_rhs, timestep);
-
-			std::vector<int> undef_lhs = satgen.importUndefSigSpec(big_lhs, timestep);
-			std::vector<int> undef_rhs = satgen.importUndefSigSpec(big_rhs, timestep);
-
-			for (size_t i = 0; i < value_lhs.size(); i++)
-				prove_bits.push_back(ez.OR(undef_lhs.at(i), ez.AND(ez.NOT(undef_rhs.at(i)), ez.NOT(ez.XOR(value_lhs.at(i), value_rhs.at(i))))));
+			prove_bits.push_back(setup_proof_sig(big_lhs, big_rhs, true, timestep));
 		}
 
 		if (prove_asserts) {
@@ -426,22 +561,65 @@ struct SatHelper
 	{
 		log_assert(gotTimeout == false);
 		ez.setSolverTimeout(timeout);
-		bool success = ez.solve(modelExpressions, modelValues, assumptions);
+		auto start_time = std::chrono::steady_clock::now();
+		bool success = solver_cmd.empty() ? ez.solve(modelExpressions, modelValues, assumptions) :
+				solve_external(assumptions);
+		solve_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
 		if (ez.getSolverTimoutStatus())
 			gotTimeout = true;
 		return success;
 	}
 
-	bool solve(int a = 0, int b = 0, int c = 0, int d = 0, int e = 0, int f = 0)
+	bool solve_external(const std::vector<int> &assumptions)
 	{
-		log_assert(gotTimeout == false);
-		ez.setSolverTimeout(timeout);
-		bool success = ez.solve(modelExpressions, modelValues, a, b, c, d, e, f);
+		// the cnf is never consumed on this path, so the complete problem is
+		// written again for each query and the external solver starts from scratch
+		for (int id : modelExpressions)
+			ez.bind(id);
+
+		std::string tempdir_name = make_temp_dir("/tmp/yosys-sat-XXXXXX");
+		std::string cnf_file_name = tempdir_name + "/problem.cnf";
+
+		FILE *f = fopen(cnf_file_name.c_str(), "w");
+		if (f == NULL)
+			log_error("Can't open temporary file `%s' for writing: %s\n", cnf_file_name.c_str(), strerror(errno));
+		ez.printDIMACS(f, assumptions);
+		fclose(f);
+
+		std::string command = stringf("%s %s", solver_cmd.c_str(), cnf_file_name.c_str());
+		log("Running external SAT solver: %s (%d variables, %d clauses)\n", command.c_str(),
+				ez.numCnfVariables(), ez.numCnfClauses() + int(assumptions.size()));
+
+		std::stringstream output;
+		int ret = run_command(command, [&](const std::string &line) { output << line; });
+		if (ret < 0)
+			log_error("Can't execute external SAT solver `%s'.\n", command.c_str());
+
+		bool success = ez.readModel(output, modelExpressions, modelValues);
 		if (ez.getSolverTimoutStatus())
-			gotTimeout = true;
+			log_warning("External SAT solver did not report a result (exit code %d).\n", ret);
+
+		remove_directory(tempdir_name);
 		return success;
 	}
 
+	bool solve(int a = 0, int b = 0, int c = 0, int d = 0, int e = 0, int f = 0)
+	{
+		std::vector<int> assumptions;
+		for (int id : {a, b, c, d, e, f})
+			if (id != 0)
+				assumptions.push_back(id);
+		return solve(assumptions);
+	}
+
+	void log_step_stats(const char *phase, double setup_sec)
+	{
+		int clauses = ez.numCnfClauses();
+		log("%s Setup took %.2f sec, solving %.2f sec. Added %d clauses in this step (%d clauses, %d variables total).\n",
+				phase, setup_sec, solve_sec, clauses - reported_clauses, clauses, ez.numCnfVariables());
+		reported_clauses = clauses;
+	}
+
 	struct ModelBlockInfo {
 		int timestep, offset, width;
 		std::string description;
@@ -767,6 +945,16 @@ struct SatHelper
 	}
 };
 
+struct ProveEachJob
+{
+	RTLIL::SigSpec lhs, rhs;
+	bool proof_x;
+	SatHelper *helper;
+	int property, num_cells;
+	double setup_sec, solve_sec;
+	enum { PENDING, RUNNING, PROVEN, FAILED, TIMEOUT, ABORTED } status;
+};
+
 void print_proof_failed()
 {
 	log("\n");
@@ -928,6 +1116,32 @@ struct SatPass : public Pass {
 		log("    -timeout <N>\n");
 		log("        Maximum number of seconds a single SAT instance may take.\n");
 		log("\n");
+		log("    -portfolio <N>\n");
+		log("        Run N differently configured SAT solvers (random seeds, restart\n");
+		log("        strategies, with and without preprocessing) on each SAT instance in\n");
+		log("        parallel threads and use the result of the first one to finish.\n");
+		log("\n");
+		log("    -prove-each <N>\n");
+		log("        Prove each bit of the -prove and -prove-x expressions separately,\n");
+		log("        using up to <N> parallel threads. Each bit is checked in its own SAT\n");
+		log("        problem that only contains the cells in the cone of influence of that\n");
+		log("        bit (and of the -set and -show signals). The status and time of each\n");
+		log("        proof is reported, and no new proofs are started after the first\n");
+		log("        counter example has been found. For example, to check each output of\n");
+		log("        a miter circuit separately:\n");
+		log("\n");
+		log("            miter -equiv -flatten -make_outcmp_bits gold gate miter\n");
+		log("            select -set cmp miter/w:cmp_*\n");
+		log("            sat -verify -prove-each 4 -prove @cmp ~0 miter\n");
+		log("\n");
+		log("    -solver <cmd>\n");
+		log("        Solve the SAT instances with an external DIMACS solver instead of the\n");
+		log("        built-in solver. The problem is written to a temporary file and <cmd>\n");
+		log("        is called with the file name as last argument. The solver must print\n");
+		log("        an 's SATISFIABLE' or 's UNSATISFIABLE' line and the model in 'v'\n");
+		log("        lines (SAT competition output format). A missing result line is\n");
+		log("        treated as a timeout. The -timeout option does not apply here.\n");
+		log("\n");
 		log("    -verify\n");
 		log("        Return an error and stop the synthesis script if the proof fails.\n");
 		log("\n");
@@ -947,12 +1161,12 @@ struct SatPass : public Pass {
 		std::map<int, std::vector<std::pair<std::string, std::string>>> sets_at;
 		std::map<int, std::vector<std::string>> unsets_at, sets_def_at, sets_any_undef_at, sets_all_undef_at;
 		std::vector<std::string> shows, sets_def, sets_any_undef, sets_all_undef;
-		int loopcount = 0, seq_len = 0, maxsteps = 0, initsteps = 0, timeout = 0, prove_skip = 0;
+		int loopcount = 0, seq_len = 0, maxsteps = 0, initsteps = 0, timeout = 0, prove_skip = 0, portfolio = 1, prove_each = 0;
 		bool verify = false, fail_on_timeout = false, enable_undef = false, set_def_inputs = false;
 		bool ignore_div_by_zero = false, set_init_undef = false, set_init_zero = false, max_undef = false;
 		bool tempinduct = false, prove_asserts = false, show_inputs = false, show_outputs = false;
 		bool ignore_unknown_cells = false, falsify = false, tempinduct_def = false, set_init_def = false;
-		std::string vcd_file_name, cnf_file_name;
+		std::string vcd_file_name, cnf_file_name, solver_cmd;
 
 		log_header("Executing SAT pass (solving SAT problems in the circuit).\n");
 
@@ -984,6 +1198,14 @@ struct SatPass : public Pass {
 				timeout = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-portfolio" && argidx+1 < args.size()) {
+				portfolio = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-solver" && argidx+1 < args.size()) {
+				solver_cmd = args[++argidx];
+				continue;
+			}
 			if (args[argidx] == "-max" && argidx+1 < args.size()) {
 				loopcount = atoi(args[++argidx].c_str());
 				continue;
@@ -1061,6 +1283,10 @@ struct SatPass : public Pass {
 				prove_asserts = true;
 				continue;
 			}
+			if (args[argidx] == "-prove-each" && argidx+1 < args.size()) {
+				prove_each = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			if (args[argidx] == "-prove-skip" && argidx+1 < args.size()) {
 				prove_skip = atoi(args[++argidx].c_str());
 				continue;
@@ -1166,6 +1392,13 @@ struct SatPass : public Pass {
 		if (prove_skip >= seq_len && prove_skip > 0)
 			log_cmd_error("The value of -prove-skip must be smaller than the one of -seq.\n");
 
+		if (prove_each) {
+			if (!prove.size() && !prove_x.size())
+				log_cmd_error("Got -prove-each but nothing to prove!\n");
+			if (tempinduct || prove_asserts || loopcount != 0 || max_undef || !solver_cmd.empty() || !cnf_file_name.empty())
+				log_cmd_error("The options -tempinduct, -prove-asserts, -all, -max, -max_undef, -solver, and -dump_cnf are not supported with -prove-each!\n");
+		}
+
 		if (set_init_undef + set_init_zero + set_init_def > 1)
 			log_cmd_error("The options -set-init-undef, -set-init-def, and -set-init-zero are exclusive!\n");
 
@@ -1203,6 +1436,8 @@ struct SatPass : public Pass {
 			basecase.unsets_at = unsets_at;
 			basecase.shows = shows;
 			basecase.timeout = timeout;
+			basecase.ez.setPortfolioSize(portfolio);
+			basecase.solver_cmd = solver_cmd;
 			basecase.sets_def = sets_def;
 			basecase.sets_any_undef = sets_any_undef;
 			basecase.sets_all_undef = sets_all_undef;
@@ -1226,6 +1461,8 @@ struct SatPass : public Pass {
 			inductstep.prove_asserts = prove_asserts;
 			inductstep.shows = shows;
 			inductstep.timeout = timeout;
+			inductstep.ez.setPortfolioSize(portfolio);
+			inductstep.solver_cmd = solver_cmd;
 			inductstep.sets_def = sets_def;
 			inductstep.sets_any_undef = sets_any_undef;
 			inductstep.sets_all_undef = sets_all_undef;
@@ -1246,6 +1483,7 @@ struct SatPass : public Pass {
 
 				// phase 1: proving base case
 
+				auto step_start_time = std::chrono::steady_clock::now();
 				basecase.setup(seq_len + inductlen);
 				int property = basecase.setup_proof(seq_len + inductlen);
 				basecase.generate_model();
@@ -1256,7 +1494,11 @@ struct SatPass : public Pass {
 				log("\n[base case] Solving problem with %d variables and %d clauses..\n",
 						basecase.ez.numCnfVariables(), basecase.ez.numCnfClauses());
 
-				if (basecase.solve(basecase.ez.NOT(property))) {
+				double setup_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - step_start_time).count();
+				bool basecase_failed = basecase.solve(basecase.ez.NOT(property));
+				basecase.log_step_stats("[base case]", setup_sec);
+
+				if (basecase_failed) {
 					log("SAT temporal induction proof finished - model found for base case: FAIL!\n");
 					print_proof_failed();
 					basecase.print_model();
@@ -1273,6 +1515,7 @@ struct SatPass : public Pass {
 
 				// phase 2: proving induction step
 
+				step_start_time = std::chrono::steady_clock::now();
 				inductstep.setup(inductlen + 1);
 				property = inductstep.setup_proof(inductlen + 1);
 				inductstep.generate_model();
@@ -1304,7 +1547,11 @@ struct SatPass : public Pass {
 					log("\n[induction step] Solving problem with %d variables and %d clauses..\n",
 							inductstep.ez.numCnfVariables(), inductstep.ez.numCnfClauses());
 
-					if (!inductstep.solve(inductstep.ez.NOT(property))) {
+					setup_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - step_start_time).count();
+					bool inductstep_proven = !inductstep.solve(inductstep.ez.NOT(property));
+					inductstep.log_step_stats("[induction step]", setup_sec);
+
+					if (inductstep_proven) {
 						if (inductstep.gotTimeout)
 							goto timeout;
 						log("Induction step proven: SUCCESS!\n");
@@ -1336,6 +1583,287 @@ struct SatPass : public Pass {
 				log_error("Called with -falsify and proof did succeed!\n");
 			}
 		}
+		else if (prove_each)
+		{
+			if (maxsteps > 0)
+				log_cmd_error("The options -maxsteps is only supported for temporal induction proofs!\n");
+
+			std::vector<ProveEachJob> jobs;
+
+			for (int k = 0; k < 2; k++)
+			for (auto &s : k ? prove_x : prove)
+			{
+				RTLIL::SigSpec lhs, rhs;
+
+				if (!RTLIL::SigSpec::parse_sel(lhs, design, module, s.first))
+					log_cmd_error("Failed to parse lhs proof expression `%s'.\n", s.first.c_str());
+				if (!RTLIL::SigSpec::parse_rhs(lhs, rhs, module, s.second))
+					log_cmd_error("Failed to parse rhs proof expression `%s'.\n", s.second.c_str());
+
+				if (lhs.size() != rhs.size())
+					log_cmd_error("Proof expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
+						s.first.c_str(), log_signal(lhs), lhs.size(), s.second.c_str(), log_signal(rhs), rhs.size());
+
+				for (int i = 0; i < lhs.size(); i++) {
+					ProveEachJob job;
+					job.lhs = lhs[i];
+					job.rhs = rhs[i];
+					job.proof_x = k == 1;
+					job.helper = NULL;
+					job.property = 0;
+					job.num_cells = 0;
+					job.setup_sec = 0;
+					job.solve_sec = 0;
+					job.status = ProveEachJob::PENDING;
+					jobs.push_back(job);
+				}
+			}
+
+			log("\nProving %d bits separately using %d threads.\n", GetSize(jobs), prove_each);
+
+			// the sigmap and the driver index are shared by all jobs
+			SigMap sigmap(module);
+			CellTypes ct(design);
+			SatDriverIndex driver_index(design, module, sigmap, ct);
+
+			int first_failed = -1, num_built = 0, num_started = 0;
+			bool all_built = false;
+
+			// the SAT problem of a finished job is freed right away, only the problem of the
+			// first failed proof is kept for printing the counter example. SatHelper holds
+			// RTLIL data (IdStrings), so it is always deleted in the main thread.
+			std::vector<int> finished_jobs;
+			auto record_job_stats = [&](ProveEachJob &job) {
+				job.num_cells = GetSize(job.helper->cone_cells);
+				job.solve_sec = job.helper->solve_sec;
+			};
+			auto release_job = [&](ProveEachJob &job) {
+				record_job_stats(job);
+				delete job.helper;
+				job.helper = NULL;
+			};
+			auto release_finished_jobs = [&]() {
+				for (int idx : finished_jobs)
+					if (idx != first_failed)
+						release_job(jobs[idx]);
+				finished_jobs.clear();
+			};
+
+			// the SAT problems are created in the main thread (RTLIL and the log are not
+			// thread safe), the worker threads only run the solvers on finished problems
+			auto solve_job = [&](ProveEachJob &job) {
+				bool failed = job.helper->solve(job.helper->ez.NOT(job.property));
+				return failed ? ProveEachJob::FAILED : job.helper->gotTimeout ? ProveEachJob::TIMEOUT : ProveEachJob::PROVEN;
+			};
+
+#if EZMINISAT_THREADS
+			std::mutex mutex;
+			std::condition_variable cond;
+			std::atomic<bool> found_cex(false);
+
+			auto worker = [&]() {
+				while (1) {
+					int idx;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						cond.wait(lock, [&]() { return num_started < num_built || all_built; });
+						if (num_started == num_built || found_cex)
+							return;
+						idx = num_started++;
+						jobs[idx].status = ProveEachJob::RUNNING;
+					}
+					auto status = solve_job(jobs[idx]);
+					std::lock_guard<std::mutex> lock(mutex);
+					finished_jobs.push_back(idx);
+					jobs[idx].status = found_cex && status == ProveEachJob::TIMEOUT ? ProveEachJob::ABORTED : status;
+					if (status == ProveEachJob::FAILED && !found_cex) {
+						first_failed = idx, found_cex = true;
+						for (auto &job : jobs)
+							if (job.status == ProveEachJob::RUNNING)
+								job.helper->ez.interrupt();
+					}
+					cond.notify_all();
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (int i = 0; i < prove_each; i++)
+				threads.push_back(std::thread(worker));
+
+			// with abort set, the solvers are interrupted and no further jobs are started
+			auto join_workers = [&](bool abort) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					all_built = true;
+					if (abort) {
+						found_cex = true;
+						for (auto &job : jobs)
+							if (job.status == ProveEachJob::RUNNING)
+								job.helper->ez.interrupt();
+					}
+					cond.notify_all();
+				}
+				for (auto &thread : threads)
+					thread.join();
+			};
+#endif
+
+			// a log_cmd_error() while setting up a problem must not unwind past running threads
+			try {
+				for (int idx = 0; idx < GetSize(jobs); idx++)
+				{
+#if EZMINISAT_THREADS
+					{
+						// do not build more problems ahead of the solvers than needed
+						std::unique_lock<std::mutex> lock(mutex);
+						cond.wait(lock, [&]() { return num_built - num_started < 2*prove_each || found_cex; });
+						release_finished_jobs();
+					}
+					if (found_cex)
+						break;
+#else
+					if (first_failed >= 0)
+						break;
+#endif
+					ProveEachJob &job = jobs[idx];
+					auto setup_start_time = std::chrono::steady_clock::now();
+
+					// only the setup of the first problem is logged
+					if (idx == 1)
+						log("\nSetting up the remaining SAT problems..\n");
+
+					job.helper = new SatHelper(design, module, enable_undef, &sigmap);
+					SatHelper &helper = *job.helper;
+
+					helper.quiet = idx > 0;
+
+					helper.sets = sets;
+					helper.sets_at = sets_at;
+					helper.unsets_at = unsets_at;
+					helper.shows = shows;
+					helper.timeout = timeout;
+					helper.ez.setPortfolioSize(portfolio);
+					helper.sets_def = sets_def;
+					helper.sets_any_undef = sets_any_undef;
+					helper.sets_all_undef = sets_all_undef;
+					helper.sets_def_at = sets_def_at;
+					helper.sets_any_undef_at = sets_any_undef_at;
+					helper.sets_all_undef_at = sets_all_undef_at;
+					helper.sets_init = sets_init;
+					helper.set_init_def = set_init_def;
+					helper.set_init_undef = set_init_undef;
+					helper.set_init_zero = set_init_zero;
+					helper.satgen.ignore_div_by_zero = ignore_div_by_zero;
+					helper.ignore_unknown_cells = ignore_unknown_cells;
+
+					RTLIL::SigSpec cone_sig = job.lhs;
+					cone_sig.append(job.rhs);
+					helper.setup_cone(cone_sig, driver_index);
+					helper.show_signal_pool.add(helper.sigmap(job.lhs));
+					helper.show_signal_pool.add(helper.sigmap(job.rhs));
+
+					if (seq_len == 0) {
+						helper.setup();
+						job.property = helper.setup_proof_sig(job.lhs, job.rhs, job.proof_x);
+					} else {
+						std::vector<int> prove_bits;
+						for (int timestep = 1; timestep <= seq_len; timestep++) {
+							helper.setup(timestep);
+							if (timestep > prove_skip)
+								prove_bits.push_back(helper.setup_proof_sig(job.lhs, job.rhs, job.proof_x, timestep));
+						}
+						job.property = helper.ez.expression(ezSAT::OpAnd, prove_bits);
+						helper.setup_init();
+					}
+					helper.generate_model();
+
+					job.setup_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - setup_start_time).count();
+
+#if EZMINISAT_THREADS
+					std::lock_guard<std::mutex> lock(mutex);
+					num_built++;
+					cond.notify_one();
+#else
+					num_built++, num_started++;
+					job.status = solve_job(job);
+					if (job.status == ProveEachJob::FAILED)
+						first_failed = idx;
+					finished_jobs.push_back(idx);
+					release_finished_jobs();
+#endif
+				}
+			} catch (log_cmd_error_exception) {
+#if EZMINISAT_THREADS
+				join_workers(true);
+#endif
+				for (auto &job : jobs)
+					delete job.helper;
+				throw log_cmd_error_exception();
+			}
+
+#if EZMINISAT_THREADS
+			join_workers(false);
+#endif
+
+			for (int idx = 0; idx < GetSize(jobs); idx++)
+				if (idx != first_failed && jobs[idx].helper != NULL)
+					release_job(jobs[idx]);
+
+			if (first_failed >= 0)
+				record_job_stats(jobs[first_failed]);
+
+			int num_proven = 0, num_timeout = 0, num_failed = 0;
+			log("\nProof results for the individual bits:\n");
+			for (auto &job : jobs) {
+				const char *status_str = "skipped";
+				if (job.status == ProveEachJob::PROVEN)
+					status_str = "proven", num_proven++;
+				if (job.status == ProveEachJob::FAILED)
+					status_str = "FAILED", num_failed++;
+				if (job.status == ProveEachJob::TIMEOUT)
+					status_str = "TIMEOUT", num_timeout++;
+				if (job.status == ProveEachJob::ABORTED)
+					status_str = "aborted";
+				if (job.status == ProveEachJob::PENDING)
+					log("  %-7s %s = %s\n", status_str, log_signal(job.lhs), log_signal(job.rhs));
+				else
+					log("  %-7s %s = %s (%d cells, setup %.2f sec, solving %.2f sec)\n", status_str, log_signal(job.lhs), log_signal(job.rhs),
+							job.num_cells, job.setup_sec, job.solve_sec);
+			}
+			log("Proven %d of %d bits, %d failed, %d timed out.\n", num_proven, GetSize(jobs), num_failed, num_timeout);
+
+			bool got_timeout = num_timeout > 0;
+			if (first_failed >= 0)
+			{
+				SatHelper &helper = *jobs[first_failed].helper;
+				log("\nSAT proof finished - model found for %s = %s: FAIL!\n", log_signal(jobs[first_failed].lhs), log_signal(jobs[first_failed].rhs));
+				print_proof_failed();
+				helper.print_model();
+
+				if(!vcd_file_name.empty())
+					helper.dump_model_to_vcd(vcd_file_name);
+			}
+			else if (!got_timeout)
+			{
+				log("\nSAT proof finished - no model found: SUCCESS!\n");
+				print_qed();
+			}
+
+			if (first_failed >= 0)
+				delete jobs[first_failed].helper;
+
+			if (first_failed >= 0) {
+				if (verify) {
+					log("\n");
+					log_error("Called with -verify and proof did fail!\n");
+				}
+			} else if (got_timeout) {
+				goto timeout;
+			} else if (falsify) {
+				log("\n");
+				log_error("Called with -falsify and proof did succeed!\n");
+			}
+		}
 		else
 		{
 			if (maxsteps > 0)
@@ -1351,6 +1879,8 @@ struct SatPass : public Pass {
 			sathelper.unsets_at = unsets_at;
 			sathelper.shows = shows;
 			sathelper.timeout = timeout;
+			sathelper.ez.setPortfolioSize(portfolio);
+			sathelper.solver_cmd = solver_cmd;
 			sathelper.sets_def = sets_def;
 			sathelper.sets_any_undef = sets_any_undef;
 			sathelper.sets_all_undef = sets_all_undef;
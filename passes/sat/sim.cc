@@ -0,0 +1,746 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/register.h"
+#include "kernel/celltypes.h"
+#include "kernel/sigtools.h"
+#include "kernel/macc.h"
+#include "kernel/log.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+static bool sim_is_ff(RTLIL::Cell *cell)
+{
+	return cell->type.in("$dff", "$adff") || cell->type.substr(0, 6) == "$_DFF_";
+}
+
+struct SimWorker
+{
+	enum op_t {
+		OP_MUX, OP_ALU, OP_LCU, OP_FA, OP_MACC, OP_GENERIC
+	};
+
+	// one instruction per combinational cell, in topological order. the
+	// operands are indices into the signal store, the a..d values are
+	// buffers for the current input values.
+	struct sim_insn_t {
+		RTLIL::Cell *cell;
+		op_t op;
+		std::vector<int> a, b, c, d, s, y, x, co;
+		std::vector<std::vector<int>> macc_a, macc_b;
+		Macc macc;
+		RTLIL::Const a_value, b_value, c_value, d_value;
+	};
+
+	struct sim_ff_t {
+		RTLIL::Cell *cell;
+		bool clk_polarity, has_arst, arst_polarity;
+		int arst;
+		std::vector<int> d, q;
+		RTLIL::Const arst_value, next_q;
+	};
+
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	SigMap sigmap;
+
+	// packed signal store, indices 0..3 are the constants 0, 1, x and z.
+	// bit_index is only used while compiling and for user-supplied signals.
+	std::map<RTLIL::SigBit, int> bit_index;
+	std::vector<RTLIL::State> state;
+
+	std::vector<sim_insn_t> program;
+	std::vector<sim_ff_t> ffs;
+	int clock;
+
+	int bit(RTLIL::SigBit b)
+	{
+		b = sigmap(b);
+		if (b.wire == NULL)
+			return b.data == RTLIL::S0 ? 0 : b.data == RTLIL::S1 ? 1 : b.data == RTLIL::Sz ? 3 : 2;
+		auto it = bit_index.find(b);
+		if (it != bit_index.end())
+			return it->second;
+		int idx = GetSize(state);
+		state.push_back(RTLIL::Sx);
+		bit_index[b] = idx;
+		return idx;
+	}
+
+	std::vector<int> bits(const RTLIL::SigSpec &sig)
+	{
+		std::vector<int> result;
+		for (auto &b : sig)
+			result.push_back(bit(b));
+		return result;
+	}
+
+	// like bits(), but constant bits get a scratch index, so that the
+	// constants in the store are never overwritten
+	std::vector<int> out_bits(const RTLIL::SigSpec &sig)
+	{
+		std::vector<int> result = bits(sig);
+		for (auto &idx : result)
+			if (idx < 4) {
+				idx = GetSize(state);
+				state.push_back(RTLIL::Sx);
+			}
+		return result;
+	}
+
+	void get(const std::vector<int> &sig, RTLIL::Const &value) const
+	{
+		value.bits.resize(sig.size());
+		for (int i = 0; i < GetSize(sig); i++)
+			value.bits[i] = state[sig[i]];
+	}
+
+	RTLIL::Const get(const std::vector<int> &sig) const
+	{
+		RTLIL::Const result;
+		get(sig, result);
+		return result;
+	}
+
+	RTLIL::Const get(const RTLIL::SigSpec &sig)
+	{
+		return get(bits(sig));
+	}
+
+	void set(const std::vector<int> &sig, const RTLIL::Const &value)
+	{
+		for (int i = 0; i < GetSize(sig); i++)
+			state[sig[i]] = i < GetSize(value) ? value.bits[i] : RTLIL::Sx;
+	}
+
+	void set(const RTLIL::SigSpec &sig, const RTLIL::Const &value)
+	{
+		std::vector<int> sig_bits = bits(sig);
+		for (int i = 0; i < GetSize(sig_bits); i++)
+			if (sig_bits[i] >= 4)
+				state[sig_bits[i]] = i < GetSize(value) ? value.bits[i] : RTLIL::Sx;
+	}
+
+	SimWorker(RTLIL::Design *design, RTLIL::Module *module, bool zinit) : design(design), module(module), sigmap(module), clock(-1)
+	{
+		state = {RTLIL::S0, RTLIL::S1, RTLIL::Sx, RTLIL::Sz};
+
+		CellTypes ct;
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		std::map<RTLIL::SigBit, RTLIL::Cell*> bit_drivers;
+		std::vector<RTLIL::Cell*> comb_cells;
+		RTLIL::SigBit clock_bit;
+
+		for (auto &it : module->cells_)
+		{
+			RTLIL::Cell *cell = it.second;
+
+			if (sim_is_ff(cell))
+			{
+				if (cell->type.substr(0, 6) == "$_DFF_" && (GetSize(cell->type) != 8 && GetSize(cell->type) != 10))
+					log_error("Unsupported cell type %s for cell %s.\n", log_id(cell->type), log_id(cell));
+
+				sim_ff_t ff;
+				ff.cell = cell;
+				ff.has_arst = false;
+				ff.arst_polarity = false;
+				ff.arst = 0;
+
+				RTLIL::SigSpec sig_clk;
+				if (cell->type.in("$dff", "$adff")) {
+					sig_clk = cell->getPort("\\CLK");
+					ff.clk_polarity = cell->parameters.at("\\CLK_POLARITY").as_bool();
+					if (cell->type == "$adff") {
+						ff.has_arst = true;
+						ff.arst = bit(cell->getPort("\\ARST"));
+						ff.arst_polarity = cell->parameters.at("\\ARST_POLARITY").as_bool();
+						ff.arst_value = cell->parameters.at("\\ARST_VALUE");
+					}
+				} else {
+					sig_clk = cell->getPort("\\C");
+					ff.clk_polarity = cell->type[6] == 'P';
+					if (GetSize(cell->type) == 10) {
+						ff.has_arst = true;
+						ff.arst = bit(cell->getPort("\\R"));
+						ff.arst_polarity = cell->type[7] == 'P';
+						ff.arst_value = RTLIL::Const(cell->type[8] == '1' ? RTLIL::S1 : RTLIL::S0, 1);
+					}
+				}
+
+				ff.d = bits(cell->getPort("\\D"));
+				ff.q = out_bits(cell->getPort("\\Q"));
+				for (auto b : sigmap(cell->getPort("\\Q")))
+					if (b.wire != NULL)
+						bit_drivers[b] = cell;
+
+				RTLIL::SigBit b = sigmap(sig_clk).to_single_sigbit();
+				if (clock_bit.wire != NULL && b != clock_bit)
+					log_error("Cell %s is clocked by %s, but other flip-flops are clocked by %s. Multiple clock domains are not supported.\n",
+							log_id(cell), log_signal(b), log_signal(clock_bit));
+				clock_bit = b;
+
+				ffs.push_back(ff);
+				continue;
+			}
+
+			if (!ct.cell_evaluable(cell->type) || cell->type == "$assert")
+				log_error("Unsupported cell type %s for cell %s.\n", log_id(cell->type), log_id(cell));
+
+			for (auto &conn : cell->connections())
+				if (ct.cell_output(cell->type, conn.first))
+					for (auto b : sigmap(conn.second))
+						if (b.wire != NULL)
+							bit_drivers[b] = cell;
+			comb_cells.push_back(cell);
+		}
+
+		if (clock_bit.wire != NULL) {
+			if (bit_drivers.count(clock_bit))
+				log_error("Clock signal %s is driven by cell %s. Only primary clock inputs are supported.\n",
+						log_signal(clock_bit), log_id(bit_drivers.at(clock_bit)));
+			clock = bit(clock_bit);
+		}
+
+		// levelize: order the combinational cells so that every cell comes after the drivers of its inputs
+
+		std::map<RTLIL::Cell*, std::set<RTLIL::Cell*>> cell_deps, cell_users;
+		for (auto cell : comb_cells) {
+			cell_deps[cell].clear();
+			for (auto &conn : cell->connections())
+				if (ct.cell_input(cell->type, conn.first))
+					for (auto b : sigmap(conn.second))
+						if (b.wire != NULL && bit_drivers.count(b) && !sim_is_ff(bit_drivers.at(b))) {
+							cell_deps[cell].insert(bit_drivers.at(b));
+							cell_users[bit_drivers.at(b)].insert(cell);
+						}
+		}
+
+		std::vector<RTLIL::Cell*> queue;
+		for (auto cell : comb_cells)
+			if (cell_deps[cell].empty())
+				queue.push_back(cell);
+
+		for (int i = 0; i < GetSize(queue); i++) {
+			add_insn(queue[i]);
+			for (auto user : cell_users[queue[i]]) {
+				cell_deps[user].erase(queue[i]);
+				if (cell_deps[user].empty())
+					queue.push_back(user);
+			}
+		}
+
+		if (GetSize(program) != GetSize(comb_cells))
+			for (auto cell : comb_cells)
+				if (!cell_deps[cell].empty())
+					log_error("Found logic loop through cell %s.\n", log_id(cell));
+
+		// initial state of the flip-flops and undriven wires
+
+		for (auto &it : module->wires_)
+		{
+			RTLIL::Wire *wire = it.second;
+			if (wire->attributes.count("\\init") == 0)
+				continue;
+			RTLIL::Const init = wire->attributes.at("\\init");
+			for (int i = 0; i < GetSize(wire) && i < GetSize(init); i++) {
+				int idx = bit(RTLIL::SigBit(wire, i));
+				if (idx >= 4)
+					state[idx] = init.bits[i];
+			}
+		}
+
+		if (zinit)
+			for (auto &ff : ffs)
+			for (int idx : ff.q)
+				if (state[idx] != RTLIL::S0 && state[idx] != RTLIL::S1)
+					state[idx] = RTLIL::S0;
+
+		if (clock >= 0)
+			state[clock] = RTLIL::S0;
+
+		log("Compiled module %s: %d instructions, %d flip-flops, %d signal bits.\n",
+				log_id(module), GetSize(program), GetSize(ffs), GetSize(state));
+	}
+
+	void add_insn(RTLIL::Cell *cell)
+	{
+		sim_insn_t insn;
+		insn.cell = cell;
+		insn.op = OP_GENERIC;
+
+		if (cell->type.in("$_MUX_", "$mux", "$pmux")) insn.op = OP_MUX;
+		if (cell->type == "$alu") insn.op = OP_ALU;
+		if (cell->type == "$lcu") insn.op = OP_LCU;
+		if (cell->type == "$fa") insn.op = OP_FA;
+		if (cell->type == "$macc") insn.op = OP_MACC;
+
+		if (insn.op == OP_LCU) {
+			insn.a = bits(cell->getPort("\\P"));
+			insn.b = bits(cell->getPort("\\G"));
+			insn.c = bits(cell->getPort("\\CI"));
+			insn.co = out_bits(cell->getPort("\\CO"));
+			program.push_back(insn);
+			return;
+		}
+
+		if (insn.op == OP_MACC) {
+			insn.macc.from_cell(cell);
+			for (auto &port : insn.macc.ports) {
+				insn.macc_a.push_back(bits(port.in_a));
+				insn.macc_b.push_back(bits(port.in_b));
+			}
+			insn.s = bits(insn.macc.bit_ports);
+			insn.y = out_bits(cell->getPort("\\Y"));
+			program.push_back(insn);
+			return;
+		}
+
+		if (cell->hasPort("\\A"))
+			insn.a = bits(cell->getPort("\\A"));
+		if (cell->hasPort("\\B"))
+			insn.b = bits(cell->getPort("\\B"));
+		if (cell->type.in("$_AOI3_", "$_OAI3_", "$_AOI4_", "$_OAI4_", "$fa")) {
+			if (cell->hasPort("\\C"))
+				insn.c = bits(cell->getPort("\\C"));
+			if (cell->hasPort("\\D"))
+				insn.d = bits(cell->getPort("\\D"));
+		}
+		if (cell->hasPort("\\S"))
+			insn.s = bits(cell->getPort("\\S"));
+		if (insn.op == OP_ALU) {
+			insn.c = bits(cell->getPort("\\CI"));
+			insn.d = bits(cell->getPort("\\BI"));
+			insn.co = out_bits(cell->getPort("\\CO"));
+		}
+		if (cell->hasPort("\\X"))
+			insn.x = out_bits(cell->getPort("\\X"));
+		insn.y = out_bits(cell->getPort("\\Y"));
+
+		program.push_back(insn);
+	}
+
+	// same semantics as ConstEval: the B slices with a set or undef select bit
+	// and A (if no select bit is set) are candidates, differing bits become undef
+	void exec_mux(const sim_insn_t &insn)
+	{
+		int width = GetSize(insn.y);
+		bool any_s1 = false;
+		for (int idx : insn.s)
+			if (state[idx] == RTLIL::S1)
+				any_s1 = true;
+
+		for (int j = 0; j < width; j++)
+		{
+			bool have = false;
+			RTLIL::State result = RTLIL::Sx;
+			auto merge = [&](RTLIL::State value) {
+				if (!have)
+					result = value, have = true;
+				else if (result != value)
+					result = RTLIL::Sx;
+			};
+
+			for (int i = 0; i < GetSize(insn.s); i++)
+				if (state[insn.s[i]] == RTLIL::S1 || state[insn.s[i]] == RTLIL::Sx)
+					merge(state[insn.b[i*width + j]]);
+			if (!any_s1)
+				merge(state[insn.a[j]]);
+
+			state[insn.y[j]] = result;
+		}
+	}
+
+	void exec_macc(const sim_insn_t &insn)
+	{
+		Macc macc = insn.macc;
+		for (int i = 0; i < GetSize(macc.ports); i++) {
+			macc.ports[i].in_a = get(insn.macc_a[i]);
+			macc.ports[i].in_b = get(insn.macc_b[i]);
+		}
+		macc.bit_ports = get(insn.s);
+
+		RTLIL::Const result(0, GetSize(insn.y));
+		if (!macc.eval(result))
+			log_abort();
+		set(insn.y, result);
+	}
+
+	void eval_comb()
+	{
+		RTLIL::Const x, y, co;
+
+		for (auto &insn : program)
+		{
+			if (insn.op == OP_MUX) {
+				exec_mux(insn);
+				continue;
+			}
+
+			if (insn.op == OP_MACC) {
+				exec_macc(insn);
+				continue;
+			}
+
+			get(insn.a, insn.a_value);
+			get(insn.b, insn.b_value);
+			get(insn.c, insn.c_value);
+			get(insn.d, insn.d_value);
+
+			switch (insn.op)
+			{
+			case OP_ALU:
+				CellTypes::eval_alu(insn.cell, insn.a_value, insn.b_value, insn.c_value, insn.d_value, x, y, co);
+				set(insn.x, x);
+				set(insn.y, y);
+				set(insn.co, co);
+				break;
+			case OP_LCU:
+				set(insn.co, CellTypes::eval_lcu(insn.a_value, insn.b_value, insn.c_value));
+				break;
+			case OP_FA:
+				CellTypes::eval_fa(insn.a_value, insn.b_value, insn.c_value, x, y);
+				set(insn.x, x);
+				set(insn.y, y);
+				break;
+			default:
+				set(insn.y, CellTypes::eval(insn.cell, insn.a_value, insn.b_value, insn.c_value, insn.d_value));
+				break;
+			}
+		}
+	}
+
+	// returns true if an asynchronous reset changed a flip-flop output
+	bool apply_async_resets()
+	{
+		bool changed = false;
+		for (auto &ff : ffs) {
+			if (!ff.has_arst || state[ff.arst] != (ff.arst_polarity ? RTLIL::S1 : RTLIL::S0))
+				continue;
+			for (int i = 0; i < GetSize(ff.q); i++)
+				if (state[ff.q[i]] != ff.arst_value.bits[i])
+					state[ff.q[i]] = ff.arst_value.bits[i], changed = true;
+		}
+		return changed;
+	}
+
+	void settle()
+	{
+		eval_comb();
+		for (int i = 0; i < GetSize(ffs) && apply_async_resets(); i++)
+			eval_comb();
+	}
+
+	void clock_edge(bool polarity)
+	{
+		for (auto &ff : ffs)
+			if (ff.clk_polarity == polarity)
+				get(ff.d, ff.next_q);
+		for (auto &ff : ffs)
+			if (ff.clk_polarity == polarity)
+				set(ff.q, ff.next_q);
+	}
+};
+
+struct VcdWriter
+{
+	FILE *f;
+	std::vector<std::pair<std::string, RTLIL::SigSpec>> vars;
+	std::vector<std::string> last_values;
+
+	static std::string vcd_id(int index)
+	{
+		std::string id;
+		do {
+			id += char('!' + index % 94);
+			index /= 94;
+		} while (index > 0);
+		return id;
+	}
+
+	VcdWriter(FILE *f, RTLIL::Module *module) : f(f)
+	{
+		fprintf(f, "$version %s $end\n", yosys_version_str);
+		fprintf(f, "$timescale 1ns $end\n");
+		fprintf(f, "$scope module %s $end\n", log_id(module));
+
+		for (auto &it : module->wires_) {
+			RTLIL::Wire *wire = it.second;
+			if (wire->name[0] == '$')
+				continue;
+			std::string id = vcd_id(GetSize(vars));
+			if (wire->width == 1)
+				fprintf(f, "$var wire 1 %s %s $end\n", id.c_str(), log_id(wire));
+			else
+				fprintf(f, "$var wire %d %s %s [%d:0] $end\n", wire->width, id.c_str(), log_id(wire), wire->width-1);
+			vars.push_back(std::make_pair(id, RTLIL::SigSpec(wire)));
+		}
+
+		fprintf(f, "$upscope $end\n");
+		fprintf(f, "$enddefinitions $end\n");
+		last_values.resize(vars.size());
+	}
+
+	void dump(SimWorker &worker, int timestamp)
+	{
+		fprintf(f, "#%d\n", timestamp);
+		for (int i = 0; i < GetSize(vars); i++)
+		{
+			RTLIL::Const value = worker.get(vars[i].second);
+			std::string text;
+			for (int k = GetSize(value)-1; k >= 0; k--)
+				text += value.bits[k] == RTLIL::S0 ? '0' : value.bits[k] == RTLIL::S1 ? '1' : value.bits[k] == RTLIL::Sz ? 'z' : 'x';
+			if (text == last_values[i])
+				continue;
+			if (GetSize(text) == 1)
+				fprintf(f, "%s%s\n", text.c_str(), vars[i].first.c_str());
+			else
+				fprintf(f, "b%s %s\n", text.c_str(), vars[i].first.c_str());
+			last_values[i] = text;
+		}
+	}
+};
+
+struct SimPass : public Pass {
+	SimPass() : Pass("sim", "simulate the circuit") { }
+	virtual void help()
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    sim [options] [selection]\n");
+		log("\n");
+		log("This command simulates the selected module cycle by cycle. The module is\n");
+		log("levelized once and compiled into a flat list of instructions over a packed\n");
+		log("signal store. The cell semantics are the same as in the 'eval' command.\n");
+		log("\n");
+		log("All flip-flops must be clocked by the same primary input. This clock is\n");
+		log("driven by the simulator: every cycle has a rising and a falling clock edge.\n");
+		log("Supported flip-flop cells are $dff, $adff, $_DFF_[NP]_ and $_DFF_[NP][NP][01]_.\n");
+		log("Memories and hierarchical cells are not supported (run 'memory' and\n");
+		log("'flatten' first).\n");
+		log("\n");
+		log("    -stimulus <filename>\n");
+		log("        read the stimulus from the given file. every non-empty line that\n");
+		log("        does not start with '#' describes one cycle as a list of\n");
+		log("        <signal>=<value> pairs separated by whitespace, e.g. 'a=4'b0101 b=3'.\n");
+		log("        assignments to input ports set the inputs for this cycle (inputs keep\n");
+		log("        their values until they are assigned again). assignments to other\n");
+		log("        signals are checked against the simulation before the clock edge.\n");
+		log("        undefined bits in expected values are ignored.\n");
+		log("\n");
+		log("    -n <N>\n");
+		log("        number of cycles to simulate (default: number of lines in the\n");
+		log("        stimulus file, or 1 without a stimulus file)\n");
+		log("\n");
+		log("    -zinit\n");
+		log("        set flip-flops without 'init' attribute to zero (default: undef)\n");
+		log("\n");
+		log("    -vcd <filename>\n");
+		log("        write the values of all public wires to a VCD file\n");
+		log("\n");
+		log("    -show <signal>\n");
+		log("        print the value of the given signal in each cycle (this option\n");
+		log("        can be used multiple times)\n");
+		log("\n");
+		log("    -fail\n");
+		log("        return an error if any of the checks in the stimulus file fails\n");
+		log("\n");
+	}
+	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
+	{
+		std::string stimulus_file, vcd_file;
+		std::vector<std::string> shows;
+		int num_cycles = -1;
+		bool zinit = false, fail_on_mismatch = false;
+
+		log_header("Executing SIM pass (simulate the circuit).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-stimulus" && argidx+1 < args.size()) {
+				stimulus_file = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-vcd" && argidx+1 < args.size()) {
+				vcd_file = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-n" && argidx+1 < args.size()) {
+				num_cycles = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-show" && argidx+1 < args.size()) {
+				shows.push_back(args[++argidx]);
+				continue;
+			}
+			if (args[argidx] == "-zinit") {
+				zinit = true;
+				continue;
+			}
+			if (args[argidx] == "-fail") {
+				fail_on_mismatch = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		RTLIL::Module *module = NULL;
+		for (auto &mod_it : design->modules_)
+			if (design->selected(mod_it.second)) {
+				if (module)
+					log_cmd_error("Only one module must be selected for the SIM pass! (selected: %s and %s)\n",
+							RTLIL::id2cstr(module->name), RTLIL::id2cstr(mod_it.first));
+				module = mod_it.second;
+			}
+		if (module == NULL)
+			log_cmd_error("Can't perform SIM on an empty selection!\n");
+
+		// parse stimulus: one list of (signal, value) assignments per cycle
+
+		std::vector<std::vector<std::pair<RTLIL::SigSpec, RTLIL::Const>>> stimulus;
+		std::vector<RTLIL::SigSpec> show_signals;
+
+		if (!stimulus_file.empty())
+		{
+			std::ifstream f(stimulus_file);
+			if (f.fail())
+				log_cmd_error("Can't open stimulus file `%s': %s\n", stimulus_file.c_str(), strerror(errno));
+
+			std::string line;
+			for (int line_nr = 1; std::getline(f, line); line_nr++)
+			{
+				std::istringstream ss(line);
+				std::string tok;
+				std::vector<std::pair<RTLIL::SigSpec, RTLIL::Const>> assignments;
+
+				if (!(ss >> tok) || tok[0] == '#')
+					continue;
+
+				do {
+					size_t pos = tok.find('=');
+					if (pos == std::string::npos)
+						log_cmd_error("Syntax error in stimulus file line %d: `%s'.\n", line_nr, tok.c_str());
+
+					RTLIL::SigSpec lhs, rhs;
+					if (!RTLIL::SigSpec::parse_sel(lhs, design, module, tok.substr(0, pos)))
+						log_cmd_error("Failed to parse signal `%s' in stimulus file line %d.\n", tok.substr(0, pos).c_str(), line_nr);
+					if (!RTLIL::SigSpec::parse_rhs(lhs, rhs, module, tok.substr(pos+1)) || !rhs.is_fully_const())
+						log_cmd_error("Failed to parse constant `%s' in stimulus file line %d.\n", tok.substr(pos+1).c_str(), line_nr);
+					assignments.push_back(std::make_pair(lhs, rhs.as_const()));
+				} while (ss >> tok);
+
+				stimulus.push_back(assignments);
+			}
+		}
+
+		for (auto &it : shows) {
+			RTLIL::SigSpec sig;
+			if (!RTLIL::SigSpec::parse_sel(sig, design, module, it))
+				log_cmd_error("Failed to parse show expression `%s'.\n", it.c_str());
+			show_signals.push_back(sig);
+		}
+
+		if (num_cycles < 0)
+			num_cycles = stimulus.empty() ? 1 : GetSize(stimulus);
+
+		SimWorker worker(design, module, zinit);
+
+		FILE *vcd_f = NULL;
+		VcdWriter *vcd = NULL;
+		if (!vcd_file.empty()) {
+			vcd_f = fopen(vcd_file.c_str(), "w");
+			if (vcd_f == NULL)
+				log_cmd_error("Can't open VCD file `%s' for writing: %s\n", vcd_file.c_str(), strerror(errno));
+			vcd = new VcdWriter(vcd_f, module);
+		}
+
+		int num_checks = 0, num_mismatches = 0;
+
+		for (int cycle = 0; cycle < num_cycles; cycle++)
+		{
+			std::vector<std::pair<RTLIL::SigSpec, RTLIL::Const>> checks;
+
+			if (cycle < GetSize(stimulus))
+				for (auto &it : stimulus[cycle]) {
+					bool is_input = true;
+					for (auto &b : it.first)
+						if (b.wire == NULL || !b.wire->port_input)
+							is_input = false;
+					if (is_input)
+						worker.set(it.first, it.second);
+					else
+						checks.push_back(it);
+				}
+
+			worker.settle();
+			if (vcd)
+				vcd->dump(worker, 10*cycle);
+
+			for (auto &it : checks) {
+				RTLIL::Const value = worker.get(it.first);
+				bool match = true;
+				for (int i = 0; i < GetSize(value); i++)
+					if ((it.second.bits[i] == RTLIL::S0 || it.second.bits[i] == RTLIL::S1) && value.bits[i] != it.second.bits[i])
+						match = false;
+				if (!match) {
+					log("Mismatch in cycle %d: %s = %s (expected %s).\n", cycle,
+							log_signal(it.first), log_signal(value), log_signal(it.second));
+					num_mismatches++;
+				}
+				num_checks++;
+			}
+
+			for (auto &sig : show_signals)
+				log("Cycle %d: %s = %s\n", cycle, log_signal(sig), log_signal(worker.get(sig)));
+
+			if (worker.clock >= 0) {
+				worker.state[worker.clock] = RTLIL::S1;
+				worker.clock_edge(true);
+				worker.settle();
+				if (vcd)
+					vcd->dump(worker, 10*cycle + 5);
+				worker.state[worker.clock] = RTLIL::S0;
+				worker.clock_edge(false);
+			}
+		}
+
+		if (vcd) {
+			worker.settle();
+			vcd->dump(worker, 10*num_cycles);
+			delete vcd;
+			fclose(vcd_f);
+		}
+
+		log("Simulated %d cycles, %d of %d checks passed.\n", num_cycles, num_checks - num_mismatches, num_checks);
+
+		if (fail_on_mismatch && num_mismatches > 0)
+			log_error("Simulation found %d mismatches.\n", num_mismatches);
+	}
+} SimPass;
+
+PRIVATE_NAMESPACE_END
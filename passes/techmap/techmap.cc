@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unordered_map>
+#include <mutex>
 
 #include "passes/techmap/techmap.inc"
 
@@ -41,31 +43,64 @@ YOSYS_NAMESPACE_END
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-void apply_prefix(std::string prefix, std::string &id)
+struct TechmapCacheKey
 {
-	if (id[0] == '\\')
-		id = prefix + "." + id.substr(1);
-	else
-		id = "$techmap" + prefix + "." + id;
-}
+	RTLIL::IdString tpl_name;
+	std::map<RTLIL::IdString, RTLIL::Const> parameters;
+	unsigned int hash;
 
-void apply_prefix(std::string prefix, RTLIL::SigSpec &sig, RTLIL::Module *module)
-{
-	std::vector<RTLIL::SigChunk> chunks = sig;
-	for (auto &chunk : chunks)
-		if (chunk.wire != NULL) {
-			std::string wire_name = chunk.wire->name.str();
-			apply_prefix(prefix, wire_name);
-			log_assert(module->wires_.count(wire_name) > 0);
-			chunk.wire = module->wires_[wire_name];
+	TechmapCacheKey(RTLIL::IdString tpl_name, const std::map<RTLIL::IdString, RTLIL::Const> &parameters) :
+			tpl_name(tpl_name), parameters(parameters)
+	{
+		hash = tpl_name.index_;
+		for (auto &it : parameters) {
+			hash = hash*33 + it.first.index_;
+			for (auto bit : it.second.bits)
+				hash = hash*33 + bit;
+		}
+	}
+
+	bool operator==(const TechmapCacheKey &other) const {
+		return hash == other.hash && tpl_name == other.tpl_name && parameters == other.parameters;
+	}
+
+	struct hasher {
+		size_t operator()(const TechmapCacheKey &key) const {
+			return key.hash;
 		}
-	sig = chunks;
-}
+	};
+};
+
+struct TechmapNewCells : public RTLIL::Monitor
+{
+	// collects the cells created by simplemap and maccmap when mapping 'cell'
+
+	RTLIL::Module *module;
+	std::vector<RTLIL::Cell*> &new_cells;
+	std::set<RTLIL::Cell*> seen_cells;
+
+	TechmapNewCells(RTLIL::Module *module, RTLIL::Cell *cell, std::vector<RTLIL::Cell*> &new_cells) : module(module), new_cells(new_cells)
+	{
+		seen_cells.insert(cell);
+		module->monitors.insert(this);
+	}
+
+	~TechmapNewCells()
+	{
+		module->monitors.erase(this);
+	}
+
+	virtual void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString&, const RTLIL::SigSpec&, RTLIL::SigSpec&) YS_OVERRIDE
+	{
+		if (seen_cells.insert(cell).second)
+			new_cells.push_back(cell);
+	}
+};
 
 struct TechmapWorker
 {
 	std::map<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> simplemap_mappers;
-	std::map<std::pair<RTLIL::IdString, std::map<RTLIL::IdString, RTLIL::Const>>, RTLIL::Module*> techmap_cache;
+	std::unordered_map<TechmapCacheKey, RTLIL::Module*, TechmapCacheKey::hasher> techmap_cache;
 	std::map<RTLIL::Module*, bool> techmap_do_cache;
 	std::set<RTLIL::Module*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Module>> module_queue;
 
@@ -76,6 +111,37 @@ struct TechmapWorker
 
 	typedef std::map<std::string, std::vector<TechmapWireData>> TechmapWires;
 
+	// The names of the wires and cells of a template instance are
+	// <head><name of the mapped cell><tail>, the instance wires are
+	// looked up by the index of the template wire.
+
+	struct TechmapPlan
+	{
+		struct wire_t {
+			RTLIL::Wire *wire;
+			std::string name_head, name_tail;
+			bool is_special;
+		};
+
+		struct cell_t {
+			RTLIL::Cell *cell;
+			RTLIL::IdString type;
+			std::string name_head, name_tail;
+			bool is_replace;
+		};
+
+		std::vector<wire_t> wires;
+		std::vector<cell_t> cells;
+		std::map<RTLIL::Wire*, int> wire_index;
+		std::map<RTLIL::IdString, RTLIL::IdString> positional_ports;
+		bool has_replace_cell;
+	};
+
+	std::map<RTLIL::Module*, TechmapPlan> techmap_plans;
+
+	// cells created by the last techmap_module() call that did something
+	std::map<RTLIL::Module*, std::vector<RTLIL::Cell*>> pending_cells;
+
 	bool extern_mode;
 	bool assert_mode;
 	bool flatten_mode;
@@ -153,7 +219,56 @@ struct TechmapWorker
 		return result;
 	}
 
-	void techmap_module_worker(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl)
+	const TechmapPlan &get_techmap_plan(RTLIL::Module *tpl)
+	{
+		if (techmap_plans.count(tpl))
+			return techmap_plans.at(tpl);
+
+		TechmapPlan &plan = techmap_plans[tpl];
+		plan.has_replace_cell = false;
+
+		for (auto &it : tpl->wires_) {
+			if (it.second->port_id > 0)
+				plan.positional_ports[stringf("$%d", it.second->port_id)] = it.first;
+			std::string name = it.second->name.str();
+			TechmapPlan::wire_t w;
+			w.wire = it.second;
+			w.name_head = name[0] == '\\' ? "" : "$techmap";
+			w.name_tail = "." + (name[0] == '\\' ? name.substr(1) : name);
+			w.is_special = it.second->get_bool_attribute("\\_techmap_special_");
+			plan.wire_index[it.second] = GetSize(plan.wires);
+			plan.wires.push_back(w);
+		}
+
+		for (auto &it : tpl->cells_) {
+			std::string name = it.second->name.str();
+			TechmapPlan::cell_t c;
+			c.cell = it.second;
+			c.type = it.second->type;
+			if (!flatten_mode && c.type.substr(0, 2) == "\\$")
+				c.type = c.type.substr(1);
+			c.name_head = name[0] == '\\' ? "" : "$techmap";
+			c.name_tail = "." + (name[0] == '\\' ? name.substr(1) : name);
+			c.is_replace = !flatten_mode && name == "\\_TECHMAP_REPLACE_";
+			if (c.is_replace)
+				plan.has_replace_cell = true;
+			plan.cells.push_back(c);
+		}
+
+		return plan;
+	}
+
+	static void remap_instance_wires(RTLIL::SigSpec &sig, const TechmapPlan &plan, const std::vector<RTLIL::Wire*> &new_wires)
+	{
+		std::vector<RTLIL::SigChunk> chunks = sig;
+		for (auto &chunk : chunks)
+			if (chunk.wire != NULL)
+				chunk.wire = new_wires.at(plan.wire_index.at(chunk.wire));
+		sig = chunks;
+	}
+
+	void techmap_module_worker(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl,
+			std::vector<RTLIL::Cell*> &new_cells)
 	{
 		if (tpl->memories.size() != 0)
 			log_error("Technology map yielded memories -> this is not supported.\n");
@@ -169,52 +284,50 @@ struct TechmapWorker
 				log_error("Technology map yielded processes -> this is not supported (use -autoproc to run 'proc' automatically).\n");
 		}
 
+		const TechmapPlan &plan = get_techmap_plan(tpl);
+
 		std::string orig_cell_name;
-		if (!flatten_mode)
-			for (auto &it : tpl->cells_)
-				if (it.first == "\\_TECHMAP_REPLACE_") {
-					orig_cell_name = cell->name.str();
-					module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
-					break;
-				}
+		if (plan.has_replace_cell) {
+			orig_cell_name = cell->name.str();
+			module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
+		}
 
-		std::map<RTLIL::IdString, RTLIL::IdString> positional_ports;
+		std::string prefix = cell->name.str();
 
-		for (auto &it : tpl->wires_) {
-			if (it.second->port_id > 0)
-				positional_ports[stringf("$%d", it.second->port_id)] = it.first;
-			std::string w_name = it.second->name.str();
-			apply_prefix(cell->name.str(), w_name);
-			RTLIL::Wire *w = module->addWire(w_name, it.second);
+		std::vector<RTLIL::Wire*> new_wires;
+		new_wires.reserve(plan.wires.size());
+
+		for (auto &it : plan.wires) {
+			RTLIL::Wire *w = module->addWire(it.name_head + prefix + it.name_tail, it.wire);
 			w->port_input = false;
 			w->port_output = false;
 			w->port_id = 0;
-			if (it.second->get_bool_attribute("\\_techmap_special_"))
+			if (it.is_special)
 				w->attributes.clear();
 			design->select(module, w);
+			new_wires.push_back(w);
 		}
 
 		SigMap port_signal_map;
 
 		for (auto &it : cell->connections()) {
 			RTLIL::IdString portname = it.first;
-			if (positional_ports.count(portname) > 0)
-				portname = positional_ports.at(portname);
+			if (plan.positional_ports.count(portname) > 0)
+				portname = plan.positional_ports.at(portname);
 			if (tpl->wires_.count(portname) == 0 || tpl->wires_.at(portname)->port_id == 0) {
 				if (portname.substr(0, 1) == "$")
 					log_error("Can't map port `%s' of cell `%s' to template `%s'!\n", portname.c_str(), cell->name.c_str(), tpl->name.c_str());
 				continue;
 			}
 			RTLIL::Wire *w = tpl->wires_.at(portname);
+			RTLIL::Wire *new_w = new_wires.at(plan.wire_index.at(w));
 			RTLIL::SigSig c;
 			if (w->port_output) {
 				c.first = it.second;
-				c.second = RTLIL::SigSpec(w);
-				apply_prefix(cell->name.str(), c.second, module);
+				c.second = RTLIL::SigSpec(new_w);
 			} else {
-				c.first = RTLIL::SigSpec(w);
+				c.first = RTLIL::SigSpec(new_w);
 				c.second = it.second;
-				apply_prefix(cell->name.str(), c.first, module);
 			}
 			if (c.second.size() > c.first.size())
 				c.second.remove(c.first.size(), c.second.size() - c.first.size());
@@ -235,31 +348,23 @@ struct TechmapWorker
 			}
 		}
 
-		for (auto &it : tpl->cells_)
+		for (auto &it : plan.cells)
 		{
-			std::string c_name = it.second->name.str();
-
-			if (!flatten_mode && c_name == "\\_TECHMAP_REPLACE_")
-				c_name = orig_cell_name;
-			else
-				apply_prefix(cell->name.str(), c_name);
-
-			RTLIL::Cell *c = module->addCell(c_name, it.second);
+			RTLIL::Cell *c = module->addCell(it.is_replace ? orig_cell_name : it.name_head + prefix + it.name_tail, it.cell);
 			design->select(module, c);
-
-			if (!flatten_mode && c->type.substr(0, 2) == "\\$")
-				c->type = c->type.substr(1);
+			c->setType(it.type);
+			new_cells.push_back(c);
 
 			for (auto &it2 : c->connections_) {
-				apply_prefix(cell->name.str(), it2.second, module);
+				remap_instance_wires(it2.second, plan, new_wires);
 				port_signal_map.apply(it2.second);
 			}
 		}
 
 		for (auto &it : tpl->connections()) {
 			RTLIL::SigSig c = it;
-			apply_prefix(cell->name.str(), c.first, module);
-			apply_prefix(cell->name.str(), c.second, module);
+			remap_instance_wires(c.first, plan, new_wires);
+			remap_instance_wires(c.second, plan, new_wires);
 			port_signal_map.apply(c.first);
 			port_signal_map.apply(c.second);
 			module->connect(c);
@@ -279,13 +384,27 @@ struct TechmapWorker
 		bool log_continue = false;
 		bool did_something = false;
 
+		// only the cells created by the previous call need to be looked
+		// at, all other cells have been handled or have no template. cells
+		// rejected by _TECHMAP_FAIL_ or a constant-input check count as
+		// handled and are not tried again, like in a full rescan.
+
+		std::vector<RTLIL::Cell*> candidate_cells, new_cells;
+		if (pending_cells.count(module)) {
+			candidate_cells.swap(pending_cells.at(module));
+			pending_cells.erase(module);
+		} else
+			candidate_cells = module->cells().to_vector();
+
+		techmap_plans.erase(module);
+
 		SigMap sigmap(module);
 
 		TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
 		std::map<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_inbit;
 		std::map<RTLIL::SigBit, std::set<RTLIL::Cell*>> outbit_to_cell;
 
-		for (auto cell : module->cells())
+		for (auto cell : candidate_cells)
 		{
 			if (!design->selected(module, cell) || handled_cells.count(cell) > 0)
 				continue;
@@ -363,7 +482,7 @@ struct TechmapWorker
 
 					if (!extmapper_name.empty())
 					{
-						cell->type = cell_type;
+						cell->setType(cell_type);
 
 						if ((extern_mode && !in_recursion) || extmapper_name == "wrap")
 						{
@@ -421,7 +540,7 @@ struct TechmapWorker
 								}
 							}
 
-							cell->type = extmapper_module->name;
+							cell->setType(extmapper_module->name);
 							cell->parameters.clear();
 
 							if (!extern_mode || in_recursion) {
@@ -435,16 +554,20 @@ struct TechmapWorker
 						{
 							log("%s %s.%s (%s) with %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(cell->type), extmapper_name.c_str());
 
-							if (extmapper_name == "simplemap") {
-								if (simplemap_mappers.count(cell->type) == 0)
-									log_error("No simplemap mapper for cell type %s found!\n", RTLIL::id2cstr(cell->type));
-								simplemap_mappers.at(cell->type)(module, cell);
-							}
+							{
+								TechmapNewCells new_cells_monitor(module, cell, new_cells);
 
-							if (extmapper_name == "maccmap") {
-								if (cell->type != "$macc")
-									log_error("The maccmap mapper can only map $macc (not %s) cells!\n", log_id(cell->type));
-								maccmap(module, cell);
+								if (extmapper_name == "simplemap") {
+									if (simplemap_mappers.count(cell->type) == 0)
+										log_error("No simplemap mapper for cell type %s found!\n", RTLIL::id2cstr(cell->type));
+									simplemap_mappers.at(cell->type)(module, cell);
+								}
+
+								if (extmapper_name == "maccmap") {
+									if (cell->type != "$macc")
+										log_error("The maccmap mapper can only map $macc (not %s) cells!\n", log_id(cell->type));
+									maccmap(module, cell);
+								}
 							}
 
 							module->remove(cell);
@@ -526,7 +649,7 @@ struct TechmapWorker
 			use_wrapper_tpl:;
 					// do not register techmap_wrap modules with techmap_cache
 				} else {
-					std::pair<RTLIL::IdString, std::map<RTLIL::IdString, RTLIL::Const>> key(tpl_name, parameters);
+					TechmapCacheKey key(tpl_name, parameters);
 					if (techmap_cache.count(key) > 0) {
 						tpl = techmap_cache[key];
 					} else {
@@ -724,20 +847,20 @@ struct TechmapWorker
 
 						for (auto cell : m->cells()) {
 							if (cell->type.substr(0, 2) == "\\$")
-								cell->type = cell->type.substr(1);
+								cell->setType(cell->type.substr(1));
 						}
 
 						module_queue.insert(m);
 					}
 
 					log("%s %s.%s to imported %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(m_name));
-					cell->type = m_name;
+					cell->setType(m_name);
 					cell->parameters.clear();
 				}
 				else
 				{
 					log("%s %s.%s using %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(tpl));
-					techmap_module_worker(design, module, cell, tpl);
+					techmap_module_worker(design, module, cell, tpl, new_cells);
 					cell = NULL;
 				}
 				did_something = true;
@@ -756,12 +879,111 @@ struct TechmapWorker
 			log_continue = false;
 		}
 
+		if (did_something)
+			pending_cells[module].swap(new_cells);
+		techmap_plans.erase(module);
+
 		return did_something;
 	}
 };
 
+struct TechmapMapCache
+{
+	// Parsed map libraries, shared by all techmap calls with -cache in this
+	// process. An entry is reused as long as its map files have the same sha1
+	// checksum. (The mtime has a resolution of one second on many file systems,
+	// so it can't tell if a file was rewritten right after it was read.)
+
+	struct file_stamp_t {
+		std::string filename;
+		std::string checksum;
+	};
+
+	struct entry_t {
+		std::vector<file_stamp_t> stamps;
+		RTLIL::Design *design;
+	};
+
+	std::map<std::string, entry_t> entries;
+	std::mutex entries_mutex;
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(entries_mutex);
+		for (auto &it : entries)
+			delete it.second.design;
+		entries.clear();
+	}
+
+	// the same file can be given with different relative paths, or the same
+	// relative path can refer to different files when the working directory changes
+	static std::string get_canonical_filename(const std::string &filename)
+	{
+#ifdef _WIN32
+		char *p = _fullpath(NULL, filename.c_str(), 0);
+#else
+		char *p = realpath(filename.c_str(), NULL);
+#endif
+		if (p == NULL)
+			return filename;
+		std::string result = p;
+		free(p);
+		return result;
+	}
+
+	static std::vector<file_stamp_t> get_stamps(const std::vector<std::string> &filenames)
+	{
+		std::vector<file_stamp_t> stamps;
+		for (auto &fn : filenames) {
+			file_stamp_t stamp;
+			stamp.filename = fn;
+			stamp.checksum = SHA1::from_file(fn);
+			stamps.push_back(stamp);
+		}
+		return stamps;
+	}
+
+	bool lookup(const std::string &key, RTLIL::Design *map)
+	{
+		std::lock_guard<std::mutex> lock(entries_mutex);
+
+		if (entries.count(key) == 0)
+			return false;
+
+		entry_t &entry = entries.at(key);
+		for (auto &stamp : entry.stamps)
+			if (SHA1::from_file(stamp.filename) != stamp.checksum)
+				return false;
+
+		for (auto mod : entry.design->modules())
+			map->add(mod->clone());
+		return true;
+	}
+
+	void store(const std::string &key, const std::vector<file_stamp_t> &stamps, RTLIL::Design *map)
+	{
+		RTLIL::Design *design = new RTLIL::Design;
+		for (auto mod : map->modules())
+			design->add(mod->clone());
+
+		std::lock_guard<std::mutex> lock(entries_mutex);
+
+		if (entries.count(key))
+			delete entries.at(key).design;
+
+		entry_t &entry = entries[key];
+		entry.stamps = stamps;
+		entry.design = design;
+	}
+};
+
+static TechmapMapCache techmap_map_cache;
+
 struct TechmapPass : public Pass {
 	TechmapPass() : Pass("techmap", "generic technology mapper") { }
+	virtual ~TechmapPass() {
+		techmap_map_cache.clear();
+	}
 	virtual void help()
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -806,6 +1028,11 @@ struct TechmapPass : public Pass {
 		log("        a selected cell. only cell types that end on an underscore are accepted\n");
 		log("        as final cell types by this mode.\n");
 		log("\n");
+		log("    -cache\n");
+		log("        reuse a parsed copy of the map files from an earlier techmap call\n");
+		log("        with -cache and the same map files, instead of reading them again\n");
+		log("        (see below).\n");
+		log("\n");
 		log("    -D <define>, -I <incdir>\n");
 		log("        this options are passed as-is to the verilog frontend for loading the\n");
 		log("        map file. Note that the verilog frontend is also called with the\n");
@@ -892,12 +1119,41 @@ struct TechmapPass : public Pass {
 		log("A cell with the name _TECHMAP_REPLACE_ in the map file will inherit the name\n");
 		log("of the cell that is beeing replaced.\n");
 		log("\n");
+		log("With -cache, the parsed map files are kept for the rest of the session and\n");
+		log("reused by later techmap calls with -cache, the same map files and the same\n");
+		log("frontend options, as long as the map files are unchanged. Changes to files\n");
+		log("included by the map files, or to the 'verilog_defaults', are not detected.\n");
+		log("So only use -cache when these do not change between the techmap calls.\n");
+		log("\n");
 		log("See 'help extract' for a pass that does the opposite thing.\n");
 		log("\n");
 		log("See 'help flatten' for a pass that does flatten the design (which is\n");
 		log("esentially techmap but using the design itself as map library).\n");
 		log("\n");
 	}
+	void load_map_files(RTLIL::Design *map, const std::vector<std::string> &map_files, std::string verilog_frontend)
+	{
+		if (map_files.empty()) {
+			std::istringstream f(stdcells_code);
+			Frontend::frontend_call(map, &f, "<techmap.v>", verilog_frontend);
+		} else
+			for (auto &fn : map_files)
+				if (fn.substr(0, 1) == "%") {
+					if (!saved_designs.count(fn.substr(1))) {
+						delete map;
+						log_cmd_error("Can't saved design `%s'.\n", fn.c_str()+1);
+					}
+					for (auto mod : saved_designs.at(fn.substr(1))->modules())
+						if (!map->has(mod->name))
+							map->add(mod->clone());
+				} else {
+					std::ifstream f;
+					f.open(fn.c_str());
+					if (f.fail())
+						log_cmd_error("Can't open map file `%s'\n", fn.c_str());
+					Frontend::frontend_call(map, &f, fn, (fn.size() > 3 && fn.substr(fn.size()-3) == ".il") ? "ilang" : verilog_frontend);
+				}
+	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
 		log_header("Executing TECHMAP pass (map to technology primitives).\n");
@@ -909,6 +1165,7 @@ struct TechmapPass : public Pass {
 		std::vector<std::string> map_files;
 		std::string verilog_frontend = "verilog -ignore_redef";
 		int max_iter = -1;
+		bool use_cache = false;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
@@ -951,31 +1208,35 @@ struct TechmapPass : public Pass {
 				worker.autoproc_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-cache") {
+				use_cache = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		std::string cache_key = verilog_frontend;
+		std::vector<std::string> canonical_map_files;
+		for (auto &fn : map_files) {
+			if (fn.substr(0, 1) == "%")
+				use_cache = false;
+			canonical_map_files.push_back(TechmapMapCache::get_canonical_filename(fn));
+			cache_key += "\n" + canonical_map_files.back();
+		}
+
+		std::vector<TechmapMapCache::file_stamp_t> cache_stamps;
 		RTLIL::Design *map = new RTLIL::Design;
-		if (map_files.empty()) {
-			std::istringstream f(stdcells_code);
-			Frontend::frontend_call(map, &f, "<techmap.v>", verilog_frontend);
-		} else
-			for (auto &fn : map_files)
-				if (fn.substr(0, 1) == "%") {
-					if (!saved_designs.count(fn.substr(1))) {
-						delete map;
-						log_cmd_error("Can't saved design `%s'.\n", fn.c_str()+1);
-					}
-					for (auto mod : saved_designs.at(fn.substr(1))->modules())
-						if (!map->has(mod->name))
-							map->add(mod->clone());
-				} else {
-					std::ifstream f;
-					f.open(fn.c_str());
-					if (f.fail())
-						log_cmd_error("Can't open map file `%s'\n", fn.c_str());
-					Frontend::frontend_call(map, &f, fn, (fn.size() > 3 && fn.substr(fn.size()-3) == ".il") ? "ilang" : verilog_frontend);
-				}
+
+		if (use_cache && techmap_map_cache.lookup(cache_key, map)) {
+			log("Using cached map library (%d modules).\n", GetSize(map->modules_));
+		} else {
+			if (use_cache)
+				cache_stamps = TechmapMapCache::get_stamps(canonical_map_files);
+			load_map_files(map, map_files, verilog_frontend);
+			if (use_cache)
+				techmap_map_cache.store(cache_key, cache_stamps, map);
+		}
 
 		std::map<RTLIL::IdString, RTLIL::Module*> modules_new;
 		for (auto &it : map->modules_) {
@@ -0,0 +1,81 @@
+#!/usr/bin/python
+
+from __future__ import division
+from __future__ import print_function
+
+# Generates a large flat gate-level netlist for benchmarking opt_clean. The
+# netlist contains dead logic, chains of connected wires with public and
+# internal names, and flip-flops, similar to what flatten+techmap produce.
+#
+# usage: python generate.py [num_cells [seed]] > netlist.il
+
+import sys
+import random
+
+num_cells = int(sys.argv[1]) if len(sys.argv) > 1 else 1000000
+random.seed(int(sys.argv[2]) if len(sys.argv) > 2 else 1)
+
+num_inputs = 64
+num_outputs = 64
+gate_types = ['$_AND_', '$_OR_', '$_XOR_', '$_MUX_', '$_NOT_']
+
+out = sys.stdout
+out.write('module \\bench\n')
+out.write('  wire input 1 \\clk\n')
+
+signals = []
+for i in range(num_inputs):
+    out.write('  wire input %d \\in%d\n' % (i + 2, i))
+    signals.append('\\in%d' % i)
+
+cells = []
+connections = []
+
+for i in range(num_cells):
+    y = '$n%d' % i
+    out.write('  wire %s\n' % y)
+
+    # some nets get a public alias, as created by flatten for ports of submodules
+    if random.randint(0, 9) == 0:
+        alias = '\\sub%d.y' % i
+        out.write('  wire %s\n' % alias)
+        connections.append((alias, y))
+        y_ref = alias
+    else:
+        y_ref = y
+
+    # pick inputs mostly from recently created nets to get deep cones
+    def pick():
+        if random.randint(0, 3) == 0:
+            return random.choice(signals)
+        return signals[-random.randint(1, min(len(signals), 100))]
+
+    if random.randint(0, 49) == 0:
+        cells.append(('$_DFF_P_', [('C', '\\clk'), ('D', pick()), ('Q', y)]))
+    else:
+        celltype = random.choice(gate_types)
+        if celltype == '$_NOT_':
+            cells.append((celltype, [('A', pick()), ('Y', y)]))
+        elif celltype == '$_MUX_':
+            cells.append((celltype, [('A', pick()), ('B', pick()), ('S', pick()), ('Y', y)]))
+        else:
+            cells.append((celltype, [('A', pick()), ('B', pick()), ('Y', y)]))
+
+    # about a quarter of the nets are never used and their cells are dead logic
+    if random.randint(0, 3) != 0:
+        signals.append(y_ref)
+
+for i in range(num_outputs):
+    out.write('  wire output %d \\out%d\n' % (num_inputs + 2 + i, i))
+    connections.append(('\\out%d' % i, signals[-1 - i]))
+
+for idx, (celltype, ports) in enumerate(cells):
+    out.write('  cell %s $c%d\n' % (celltype, idx))
+    for port, sig in ports:
+        out.write('    connect \\%s %s\n' % (port, sig))
+    out.write('  end\n')
+
+for lhs, rhs in connections:
+    out.write('  connect %s %s\n' % (lhs, rhs))
+
+out.write('end\n')
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# benchmark opt_clean on a large flat netlist:
+# bash run-bench.sh [num_cells]
+
+set -e
+
+rm -rf temp
+mkdir -p temp
+echo "generating netlist.."
+python generate.py ${1:-1000000} > temp/bench.il
+
+echo "running opt_clean.."
+../../yosys -ql temp/bench.log -p 'read_ilang temp/bench.il; opt_clean; opt_clean; stat'
+grep -E 'Number of cells:|Time spent' temp/bench.log
@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+#
+# A minimal DIMACS SAT solver (DPLL with unit propagation) for testing the
+# 'sat -solver <cmd>' option without an external solver package. It is only
+# meant for the small problems in this directory.
+
+from __future__ import print_function
+import sys
+
+sys.setrecursionlimit(100000)
+
+def read_cnf(filename):
+    clauses, clause = [], []
+    with open(filename) as f:
+        for line in f:
+            if line.startswith("c") or line.startswith("p"):
+                continue
+            for lit in map(int, line.split()):
+                if lit == 0:
+                    clauses.append(clause)
+                    clause = []
+                else:
+                    clause.append(lit)
+    return clauses
+
+def simplify(clauses, lit):
+    result = []
+    for clause in clauses:
+        if lit in clause:
+            continue
+        reduced = [l for l in clause if l != -lit]
+        if not reduced:
+            return None
+        result.append(reduced)
+    return result
+
+def dpll(clauses, assignment):
+    if any(not c for c in clauses):
+        return None
+    while True:
+        units = [c[0] for c in clauses if len(c) == 1]
+        if not units:
+            break
+        clauses = simplify(clauses, units[0])
+        if clauses is None:
+            return None
+        assignment = assignment + [units[0]]
+    if not clauses:
+        return assignment
+    lit = clauses[0][0]
+    for choice in (lit, -lit):
+        reduced = simplify(clauses, choice)
+        if reduced is not None:
+            result = dpll(reduced, assignment + [choice])
+            if result is not None:
+                return result
+    return None
+
+model = dpll(read_cnf(sys.argv[1]), [])
+
+if model is None:
+    print("s UNSATISFIABLE")
+else:
+    print("s SATISFIABLE")
+    print("v " + " ".join(str(lit) for lit in model) + " 0")
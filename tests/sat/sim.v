@@ -0,0 +1,14 @@
+module counter(clk, rst, en, count, wrap);
+	input clk, rst, en;
+	output reg [3:0] count;
+	output wrap;
+
+	always @(posedge clk) begin
+		if (rst)
+			count <= 0;
+		else if (en)
+			count <= count + 1;
+	end
+
+	assign wrap = &count;
+endmodule